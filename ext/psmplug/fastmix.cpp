@@ -9,6 +9,19 @@
 #include "sndfile.h"
 #include <math.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define MODPLUG_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MODPLUG_NEON
+#include <arm_neon.h>
+#endif
+
 #ifdef MSC_VER
 #pragma bss_seg(".modplug")
 #endif
@@ -279,6 +292,212 @@ CzWINDOWEDFIR::~CzWINDOWEDFIR()
 
 CzWINDOWEDFIR sfir;
 
+// ----------------------------------------------------------------------------
+// FIR FILTER KERNELS
+//
+// Each kernel applies the 8-tap filter at lut to the samples starting at p
+// (the sample 3 before the current one). The SSE2 and NEON versions give
+// exactly the same results as the C versions, and are used when the CPU
+// supports them and SIMD has not been disabled (see CSoundFile::EnableSIMD).
+// ----------------------------------------------------------------------------
+
+static inline int FirMono8C(const signed short *lut, const signed char *p)
+{
+	int vol = 0;
+	for (int i=0; i<WFIR_WIDTH; i++) vol += lut[i] * (int)p[i];
+	return vol >> WFIR_8SHIFT;
+}
+
+static inline int FirMono16C(const signed short *lut, const signed short *p)
+{
+	int vol1 = lut[0]*(int)p[0] + lut[1]*(int)p[1] + lut[2]*(int)p[2] + lut[3]*(int)p[3];
+	int vol2 = lut[4]*(int)p[4] + lut[5]*(int)p[5] + lut[6]*(int)p[6] + lut[7]*(int)p[7];
+	return ((vol1>>1)+(vol2>>1)) >> (WFIR_16BITSHIFT-1);
+}
+
+static inline void FirStereo8C(const signed short *lut, const signed char *p, int &vol_l, int &vol_r)
+{
+	vol_l = 0;
+	vol_r = 0;
+	for (int i=0; i<WFIR_WIDTH; i++)
+	{
+		vol_l += lut[i] * (int)p[i*2];
+		vol_r += lut[i] * (int)p[i*2+1];
+	}
+	vol_l >>= WFIR_8SHIFT;
+	vol_r >>= WFIR_8SHIFT;
+}
+
+static inline void FirStereo16C(const signed short *lut, const signed short *p, int &vol_l, int &vol_r)
+{
+	int vol1_l = lut[0]*(int)p[0] + lut[1]*(int)p[2] + lut[2]*(int)p[4] + lut[3]*(int)p[6];
+	int vol2_l = lut[4]*(int)p[8] + lut[5]*(int)p[10] + lut[6]*(int)p[12] + lut[7]*(int)p[14];
+	int vol1_r = lut[0]*(int)p[1] + lut[1]*(int)p[3] + lut[2]*(int)p[5] + lut[3]*(int)p[7];
+	int vol2_r = lut[4]*(int)p[9] + lut[5]*(int)p[11] + lut[6]*(int)p[13] + lut[7]*(int)p[15];
+	vol_l = ((vol1_l>>1)+(vol2_l>>1)) >> (WFIR_16BITSHIFT-1);
+	vol_r = ((vol1_r>>1)+(vol2_r>>1)) >> (WFIR_16BITSHIFT-1);
+}
+
+#ifdef MODPLUG_SSE2
+
+// Sums of the products of the first 4 and last 4 taps
+static inline void FirSumSSE2(__m128i c, __m128i s, int &vol1, int &vol2)
+{
+	__m128i m = _mm_madd_epi16(c, s);
+	m = _mm_add_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2,3,0,1)));
+	vol1 = _mm_cvtsi128_si32(m);
+	vol2 = _mm_cvtsi128_si32(_mm_srli_si128(m, 8));
+}
+
+// Separate interleaved left and right samples
+static inline void FirDeinterleaveSSE2(__m128i a, __m128i b, __m128i &l, __m128i &r)
+{
+	a = _mm_shufflelo_epi16(a, _MM_SHUFFLE(3,1,2,0));
+	a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3,1,2,0));
+	a = _mm_shuffle_epi32(a, _MM_SHUFFLE(3,1,2,0));
+	b = _mm_shufflelo_epi16(b, _MM_SHUFFLE(3,1,2,0));
+	b = _mm_shufflehi_epi16(b, _MM_SHUFFLE(3,1,2,0));
+	b = _mm_shuffle_epi32(b, _MM_SHUFFLE(3,1,2,0));
+	l = _mm_unpacklo_epi64(a, b);
+	r = _mm_unpackhi_epi64(a, b);
+}
+
+static inline int FirMono8SSE2(const signed short *lut, const signed char *p)
+{
+	int vol1, vol2;
+	__m128i s = _mm_loadl_epi64((const __m128i *)p);
+	s = _mm_srai_epi16(_mm_unpacklo_epi8(s, s), 8);
+	FirSumSSE2(_mm_loadu_si128((const __m128i *)lut), s, vol1, vol2);
+	return (vol1 + vol2) >> WFIR_8SHIFT;
+}
+
+static inline int FirMono16SSE2(const signed short *lut, const signed short *p)
+{
+	int vol1, vol2;
+	FirSumSSE2(_mm_loadu_si128((const __m128i *)lut), _mm_loadu_si128((const __m128i *)p), vol1, vol2);
+	return ((vol1>>1)+(vol2>>1)) >> (WFIR_16BITSHIFT-1);
+}
+
+static inline void FirStereo8SSE2(const signed short *lut, const signed char *p, int &vol_l, int &vol_r)
+{
+	int vol1, vol2;
+	__m128i c = _mm_loadu_si128((const __m128i *)lut);
+	__m128i s = _mm_loadu_si128((const __m128i *)p);
+	__m128i l, r;
+	FirDeinterleaveSSE2(_mm_srai_epi16(_mm_unpacklo_epi8(s, s), 8),
+		_mm_srai_epi16(_mm_unpackhi_epi8(s, s), 8), l, r);
+	FirSumSSE2(c, l, vol1, vol2);
+	vol_l = (vol1 + vol2) >> WFIR_8SHIFT;
+	FirSumSSE2(c, r, vol1, vol2);
+	vol_r = (vol1 + vol2) >> WFIR_8SHIFT;
+}
+
+static inline void FirStereo16SSE2(const signed short *lut, const signed short *p, int &vol_l, int &vol_r)
+{
+	int vol1, vol2;
+	__m128i c = _mm_loadu_si128((const __m128i *)lut);
+	__m128i l, r;
+	FirDeinterleaveSSE2(_mm_loadu_si128((const __m128i *)p),
+		_mm_loadu_si128((const __m128i *)(p + 8)), l, r);
+	FirSumSSE2(c, l, vol1, vol2);
+	vol_l = ((vol1>>1)+(vol2>>1)) >> (WFIR_16BITSHIFT-1);
+	FirSumSSE2(c, r, vol1, vol2);
+	vol_r = ((vol1>>1)+(vol2>>1)) >> (WFIR_16BITSHIFT-1);
+}
+
+#endif
+
+#ifdef MODPLUG_NEON
+
+// Sums of the products of the first 4 and last 4 taps
+static inline void FirSumNEON(int16x8_t c, int16x8_t s, int &vol1, int &vol2)
+{
+	int32x4_t lo = vmull_s16(vget_low_s16(c), vget_low_s16(s));
+	int32x4_t hi = vmull_s16(vget_high_s16(c), vget_high_s16(s));
+	int32x2_t sum = vpadd_s32(vpadd_s32(vget_low_s32(lo), vget_high_s32(lo)),
+		vpadd_s32(vget_low_s32(hi), vget_high_s32(hi)));
+	vol1 = vget_lane_s32(sum, 0);
+	vol2 = vget_lane_s32(sum, 1);
+}
+
+static inline int FirMono8NEON(const signed short *lut, const signed char *p)
+{
+	int vol1, vol2;
+	FirSumNEON(vld1q_s16(lut), vmovl_s8(vld1_s8(p)), vol1, vol2);
+	return (vol1 + vol2) >> WFIR_8SHIFT;
+}
+
+static inline int FirMono16NEON(const signed short *lut, const signed short *p)
+{
+	int vol1, vol2;
+	FirSumNEON(vld1q_s16(lut), vld1q_s16(p), vol1, vol2);
+	return ((vol1>>1)+(vol2>>1)) >> (WFIR_16BITSHIFT-1);
+}
+
+static inline void FirStereo8NEON(const signed short *lut, const signed char *p, int &vol_l, int &vol_r)
+{
+	int vol1, vol2;
+	int16x8_t c = vld1q_s16(lut);
+	int8x8x2_t s = vld2_s8(p);
+	FirSumNEON(c, vmovl_s8(s.val[0]), vol1, vol2);
+	vol_l = (vol1 + vol2) >> WFIR_8SHIFT;
+	FirSumNEON(c, vmovl_s8(s.val[1]), vol1, vol2);
+	vol_r = (vol1 + vol2) >> WFIR_8SHIFT;
+}
+
+static inline void FirStereo16NEON(const signed short *lut, const signed short *p, int &vol_l, int &vol_r)
+{
+	int vol1, vol2;
+	int16x8_t c = vld1q_s16(lut);
+	int16x8x2_t s = vld2q_s16(p);
+	FirSumNEON(c, s.val[0], vol1, vol2);
+	vol_l = ((vol1>>1)+(vol2>>1)) >> (WFIR_16BITSHIFT-1);
+	FirSumNEON(c, s.val[1], vol1, vol2);
+	vol_r = ((vol1>>1)+(vol2>>1)) >> (WFIR_16BITSHIFT-1);
+}
+
+#endif
+
+static inline int FirMono8(const signed short *lut, const signed char *p)
+{
+#if defined(MODPLUG_SSE2)
+	if (CSoundFile::gdwSysInfo & SYSMIX_SSE2) return FirMono8SSE2(lut, p);
+#elif defined(MODPLUG_NEON)
+	if (CSoundFile::gdwSysInfo & SYSMIX_NEON) return FirMono8NEON(lut, p);
+#endif
+	return FirMono8C(lut, p);
+}
+
+static inline int FirMono16(const signed short *lut, const signed short *p)
+{
+#if defined(MODPLUG_SSE2)
+	if (CSoundFile::gdwSysInfo & SYSMIX_SSE2) return FirMono16SSE2(lut, p);
+#elif defined(MODPLUG_NEON)
+	if (CSoundFile::gdwSysInfo & SYSMIX_NEON) return FirMono16NEON(lut, p);
+#endif
+	return FirMono16C(lut, p);
+}
+
+static inline void FirStereo8(const signed short *lut, const signed char *p, int &vol_l, int &vol_r)
+{
+#if defined(MODPLUG_SSE2)
+	if (CSoundFile::gdwSysInfo & SYSMIX_SSE2) { FirStereo8SSE2(lut, p, vol_l, vol_r); return; }
+#elif defined(MODPLUG_NEON)
+	if (CSoundFile::gdwSysInfo & SYSMIX_NEON) { FirStereo8NEON(lut, p, vol_l, vol_r); return; }
+#endif
+	FirStereo8C(lut, p, vol_l, vol_r);
+}
+
+static inline void FirStereo16(const signed short *lut, const signed short *p, int &vol_l, int &vol_r)
+{
+#if defined(MODPLUG_SSE2)
+	if (CSoundFile::gdwSysInfo & SYSMIX_SSE2) { FirStereo16SSE2(lut, p, vol_l, vol_r); return; }
+#elif defined(MODPLUG_NEON)
+	if (CSoundFile::gdwSysInfo & SYSMIX_NEON) { FirStereo16NEON(lut, p, vol_l, vol_r); return; }
+#endif
+	FirStereo16C(lut, p, vol_l, vol_r);
+}
+
 // ----------------------------------------------------------------------------
 // MIXING MACROS
 // ----------------------------------------------------------------------------
@@ -362,29 +581,13 @@ CzWINDOWEDFIR sfir;
 	int poshi  = nPos >> 16;\
 	int poslo  = (nPos & 0xFFFF);\
 	int firidx = ((poslo+WFIR_FRACHALVE)>>WFIR_FRACSHIFT) & WFIR_FRACMASK; \
-	int vol    = (CzWINDOWEDFIR::lut[firidx+0]*(int)p[poshi+1-4]);	\
-            vol   += (CzWINDOWEDFIR::lut[firidx+1]*(int)p[poshi+2-4]);	\
-            vol   += (CzWINDOWEDFIR::lut[firidx+2]*(int)p[poshi+3-4]);	\
-            vol   += (CzWINDOWEDFIR::lut[firidx+3]*(int)p[poshi+4-4]);	\
-            vol   += (CzWINDOWEDFIR::lut[firidx+4]*(int)p[poshi+5-4]);	\
-            vol   += (CzWINDOWEDFIR::lut[firidx+5]*(int)p[poshi+6-4]);	\
-            vol   += (CzWINDOWEDFIR::lut[firidx+6]*(int)p[poshi+7-4]);	\
-            vol   += (CzWINDOWEDFIR::lut[firidx+7]*(int)p[poshi+8-4]);	\
-            vol  >>= WFIR_8SHIFT;
+	int vol    = FirMono8(CzWINDOWEDFIR::lut+firidx, p+poshi-3);
 
 #define SNDMIX_GETMONOVOL16FIRFILTER \
     int poshi  = nPos >> 16;\
     int poslo  = (nPos & 0xFFFF);\
     int firidx = ((poslo+WFIR_FRACHALVE)>>WFIR_FRACSHIFT) & WFIR_FRACMASK; \
-    int vol1   = (CzWINDOWEDFIR::lut[firidx+0]*(int)p[poshi+1-4]);	\
-        vol1  += (CzWINDOWEDFIR::lut[firidx+1]*(int)p[poshi+2-4]);	\
-        vol1  += (CzWINDOWEDFIR::lut[firidx+2]*(int)p[poshi+3-4]);	\
-        vol1  += (CzWINDOWEDFIR::lut[firidx+3]*(int)p[poshi+4-4]);	\
-    int vol2   = (CzWINDOWEDFIR::lut[firidx+4]*(int)p[poshi+5-4]);	\
-	vol2  += (CzWINDOWEDFIR::lut[firidx+5]*(int)p[poshi+6-4]);	\
-	vol2  += (CzWINDOWEDFIR::lut[firidx+6]*(int)p[poshi+7-4]);	\
-	vol2  += (CzWINDOWEDFIR::lut[firidx+7]*(int)p[poshi+8-4]);	\
-    int vol    = ((vol1>>1)+(vol2>>1)) >> (WFIR_16BITSHIFT-1);
+    int vol    = FirMono16(CzWINDOWEDFIR::lut+firidx, p+poshi-3);
 
 /////////////////////////////////////////////////////////////////////////////
 // Stereo
@@ -445,47 +648,15 @@ CzWINDOWEDFIR sfir;
     int poshi   = nPos >> 16;\
     int poslo   = (nPos & 0xFFFF);\
     int firidx  = ((poslo+WFIR_FRACHALVE)>>WFIR_FRACSHIFT) & WFIR_FRACMASK; \
-    int vol_l   = (CzWINDOWEDFIR::lut[firidx+0]*(int)p[(poshi+1-4)*2  ]);   \
-	vol_l  += (CzWINDOWEDFIR::lut[firidx+1]*(int)p[(poshi+2-4)*2  ]);   \
-	vol_l  += (CzWINDOWEDFIR::lut[firidx+2]*(int)p[(poshi+3-4)*2  ]);   \
-        vol_l  += (CzWINDOWEDFIR::lut[firidx+3]*(int)p[(poshi+4-4)*2  ]);   \
-        vol_l  += (CzWINDOWEDFIR::lut[firidx+4]*(int)p[(poshi+5-4)*2  ]);   \
-	vol_l  += (CzWINDOWEDFIR::lut[firidx+5]*(int)p[(poshi+6-4)*2  ]);   \
-	vol_l  += (CzWINDOWEDFIR::lut[firidx+6]*(int)p[(poshi+7-4)*2  ]);   \
-        vol_l  += (CzWINDOWEDFIR::lut[firidx+7]*(int)p[(poshi+8-4)*2  ]);   \
-	vol_l >>= WFIR_8SHIFT; \
-    int vol_r   = (CzWINDOWEDFIR::lut[firidx+0]*(int)p[(poshi+1-4)*2+1]);   \
-	vol_r  += (CzWINDOWEDFIR::lut[firidx+1]*(int)p[(poshi+2-4)*2+1]);   \
-	vol_r  += (CzWINDOWEDFIR::lut[firidx+2]*(int)p[(poshi+3-4)*2+1]);   \
-	vol_r  += (CzWINDOWEDFIR::lut[firidx+3]*(int)p[(poshi+4-4)*2+1]);   \
-	vol_r  += (CzWINDOWEDFIR::lut[firidx+4]*(int)p[(poshi+5-4)*2+1]);   \
-        vol_r  += (CzWINDOWEDFIR::lut[firidx+5]*(int)p[(poshi+6-4)*2+1]);   \
-        vol_r  += (CzWINDOWEDFIR::lut[firidx+6]*(int)p[(poshi+7-4)*2+1]);   \
-        vol_r  += (CzWINDOWEDFIR::lut[firidx+7]*(int)p[(poshi+8-4)*2+1]);   \
-        vol_r >>= WFIR_8SHIFT;
+    int vol_l, vol_r; \
+    FirStereo8(CzWINDOWEDFIR::lut+firidx, p+(poshi-3)*2, vol_l, vol_r);
 
 #define SNDMIX_GETSTEREOVOL16FIRFILTER \
     int poshi   = nPos >> 16;\
     int poslo   = (nPos & 0xFFFF);\
     int firidx  = ((poslo+WFIR_FRACHALVE)>>WFIR_FRACSHIFT) & WFIR_FRACMASK; \
-    int vol1_l  = (CzWINDOWEDFIR::lut[firidx+0]*(int)p[(poshi+1-4)*2  ]);   \
-	vol1_l += (CzWINDOWEDFIR::lut[firidx+1]*(int)p[(poshi+2-4)*2  ]);   \
-        vol1_l += (CzWINDOWEDFIR::lut[firidx+2]*(int)p[(poshi+3-4)*2  ]);   \
-	vol1_l += (CzWINDOWEDFIR::lut[firidx+3]*(int)p[(poshi+4-4)*2  ]);   \
-   int vol2_l  = (CzWINDOWEDFIR::lut[firidx+4]*(int)p[(poshi+5-4)*2  ]);    \
-       vol2_l += (CzWINDOWEDFIR::lut[firidx+5]*(int)p[(poshi+6-4)*2  ]);    \
-       vol2_l += (CzWINDOWEDFIR::lut[firidx+6]*(int)p[(poshi+7-4)*2  ]);    \
-       vol2_l += (CzWINDOWEDFIR::lut[firidx+7]*(int)p[(poshi+8-4)*2  ]);    \
-   int vol_l   = ((vol1_l>>1)+(vol2_l>>1)) >> (WFIR_16BITSHIFT-1); \
-   int vol1_r  = (CzWINDOWEDFIR::lut[firidx+0]*(int)p[(poshi+1-4)*2+1]);    \
-       vol1_r += (CzWINDOWEDFIR::lut[firidx+1]*(int)p[(poshi+2-4)*2+1]);    \
-       vol1_r += (CzWINDOWEDFIR::lut[firidx+2]*(int)p[(poshi+3-4)*2+1]);    \
-       vol1_r += (CzWINDOWEDFIR::lut[firidx+3]*(int)p[(poshi+4-4)*2+1]);    \
-   int vol2_r  = (CzWINDOWEDFIR::lut[firidx+4]*(int)p[(poshi+5-4)*2+1]);    \
-       vol2_r += (CzWINDOWEDFIR::lut[firidx+5]*(int)p[(poshi+6-4)*2+1]);    \
-       vol2_r += (CzWINDOWEDFIR::lut[firidx+6]*(int)p[(poshi+7-4)*2+1]);    \
-       vol2_r += (CzWINDOWEDFIR::lut[firidx+7]*(int)p[(poshi+8-4)*2+1]);    \
-   int vol_r   = ((vol1_r>>1)+(vol2_r>>1)) >> (WFIR_16BITSHIFT-1);
+    int vol_l, vol_r; \
+    FirStereo16(CzWINDOWEDFIR::lut+firidx, p+(poshi-3)*2, vol_l, vol_r);
 
 /////////////////////////////////////////////////////////////////////////////
 
@@ -1630,7 +1801,78 @@ DWORD MPPASMCALL X86_Convert32To16(LPVOID lp16, int *pBuffer, DWORD lSampleCount
 {
 	int vumin = *lpMin, vumax = *lpMax;
 	signed short *p = (signed short *)lp16;
-	for (UINT i=0; i<lSampleCount; i++)
+	UINT i = 0;
+#if defined(MODPLUG_SSE2) || defined(MODPLUG_NEON)
+	// Until the minimum is no more than the maximum, a new minimum is not
+	// counted towards the maximum, so leave those samples to the C version
+	while ((i < lSampleCount) && (vumin > vumax))
+	{
+		int n = pBuffer[i];
+		if (n < MIXING_CLIPMIN)
+			n = MIXING_CLIPMIN;
+		else if (n > MIXING_CLIPMAX)
+			n = MIXING_CLIPMAX;
+		if (n < vumin)
+			vumin = n;
+		else if (n > vumax)
+			vumax = n;
+		p[i] = n >> (16-MIXING_ATTENUATION);
+		i++;
+	}
+#endif
+#if defined(MODPLUG_SSE2)
+	if ((CSoundFile::gdwSysInfo & SYSMIX_SSE2) && (i + 8 <= lSampleCount))
+	{
+		const __m128i clipmin = _mm_set1_epi32(MIXING_CLIPMIN);
+		const __m128i clipmax = _mm_set1_epi32(MIXING_CLIPMAX);
+		__m128i vmin = _mm_set1_epi32(vumin), vmax = _mm_set1_epi32(vumax);
+		int vu[4];
+		for (; i + 8 <= lSampleCount; i += 8)
+		{
+			__m128i n[2];
+			for (int j=0; j<2; j++)
+			{
+				__m128i x = _mm_loadu_si128((const __m128i *)(pBuffer + i + (j * 4)));
+				__m128i m = _mm_cmplt_epi32(x, clipmin);
+				x = _mm_or_si128(_mm_and_si128(m, clipmin), _mm_andnot_si128(m, x));
+				m = _mm_cmpgt_epi32(x, clipmax);
+				x = _mm_or_si128(_mm_and_si128(m, clipmax), _mm_andnot_si128(m, x));
+				m = _mm_cmplt_epi32(x, vmin);
+				vmin = _mm_or_si128(_mm_and_si128(m, x), _mm_andnot_si128(m, vmin));
+				m = _mm_cmpgt_epi32(x, vmax);
+				vmax = _mm_or_si128(_mm_and_si128(m, x), _mm_andnot_si128(m, vmax));
+				n[j] = _mm_srai_epi32(x, 16-MIXING_ATTENUATION);
+			}
+			_mm_storeu_si128((__m128i *)(p + i), _mm_packs_epi32(n[0], n[1]));
+		}
+		_mm_storeu_si128((__m128i *)vu, vmin);
+		for (int j=0; j<4; j++) if (vu[j] < vumin) vumin = vu[j];
+		_mm_storeu_si128((__m128i *)vu, vmax);
+		for (int j=0; j<4; j++) if (vu[j] > vumax) vumax = vu[j];
+	}
+#elif defined(MODPLUG_NEON)
+	if ((CSoundFile::gdwSysInfo & SYSMIX_NEON) && (i + 8 <= lSampleCount))
+	{
+		const int32x4_t clipmin = vdupq_n_s32(MIXING_CLIPMIN);
+		const int32x4_t clipmax = vdupq_n_s32(MIXING_CLIPMAX);
+		int32x4_t vmin = vdupq_n_s32(vumin), vmax = vdupq_n_s32(vumax);
+		int vu[4];
+		for (; i + 8 <= lSampleCount; i += 8)
+		{
+			int32x4_t a = vminq_s32(vmaxq_s32(vld1q_s32(pBuffer + i), clipmin), clipmax);
+			int32x4_t b = vminq_s32(vmaxq_s32(vld1q_s32(pBuffer + i + 4), clipmin), clipmax);
+			vmin = vminq_s32(vmin, vminq_s32(a, b));
+			vmax = vmaxq_s32(vmax, vmaxq_s32(a, b));
+			vst1q_s16(p + i, vcombine_s16(vmovn_s32(vshrq_n_s32(a, 16-MIXING_ATTENUATION)),
+				vmovn_s32(vshrq_n_s32(b, 16-MIXING_ATTENUATION))));
+		}
+		vst1q_s32(vu, vmin);
+		for (int j=0; j<4; j++) if (vu[j] < vumin) vumin = vu[j];
+		vst1q_s32(vu, vmax);
+		for (int j=0; j<4; j++) if (vu[j] > vumax) vumax = vu[j];
+	}
+#endif
+	for (; i<lSampleCount; i++)
 	{
 		int n = pBuffer[i];
 		if (n < MIXING_CLIPMIN)
@@ -1708,6 +1950,104 @@ DWORD MPPASMCALL X86_Convert32To32(LPVOID lp16, int *pBuffer, DWORD lSampleCount
 	return lSampleCount * 4;
 }
 
+#if defined(MODPLUG_SSE2)
+// Ask the CPU whether it has SSE2, as the build may be run on one without
+static BOOL HasSSE2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) ? TRUE : FALSE;
+#else
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return FALSE;
+	return (edx & bit_SSE2) ? TRUE : FALSE;
+#endif
+}
+#endif
+
+// Find out which SIMD instruction sets the mixer can use
+DWORD CSoundFile::InitSysInfo()
+{
+	gdwSysInfo &= ~(SYSMIX_SSE2|SYSMIX_NEON);
+#if defined(MODPLUG_SSE2)
+	if (HasSSE2()) gdwSysInfo |= SYSMIX_SSE2;
+#elif defined(MODPLUG_NEON)
+	gdwSysInfo |= SYSMIX_NEON;
+#endif
+	return gdwSysInfo;
+}
+
+// Use or stop using SIMD instructions, where available
+BOOL CSoundFile::EnableSIMD(BOOL bSIMD)
+{
+	if (bSIMD) InitSysInfo();
+	else gdwSysInfo &= ~(SYSMIX_SSE2|SYSMIX_NEON);
+	return (gdwSysInfo & (SYSMIX_SSE2|SYSMIX_NEON)) ? TRUE : FALSE;
+}
+
+#define SIMDCHECK_TRIALS	4096
+#define SIMDCHECK_SAMPLES	1027	// Not a multiple of the vector length
+
+static int SIMDCheckRandom(unsigned int &seed)
+{
+	seed = seed * 1103515245 + 12345;
+	return (int)seed;
+}
+
+// Run random input through the SIMD kernels the CPU supports and through the
+// C versions, whether or not SIMD is enabled. Returns the number of results
+// which differ, or -1 if there are no SIMD kernels to check.
+int CSoundFile::CheckSIMD()
+{
+	static int buffer[SIMDCHECK_SAMPLES];
+	static signed short simdOut[SIMDCHECK_SAMPLES], cOut[SIMDCHECK_SAMPLES];
+	signed char s8[WFIR_WIDTH*2];
+	signed short s16[WFIR_WIDTH*2];
+	DWORD sysInfo = gdwSysInfo;
+	unsigned int seed = 1;
+	int errors = 0;
+
+	if (!(InitSysInfo() & (SYSMIX_SSE2|SYSMIX_NEON)))
+	{
+		gdwSysInfo = sysInfo;
+		return -1;
+	}
+
+	// FIR kernels, with the real filter coefficients
+	for (int i=0; i<SIMDCHECK_TRIALS; i++)
+	{
+		const signed short *lut = CzWINDOWEDFIR::lut + (SIMDCheckRandom(seed) & WFIR_FRACMASK);
+		int simd_l, simd_r, c_l, c_r;
+		for (int j=0; j<WFIR_WIDTH*2; j++)
+		{
+			int n = SIMDCheckRandom(seed);
+			s8[j] = (signed char)(n >> 24);
+			s16[j] = (signed short)(n >> 16);
+		}
+		if (FirMono8(lut, s8) != FirMono8C(lut, s8)) errors++;
+		if (FirMono16(lut, s16) != FirMono16C(lut, s16)) errors++;
+		FirStereo8(lut, s8, simd_l, simd_r);
+		FirStereo8C(lut, s8, c_l, c_r);
+		if ((simd_l != c_l) || (simd_r != c_r)) errors++;
+		FirStereo16(lut, s16, simd_l, simd_r);
+		FirStereo16C(lut, s16, c_l, c_r);
+		if ((simd_l != c_l) || (simd_r != c_r)) errors++;
+	}
+
+	// 16-bit conversion, including clipping and the VU meter
+	for (int i=0; i<SIMDCHECK_SAMPLES; i++) buffer[i] = SIMDCheckRandom(seed) >> 3;
+	LONG simdMin = 0x7FFFFFFF, simdMax = -0x7FFFFFFF, cMin = simdMin, cMax = simdMax;
+	X86_Convert32To16(simdOut, buffer, SIMDCHECK_SAMPLES, &simdMin, &simdMax);
+	gdwSysInfo &= ~(SYSMIX_SSE2|SYSMIX_NEON);
+	X86_Convert32To16(cOut, buffer, SIMDCHECK_SAMPLES, &cMin, &cMax);
+	for (int i=0; i<SIMDCHECK_SAMPLES; i++) if (simdOut[i] != cOut[i]) errors++;
+	if ((simdMin != cMin) || (simdMax != cMax)) errors++;
+
+	gdwSysInfo = sysInfo;
+	return errors;
+}
+
 // Will fill in later.
 static void MPPASMCALL X86_InitMixBuffer(int *pBuffer, UINT nSamples)
 {
@@ -78,6 +78,7 @@ namespace ModPlug
 		                            gSettings.mFlags & MODPLUG_ENABLE_NOISE_REDUCTION,
 		                            false);
 		CSoundFile::SetResamplingMode(gSettings.mResamplingMode);
+		CSoundFile::EnableSIMD(gSettings.mFlags & MODPLUG_ENABLE_SIMD);
 	}
 }
 
@@ -183,6 +184,16 @@ int ModPlug_GetPlayingChannels(ModPlugFile* file)
 	return ( file->mSoundFile.m_nMixChannels < file->mSoundFile.m_nMaxMixChannels ? file->mSoundFile.m_nMixChannels : file->mSoundFile.m_nMaxMixChannels );
 }
 
+int ModPlug_GetTickSamples(ModPlugFile* file)
+{
+	return file->mSoundFile.m_nBufferCount;
+}
+
+int ModPlug_GetLoops(ModPlugFile* file)
+{
+	return file->mSoundFile.GetSongLoops();
+}
+
 void ModPlug_SeekOrder(ModPlugFile* file,int order)
 {
 	file->mSoundFile.SetCurrentOrder(order);
@@ -254,6 +265,11 @@ void ModPlug_Seek(ModPlugFile* file, int millisecond)
 	file->mSoundFile.SetCurrentPos((int)(millisecond * postime));
 }
 
+int ModPlug_CheckSIMD(void)
+{
+	return CSoundFile::CheckSIMD();
+}
+
 void ModPlug_GetSettings(ModPlug_Settings* settings)
 {
 	memcpy(settings, &ModPlug::gSettings, sizeof(ModPlug_Settings));
@@ -53,13 +53,19 @@ int ModPlug_GetLength(ModPlugFile* file);
  * ModPlug_GetLength() does not report the full length. */
 void ModPlug_Seek(ModPlugFile* file, int millisecond);
 
+/* Check that the SSE2 or NEON mixing code supported by the CPU gives exactly the
+ * same results as the C code, using random input.  Returns the number of results
+ * which differ, or -1 if there is no SIMD code to check. */
+int ModPlug_CheckSIMD(void);
+
 enum _ModPlug_Flags
 {
 	MODPLUG_ENABLE_OVERSAMPLING     = 1 << 0,  /* Enable oversampling (*highly* recommended) */
 	MODPLUG_ENABLE_NOISE_REDUCTION  = 1 << 1,  /* Enable noise reduction */
 	MODPLUG_ENABLE_REVERB           = 1 << 2,  /* Enable reverb */
 	MODPLUG_ENABLE_MEGABASS         = 1 << 3,  /* Enable megabass */
-	MODPLUG_ENABLE_SURROUND         = 1 << 4   /* Enable surround sound. */
+	MODPLUG_ENABLE_SURROUND         = 1 << 4,  /* Enable surround sound. */
+	MODPLUG_ENABLE_SIMD             = 1 << 5   /* Use SSE2 or NEON instructions, where available */
 };
 
 enum _ModPlug_ResamplingMode
@@ -117,6 +123,16 @@ int ModPlug_GetCurrentPattern(ModPlugFile* file);
 int ModPlug_GetCurrentRow(ModPlugFile* file);
 int ModPlug_GetPlayingChannels(ModPlugFile* file);
 
+/* Get the number of samples left before the next tick.  The order and row only
+ * change at the start of a tick, so this is zero at the point where they may
+ * change. */
+int ModPlug_GetTickSamples(ModPlugFile* file);
+
+/* Get the number of times the song has jumped back to repeat itself, either at
+ * the end of the song or through a backward jump which would otherwise repeat
+ * forever.  This changes at the start of the tick which begins the repeat. */
+int ModPlug_GetLoops(ModPlugFile* file);
+
 void ModPlug_SeekOrder(ModPlugFile* file,int order);
 int ModPlug_GetModuleType(ModPlugFile* file);
 char* ModPlug_GetMessage(ModPlugFile* file);
@@ -1212,7 +1212,7 @@ BOOL CSoundFile::ProcessEffects()
 		// Pattern Break / Position Jump only if no loop running
 		if ((nBreakRow >= 0) || (nPosJump >= 0))
 		{
-			BOOL bNoLoop = FALSE;
+			BOOL bNoLoop = FALSE, bSongLoop = FALSE;
 			if (nPosJump < 0) nPosJump = m_nCurrentPattern+1;
 			if (nBreakRow < 0) nBreakRow = 0;
 			// Modplug Tracker & ModPlugin allow backward jumps
@@ -1224,6 +1224,7 @@ BOOL CSoundFile::ProcessEffects()
 					if (m_nRepeatCount)
 					{
 						if (m_nRepeatCount > 0) m_nRepeatCount--;
+						bSongLoop = TRUE;
 					} else
 					{
 						// Backward jump disabled
@@ -1243,6 +1244,8 @@ BOOL CSoundFile::ProcessEffects()
 				}
 				m_nNextPattern = nPosJump;
 				m_nNextRow = (UINT)nBreakRow;
+				// Counted once the jump is made (see ProcessRow)
+				m_bSongLoopPending = bSongLoop;
 			}
 		}
 	}
@@ -30,6 +30,8 @@ CSoundFile::CSoundFile()
 	m_nMinPeriod = 0x20;
 	m_nMaxPeriod = 0x7FFF;
 	m_nRepeatCount = 0;
+	m_nSongLoops = 0;
+	m_bSongLoopPending = FALSE;
 	memset(Chn, 0, sizeof(Chn));
 	memset(ChnMix, 0, sizeof(ChnMix));
 	memset(Ins, 0, sizeof(Ins));
@@ -613,6 +615,7 @@ void CSoundFile::SetCurrentPos(UINT nPos)
 	m_nBufferCount = 0;
 	m_nPatternDelay = 0;
 	m_nFrameDelay = 0;
+	m_bSongLoopPending = FALSE;
 }
 
 
@@ -644,6 +647,7 @@ void CSoundFile::SetCurrentOrder(UINT nPos)
 		m_nTotalCount = 0;
 		m_nPatternDelay = 0;
 		m_nFrameDelay = 0;
+		m_bSongLoopPending = FALSE;
 	}
 	m_dwSongFlags &= ~(SONG_PATTERNLOOP|SONG_CPUVERYHIGH|SONG_FADINGSONG|SONG_ENDREACHED|SONG_GLOBALFADE);
 }
@@ -231,6 +231,8 @@ typedef const BYTE * LPCBYTE;
 #define SYSMIX_WINDOWSNT	0x02
 #define SYSMIX_SLOWCPU		0x04
 #define SYSMIX_FASTCPU		0x08
+#define SYSMIX_SSE2		0x10
+#define SYSMIX_NEON		0x20
 
 // Module flags
 #define SONG_EMBEDMIDICFG	0x0001
@@ -574,6 +576,8 @@ public:	// for Editing
 	UINT m_nMasterVolume, m_nGlobalVolume, m_nSongPreAmp;
 	UINT m_nFreqFactor, m_nTempoFactor, m_nOldGlbVolSlide;
 	LONG m_nMinPeriod, m_nMaxPeriod, m_nRepeatCount, m_nInitialRepeatCount;
+	UINT m_nSongLoops;
+	BOOL m_bSongLoopPending;
 	DWORD m_nGlobalFadeSamples, m_nGlobalFadeMaxSamples;
 	UINT m_nMaxOrderPosition;
 	UINT m_nPatternNames;
@@ -616,6 +620,7 @@ public:
 	DWORD GetSongTime() { return GetLength(FALSE, TRUE); }
 	void SetRepeatCount(int n) { m_nRepeatCount = n; m_nInitialRepeatCount = n; }
 	int GetRepeatCount() const { return m_nRepeatCount; }
+	UINT GetSongLoops() const { return m_nSongLoops; }
 	BOOL IsPaused() const {	return (m_dwSongFlags & SONG_PAUSED) ? TRUE : FALSE; }
 	void LoopPattern(int nPat, int nRow=0);
 	void CheckCPUUsage(UINT nCPU);
@@ -653,6 +658,8 @@ public:
 	static DWORD GetBitsPerSample() { return gnBitsPerSample; }
 	static DWORD InitSysInfo();
 	static DWORD GetSysInfo() { return gdwSysInfo; }
+	static BOOL EnableSIMD(BOOL bSIMD);
+	static int CheckSIMD();
 
 	//GCCFIX -- added these functions back in!
 	static BOOL SetWaveConfigEx(BOOL bSurround,BOOL bNoOverSampling,BOOL bReverb,BOOL hqido,BOOL bMegaBass,BOOL bNR,BOOL bEQ);
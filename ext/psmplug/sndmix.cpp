@@ -252,6 +252,11 @@ BOOL CSoundFile::ProcessRow()
 		m_nFrameDelay = 0;
 		m_nTickCount = 0;
 		m_nRow = m_nNextRow;
+		if (m_bSongLoopPending)
+		{
+			m_nSongLoops++;
+			m_bSongLoopPending = FALSE;
+		}
 		// Reset Pattern Loop Effect
 		if (m_nCurrentPattern != m_nNextPattern) m_nCurrentPattern = m_nNextPattern;
 		// Check if pattern is valid
@@ -298,6 +303,7 @@ BOOL CSoundFile::ProcessRow()
 						}
 					}
 					if (m_nRepeatCount > 0) m_nRepeatCount--;
+					m_nSongLoops++;
 					m_nCurrentPattern = m_nRestartPos;
 					m_nRow = 0;
 					if ((Order[m_nCurrentPattern] >= MAX_PATTERNS) || (!Patterns[Order[m_nCurrentPattern]])) return FALSE;
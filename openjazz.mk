@@ -1,7 +1,8 @@
 
 OBJS = \
-	src/game/clientgame.o src/game/game.o src/game/gamemode.o \
-	src/game/localgame.o src/game/servergame.o \
+	src/game/clientgame.o src/game/datagram.o src/game/game.o \
+	src/game/gamemode.o src/game/interpolator.o src/game/localgame.o \
+	src/game/prediction.o src/game/servergame.o src/game/snapshot.o \
 	src/io/gfx/anim.o src/io/gfx/font.o src/io/gfx/paletteeffects.o \
 	src/io/gfx/sprite.o src/io/gfx/video.o \
 	src/io/controls.o src/io/file.o src/io/network.o src/io/sound.o \
@@ -24,10 +25,12 @@ OBJS = \
 	src/jj2level/jj2layer.o src/jj2level/jj2level.o \
 	src/jj2level/jj2levelframe.o src/jj2level/jj2levelload.o \
 	src/level/level.o src/level/movable.o src/level/levelplayer.o \
+	src/level/replay.o \
 	src/menu/gamemenu.o src/menu/mainmenu.o src/menu/menu.o \
 	src/menu/plasma.o src/menu/setupmenu.o \
 	src/player/player.o \
-	src/main.o src/setup.o src/util.o \
+	src/benchmark.o src/loadtest.o src/main.o src/profiler.o src/scheduler.o \
+	src/setup.o src/trace.o src/util.o \
 	ext/psmplug/fastmix.o ext/psmplug/load_psm.o ext/psmplug/psmplug.o \
 	ext/psmplug/snd_dsp.o ext/psmplug/sndfile.o ext/psmplug/snd_flt.o \
 	ext/psmplug/snd_fx.o ext/psmplug/sndmix.o \
@@ -0,0 +1,305 @@
+
+/**
+ *
+ * @file benchmark.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 18th October 2026: Created benchmark.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2026 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Measures how long each part of a frame takes while the view is moved along a
+ * fixed path through a level. Time advances by a fixed amount each frame, and
+ * the frame rate is not limited, so runs can be compared with each other.
+ *
+ */
+
+
+#include "benchmark.h"
+
+#include "level/level.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * Compare two times, for sorting.
+ *
+ * @param a First time
+ * @param b Second time
+ *
+ * @return Negative, zero or positive if a is less than, equal to or greater than b
+ */
+static int compareTimes (const void* a, const void* b) {
+
+	unsigned int timeA = *((const unsigned int *)a);
+	unsigned int timeB = *((const unsigned int *)b);
+
+	return (timeA > timeB) - (timeA < timeB);
+
+}
+
+
+/**
+ * Create an inactive benchmark.
+ */
+Benchmark::Benchmark () {
+
+	int count;
+
+	for (count = 0; count < BP_PHASES; count++) times[count] = NULL;
+
+	csvFile = NULL;
+	frames = BENCHMARK_FRAMES;
+	frame = 0;
+	active = false;
+	running = false;
+
+	return;
+
+}
+
+
+/**
+ * Delete the benchmark.
+ */
+Benchmark::~Benchmark () {
+
+	int count;
+
+	for (count = 0; count < BP_PHASES; count++) {
+
+		if (times[count]) delete[] times[count];
+
+	}
+
+	if (csvFile) delete[] csvFile;
+
+	return;
+
+}
+
+
+/**
+ * Use benchmark mode. Time advances by a fixed amount each frame, and the
+ * first level to be played is measured.
+ *
+ * @param nFrames Number of frames to measure
+ * @param newCSVFile File to which results are written (NULL for none)
+ */
+void Benchmark::activate (int nFrames, const char* newCSVFile) {
+
+	if (nFrames > 0) frames = nFrames;
+
+	if (newCSVFile) csvFile = createString(newCSVFile);
+
+	active = true;
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not benchmark mode is in use.
+ *
+ * @return True if in benchmark mode
+ */
+bool Benchmark::isActive () {
+
+	return active;
+
+}
+
+
+/**
+ * Determine whether or not frames are being measured.
+ *
+ * @return True if frames are being measured
+ */
+bool Benchmark::isRunning () {
+
+	return running;
+
+}
+
+
+/**
+ * Start measuring, if this is the first level in benchmark mode.
+ */
+void Benchmark::beginLevel () {
+
+	int count;
+
+	if (!active || running || times[0]) return;
+
+	for (count = 0; count < BP_PHASES; count++) {
+
+		times[count] = new unsigned int[frames];
+		memset(times[count], 0, frames * sizeof(unsigned int));
+
+	}
+
+	frame = 0;
+	running = true;
+
+	return;
+
+}
+
+
+/**
+ * Add time taken by a phase of the current frame.
+ *
+ * @param phase The phase
+ * @param startTime Time at which the phase started, from getMicroTicks()
+ */
+void Benchmark::addTime (BenchmarkPhase phase, unsigned int startTime) {
+
+	if (running) times[phase][frame] += getMicroTicks() - startTime;
+
+	return;
+
+}
+
+
+/**
+ * Move on to the next frame.
+ *
+ * @return True if all frames have been measured
+ */
+bool Benchmark::endFrame () {
+
+	if (!running) return false;
+
+	frame++;
+
+	if (frame < frames) return false;
+
+	running = false;
+
+	report();
+
+	return true;
+
+}
+
+
+/**
+ * Move the view along the benchmark path, which crosses the level from side to
+ * side several times while moving from top to bottom.
+ *
+ * @param maxX Largest x-coordinate of the view (in pixels)
+ * @param maxY Largest y-coordinate of the view (in pixels)
+ */
+void Benchmark::view (int maxX, int maxY) {
+
+	int position;
+
+	if (maxX < 0) maxX = 0;
+	if (maxY < 0) maxY = 0;
+
+	// Position within the current crossing, from 0 to 1023 and back again
+	position = ((frame * BENCHMARK_SWEEPS) << 11) / frames;
+	position &= 2047;
+	if (position > 1023) position = 2047 - position;
+
+	viewX = ITOF((maxX * position) >> 10);
+	viewY = ITOF((maxY * frame) / frames);
+
+	return;
+
+}
+
+
+/**
+ * Get the bonus level direction on the benchmark path, which turns around
+ * several times.
+ *
+ * @return The direction (1024 represents a full circle)
+ */
+int Benchmark::getDirection () {
+
+	return (((frame * BENCHMARK_SWEEPS) << 10) / frames) & 1023;
+
+}
+
+
+/**
+ * Print the minimum, median and 99th percentile time of each phase, and of the
+ * whole frame. The results are also written to the CSV file, if there is one.
+ */
+void Benchmark::report () {
+
+	const char* phaseNames[BP_PHASES + 1] = {"step", "draw", "effects", "flip",
+		"total"};
+	unsigned int* sorted;
+	FILE* csv;
+	int phase, count;
+
+	csv = NULL;
+
+	if (csvFile) {
+
+		csv = fopen(csvFile, "w");
+
+		if (csv) fprintf(csv, "phase,min_us,median_us,p99_us\n");
+		else logError("Could not write benchmark results", csvFile);
+
+	}
+
+	printf("Benchmark: %d frames (times in ms)\n", frames);
+	printf("%-8s %9s %9s %9s\n", "phase", "min", "median", "p99");
+
+	sorted = new unsigned int[frames];
+
+	for (phase = 0; phase <= BP_PHASES; phase++) {
+
+		for (count = 0; count < frames; count++) {
+
+			if (phase < BP_PHASES) {
+
+				sorted[count] = times[phase][count];
+
+			} else {
+
+				sorted[count] = times[BP_STEP][count] + times[BP_DRAW][count] +
+					times[BP_EFFECTS][count] + times[BP_FLIP][count];
+
+			}
+
+		}
+
+		qsort(sorted, frames, sizeof(unsigned int), compareTimes);
+
+		printf("%-8s %9.3f %9.3f %9.3f\n", phaseNames[phase],
+			sorted[0] / 1000.0f, sorted[frames >> 1] / 1000.0f,
+			sorted[((frames - 1) * 99) / 100] / 1000.0f);
+
+		if (csv) {
+
+			fprintf(csv, "%s,%u,%u,%u\n", phaseNames[phase], sorted[0],
+				sorted[frames >> 1], sorted[((frames - 1) * 99) / 100]);
+
+		}
+
+	}
+
+	delete[] sorted;
+
+	if (csv) fclose(csv);
+
+	return;
+
+}
+
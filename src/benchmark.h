@@ -0,0 +1,83 @@
+
+/**
+ *
+ * @file benchmark.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 18th October 2026: Created benchmark.h
+ *
+ * @par Licence:
+ * Copyright (c) 2026 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _BENCHMARK_H
+#define _BENCHMARK_H
+
+
+#include "OpenJazz.h"
+
+
+// Constants
+
+#define BENCHMARK_FRAMES 1000 /* Default number of frames to measure */
+#define BENCHMARK_SWEEPS 4 /* Number of times the view crosses the level */
+
+
+// Enum
+
+/// Measured parts of a frame
+enum BenchmarkPhase {
+
+	BP_STEP, ///< Level simulation steps
+	BP_DRAW, ///< Drawing the level
+	BP_EFFECTS, ///< Applying palette effects
+	BP_FLIP, ///< Scaling and showing the frame
+	BP_PHASES ///< Number of phases
+
+};
+
+
+// Class
+
+/// Measures the time taken to render a level along a fixed path
+class Benchmark {
+
+	private:
+		unsigned int* times[BP_PHASES]; ///< Time taken by each phase of each frame, in microseconds
+		char*         csvFile; ///< File to which results are written, if any
+		int           frames; ///< Number of frames to measure
+		int           frame; ///< Current frame
+		bool          active; ///< Whether or not benchmark mode is in use
+		bool          running; ///< Whether or not frames are being measured
+
+		void report ();
+
+	public:
+		Benchmark  ();
+		~Benchmark ();
+
+		void activate     (int nFrames, const char* newCSVFile);
+		bool isActive     ();
+		bool isRunning    ();
+		void beginLevel   ();
+		void addTime      (BenchmarkPhase phase, unsigned int startTime);
+		bool endFrame     ();
+		void view         (int maxX, int maxY);
+		int  getDirection ();
+
+};
+
+
+// Variable
+
+EXTERN Benchmark benchmark; ///< Render benchmark
+
+#endif
+
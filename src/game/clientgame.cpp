@@ -34,6 +34,7 @@
 #include "util.h"
 
 #include <string.h>
+#include <miniz.h>
 
 
 /**
@@ -44,26 +45,29 @@
 ClientGame::ClientGame (char* address) {
 
 	unsigned char buffer[BUFFER_LENGTH];
+	unsigned char* message;
 	unsigned int timeout;
-	int count, ret;
+	int ret;
 	GameModeType modeType;
 
-	sock = net->join(address);
+	ret = net->join(address);
+
+	if (ret < 0) throw ret; // Tee hee hee hee hee.
 
-	if (sock < 0) throw sock; // Tee hee hee hee hee.
+	connection.open(ret);
 
 
 	// Receive initialisation message
 
-	count = 0;
+	message = NULL;
 	timeout = globalTicks + T_SCHECK + T_TIMEOUT;
 
 	// Wait for whole message to arrive
-	while (count < MTL_G_PROPS) {
+	while (!message) {
 
 		if (loop(NORMAL_LOOP) == E_QUIT) {
 
-			net->close(sock);
+			net->close(connection.getSocket());
 
 			throw E_QUIT;
 
@@ -71,7 +75,7 @@ ClientGame::ClientGame (char* address) {
 
 		if (controls.release(C_ESCAPE)) {
 
-			net->close(sock);
+			net->close(connection.getSocket());
 
 			throw E_RETURN;
 
@@ -82,13 +86,12 @@ ClientGame::ClientGame (char* address) {
 		video.clearScreen(0);
 		fontmn2->showString("WAITING FOR REPLY", canvasW >> 2, (canvasH >> 1) - 16);
 
-		ret = net->recv(sock, buffer + count, MTL_G_PROPS - count);
-
-		if (ret > 0) count += ret;
+		connection.receive();
+		message = connection.getMessage();
 
 		if (globalTicks > timeout) {
 
-			net->close(sock);
+			net->close(connection.getSocket());
 
 			throw E_TIMEOUT;
 
@@ -97,34 +100,34 @@ ClientGame::ClientGame (char* address) {
 	}
 
 	// Make sure message is valid
-	if (buffer[1] != MT_G_PROPS) {
+	if ((message[0] < MTL_G_PROPS) || (message[1] != MT_G_PROPS)) {
 
-		net->close(sock);
+		net->close(connection.getSocket());
 
 		throw E_DATA;
 
-	} else if (buffer[2] != 1) {
+	} else if (message[2] != NET_VERSION) {
 
-		net->close(sock);
+		net->close(connection.getSocket());
 
 		throw E_VERSION;
 
 	}
 
-	printf("Connected to server (version %d).\n", buffer[2]);
+	printf("Connected to server (version %d).\n", message[2]);
 
 	// Copy game parameters
-	modeType = GameModeType(buffer[3]);
-	difficulty = buffer[4];
-	maxPlayers = buffer[5];
-	nPlayers = buffer[6];
-	clientID = buffer[7];
+	modeType = GameModeType(message[3]);
+	difficulty = message[4];
+	maxPlayers = message[5];
+	nPlayers = message[6];
+	clientID = message[7];
 
 	printf("Game mode %d, difficulty %d, %d of %d players.\n", modeType, difficulty, nPlayers, maxPlayers);
 
-	if (nPlayers > maxPlayers) {
+	if ((nPlayers > maxPlayers) || (maxPlayers > MAX_PLAYERS)) {
 
-		net->close(sock);
+		net->close(connection.getSocket());
 
 		throw E_DATA;
 
@@ -135,7 +138,7 @@ ClientGame::ClientGame (char* address) {
 
 	if (!mode) {
 
-		net->close(sock);
+		net->close(connection.getSocket());
 
 		throw E_DATA;
 
@@ -150,15 +153,38 @@ ClientGame::ClientGame (char* address) {
 	// Download the level from the server
 
 	levelFile = createString(LEVEL_FILE);
-	file = NULL;
+	levelData = NULL;
+	levelSize = fileSize = downloaded = 0;
+	levelReady = false;
+	viewW = viewH = 0;
+
+	// Player updates use the connection until the server offers datagrams
+	datagramSock = -1;
+	datagrams = false;
+
+	if (netDatagrams) {
+
+		datagramSock = net->joinDatagrams(address);
+
+		if (datagramSock < 0) {
+
+			log("Could not open datagram socket - code", datagramSock);
+
+			datagramSock = -1;
+
+		}
+
+	}
 
 	ret = setLevel(NULL);
 
 	if (ret < 0) {
 
-		net->close(sock);
+		net->close(connection.getSocket());
+
+		if (datagramSock != -1) net->close(datagramSock);
 
-		if (file) delete file;
+		if (levelData) delete[] levelData;
 
 		delete mode;
 
@@ -186,9 +212,11 @@ ClientGame::ClientGame (char* address) {
 
 		if (loop(NORMAL_LOOP) == E_QUIT) {
 
-			net->close(sock);
+			net->close(connection.getSocket());
 
-			if (file) delete file;
+			if (datagramSock != -1) net->close(datagramSock);
+
+			if (levelData) delete[] levelData;
 
 			delete mode;
 
@@ -198,9 +226,11 @@ ClientGame::ClientGame (char* address) {
 
 		if (controls.release(C_ESCAPE)) {
 
-			net->close(sock);
+			net->close(connection.getSocket());
+
+			if (datagramSock != -1) net->close(datagramSock);
 
-			if (file) delete file;
+			if (levelData) delete[] levelData;
 
 			delete mode;
 
@@ -215,9 +245,11 @@ ClientGame::ClientGame (char* address) {
 
 		if (ret < 0) {
 
-			net->close(sock);
+			net->close(connection.getSocket());
 
-			if (file) delete file;
+			if (datagramSock != -1) net->close(datagramSock);
+
+			if (levelData) delete[] levelData;
 
 			delete mode;
 
@@ -237,9 +269,17 @@ ClientGame::ClientGame (char* address) {
  */
 ClientGame::~ClientGame () {
 
-	net->close(sock);
+	connection.flush();
+	net->close(connection.getSocket());
+
+	if (datagramSock != -1) {
+
+		netSimulator.discard(datagramSock);
+		net->close(datagramSock);
+
+	}
 
-	if (file) delete file;
+	if (levelData) delete[] levelData;
 
 	delete mode;
 
@@ -263,8 +303,8 @@ int ClientGame::setLevel (char* fileName) {
 
 	video.setPalette(menuPalette);
 
-	// Wait for level data to start arriving
-	while (!file && levelFile) {
+	// Wait for the level to be announced, and downloaded if it is not cached
+	while (!levelReady) {
 
 		if (loop(NORMAL_LOOP) == E_QUIT) return E_QUIT;
 
@@ -273,7 +313,18 @@ int ClientGame::setLevel (char* fileName) {
 		SDL_Delay(T_MENU_FRAME);
 
 		video.clearScreen(0);
-		fontmn2->showString("WAITING FOR SERVER", canvasW >> 2, (canvasH >> 1) - 16);
+
+		if (levelData) {
+
+			fontmn2->showString("downloaded", canvasW >> 2, (canvasH >> 1) - 16);
+			fontmn2->showNumber(downloaded, (canvasW >> 2) + 56, canvasH >> 1);
+			fontmn2->showString("bytes", (canvasW >> 2) + 64, canvasH >> 1);
+
+		} else {
+
+			fontmn2->showString("WAITING FOR SERVER", canvasW >> 2, (canvasH >> 1) - 16);
+
+		}
 
 		ret = step(0);
 
@@ -281,39 +332,217 @@ int ClientGame::setLevel (char* fileName) {
 
 	}
 
-	// Wait for level data to finish arriving
-	while (file && levelFile) {
+	// The next announcement will be for the level after this one
+	levelReady = false;
 
-		if (loop(NORMAL_LOOP) == E_QUIT) return E_QUIT;
+	return E_NONE;
 
-		if (controls.release(C_ESCAPE)) return E_RETURN;
+}
 
-		SDL_Delay(T_MENU_FRAME);
 
-		video.clearScreen(0);
-		fontmn2->showString("downloaded", canvasW >> 2, (canvasH >> 1) - 16);
-		fontmn2->showNumber(file->tell(), (canvasW >> 2) + 56, canvasH >> 1);
-		fontmn2->showString("bytes", (canvasW >> 2) + 64, canvasH >> 1);
+/**
+ * Check whether or not the level file already holds the announced level, from
+ * an earlier download
+ *
+ * @param hash Hash of the announced level file
+ *
+ * @return True if the file can be used as it is
+ */
+bool ClientGame::isCached (unsigned int hash) {
 
-		ret = step(0);
+	File* file;
+	unsigned char* fileData;
+	bool cached;
 
-		if (ret < 0) return ret;
+	try {
+
+		file = new File(levelFile, false);
+
+	} catch (int e) {
+
+		return false;
+
+	}
+
+	cached = false;
+
+	if (file->getSize() == fileSize) {
+
+		fileData = file->loadBlock(fileSize);
+		cached = (createHash(fileData, fileSize) == hash);
+		delete[] fileData;
+
+	}
+
+	delete file;
+
+	return cached;
+
+}
+
+
+/**
+ * Note that a level file is the most recently used, and delete the least
+ * recently used level files beyond LEVEL_CACHE_FILES
+ *
+ * @param hash Hash of the level file
+ */
+void ClientGame::useCachedLevel (unsigned int hash) {
+
+	File* file;
+	unsigned int hashes[LEVEL_CACHE_FILES + 1];
+	int sizes[LEVEL_CACHE_FILES + 1];
+	char name[sizeof(LEVEL_CACHE) + 16];
+	int count, nLevels;
+
+	// Load the list of level files
+	try {
+
+		file = new File(LEVEL_CACHE_INDEX, false);
+
+	} catch (int e) {
+
+		file = NULL;
+
+	}
+
+	nLevels = 0;
+
+	if (file) {
+
+		nLevels = file->getSize() / 8;
+		if (nLevels > LEVEL_CACHE_FILES) nLevels = LEVEL_CACHE_FILES;
+
+		for (count = 0; count < nLevels; count++) {
+
+			hashes[count] = file->loadInt();
+			sizes[count] = file->loadInt();
+
+		}
+
+		delete file;
+
+	}
+
+	// Move the level to the end of the list
+	for (count = 0; count < nLevels; count++) {
+
+		if ((hashes[count] == hash) && (sizes[count] == fileSize)) {
+
+			nLevels--;
+			memmove(hashes + count, hashes + count + 1, (nLevels - count) * sizeof(unsigned int));
+			memmove(sizes + count, sizes + count + 1, (nLevels - count) * sizeof(int));
+
+			break;
+
+		}
+
+	}
+
+	hashes[nLevels] = hash;
+	sizes[nLevels] = fileSize;
+	nLevels++;
+
+	// Delete the least recently used level file, if there are too many
+	if (nLevels > LEVEL_CACHE_FILES) {
+
+		sprintf(name, LEVEL_CACHE, hashes[0], sizes[0]);
+		File::remove(name);
+
+		nLevels--;
+		memmove(hashes, hashes + 1, nLevels * sizeof(unsigned int));
+		memmove(sizes, sizes + 1, nLevels * sizeof(int));
+
+	}
+
+	// Save the list
+	try {
+
+		file = new File(LEVEL_CACHE_INDEX, true);
+
+	} catch (int e) {
+
+		return;
+
+	}
+
+	for (count = 0; count < nLevels; count++) {
+
+		file->storeInt(hashes[count]);
+		file->storeInt(sizes[count]);
+
+	}
+
+	delete file;
+
+	return;
+
+}
+
+
+/**
+ * Decompress the level data which has been received, and write it to the
+ * level file
+ *
+ * @return Error code
+ */
+int ClientGame::saveLevel () {
+
+	File* file;
+	unsigned char* fileData;
+	mz_ulong length;
+	int ret;
+
+	fileData = new unsigned char[fileSize];
+	length = fileSize;
+
+	ret = mz_uncompress(fileData, &length, levelData, levelSize);
+
+	delete[] levelData;
+	levelData = NULL;
+
+	if ((ret != MZ_OK) || (length != (mz_ulong)fileSize)) {
+
+		delete[] fileData;
+
+		return E_DATA;
 
 	}
 
+	try {
+
+		file = new File(levelFile, true);
+
+	} catch (int e) {
+
+		delete[] fileData;
+
+		return e;
+
+	}
+
+	file->storeBlock(fileData, fileSize);
+
+	delete file;
+	delete[] fileData;
+
+	levelReady = true;
+
 	return E_NONE;
 
 }
 
 
 /**
- * Send data to server
+ * Send data to server. The data is sent at the end of the current step.
  *
  * @param buffer Data to send. First byte indicates length.
  */
 void ClientGame::send (unsigned char* buffer) {
 
-	net->send(sock, buffer);
+	// Changes which have already been made locally are remembered until the
+	// server accepts them. Those which could not be sent are not waited for.
+	if (connection.queue(buffer)) prediction.add(buffer);
 
 	return;
 
@@ -321,191 +550,260 @@ void ClientGame::send (unsigned char* buffer) {
 
 
 /**
- * Game iteration
+ * Process a message from the server
  *
- * @param ticks Current time
+ * @param buffer The message. First byte indicates length.
  *
  * @return Error code
  */
-int ClientGame::step (unsigned int ticks) {
+int ClientGame::receive (unsigned char* buffer) {
 
-	unsigned char sendBuffer[BUFFER_LENGTH];
-	int length, count;
-	bool firstMessage;
+	unsigned char reply[MTL_G_LREQ];
+	unsigned char temp[MTL_P_TEMP];
+	unsigned int hash;
+	int count, offset, length;
 
-	// Receive data from server
+	switch (buffer[1] & MCMASK) {
 
-	if (received == 0) {
+		case MC_GAME:
 
-		// Not currently receiving a message
-		// See if there is a new message to receive
+			if (buffer[1] == MT_G_LEVEL) {
 
-		length = net->recv(sock, recvBuffer, 1);
+				// Ignore level data unless its size has been given
+				if (!levelData) break;
 
-		if (length > 0) received++;
+				// If a zero-length block has been sent, it is the last
+				if (buffer[0] == MTL_G_LEVEL) return saveLevel();
 
-	}
+				offset = (buffer[2] << 24) + (buffer[3] << 16) + (buffer[4] << 8) + buffer[5];
+				length = buffer[0] - MTL_G_LEVEL;
 
-	if (received > 0) {
+				if ((offset < 0) || (offset + length > levelSize)) return E_DATA;
 
-		// Currently receiving a message
-		// See if there is any more data
+				memcpy(levelData + offset, buffer + MTL_G_LEVEL, length);
+				downloaded += length;
 
-		length = net->recv(sock, recvBuffer + received,
-			recvBuffer[0] - received);
+				break;
 
-		if (length > 0) received += length;
+			}
 
+			if ((buffer[1] == MT_G_PJOIN) &&
+				(buffer[3] < maxPlayers)) {
 
-		// See if the whole message has arrived
+				printf("Player %d joined the game.\n", buffer[3]);
 
-		if (received >= recvBuffer[0]) {
+				// Add the new player, and any that have been missed
 
-			switch (recvBuffer[1] & MCMASK) {
+				for (count = nPlayers; count <= buffer[3]; count++) {
 
-				case MC_GAME:
+					players[count].init(this, (char *)buffer + 9,
+						buffer + 5, buffer[4]);
+					addLevelPlayer(players + count);
 
-					if (recvBuffer[1] == MT_G_LEVEL) {
+					printf("Player %d joined team %d.\n", count, buffer[4]);
 
-						if (!file) {
+				}
 
-							// Not already storing level data, so open the file
+				nPlayers = count;
 
-							try {
+				if (buffer[2] == clientID)
+					localPlayer = players + buffer[3];
 
-								file = new File(levelFile, true);
+			}
 
-							} catch (int e) {
+			if ((buffer[1] == MT_G_PQUIT) &&
+				(buffer[2] < nPlayers)) {
 
-								return e;
+				printf("Player %d left the game.\n", buffer[2]);
 
-							}
+				// Remove the player
 
-							firstMessage = true;
+				players[buffer[2]].deinit();
 
-						} else firstMessage = false;
+				// If necessary, move more recent players
+				for (count = buffer[2]; count < nPlayers; count++)
+					memcpy(static_cast<void*>(players + count), players + count + 1,
+						sizeof(Player));
 
-						file->seek((recvBuffer[2] << 8) + recvBuffer[3], true);
+				// Clear duplicate pointers
+				memset(static_cast<void*>(players + nPlayers), 0, sizeof(Player));
 
-						for (count = 4; count < recvBuffer[0]; count++)
-							file->storeChar(recvBuffer[count]);
+				// The remaining players have moved, so their baselines no
+				// longer apply
+				for (count = 0; count < maxPlayers; count++) {
 
-						// If a zero-length block has been sent, it is the last
-						if (recvBuffer[0] == MTL_G_LEVEL) {
+					snapshots[count].reset();
+					interpolators[count].reset();
 
-							if (firstMessage) {
+				}
 
-								// If the last message was also the first,
-								// then the run of levels has ended
+			}
 
-								delete[] levelFile;
-								levelFile = NULL;
+			if ((buffer[1] == MT_G_UDP) && (buffer[0] >= MTL_G_UDP) &&
+				(datagramSock != -1) && !channel.isOpen()) {
 
-							}
+				// Identify the client's datagrams with the server's token
+				channel.open(datagramSock, clientID,
+					(buffer[2] << 24) + (buffer[3] << 16) + (buffer[4] << 8) + buffer[5],
+					&snapshot, 1);
 
-							delete file;
-							file = NULL;
+			}
 
-						}
+			if ((buffer[1] == MT_G_ACK) && (buffer[0] >= MTL_G_ACK))
+				prediction.accept((buffer[2] << 8) + buffer[3]);
 
-						break;
+			// Ignore changes which a local change will replace
+			if ((buffer[1] == MT_G_CHECK) && !prediction.isReplaced(buffer)) {
 
-					}
+				checkX = buffer[2];
+				checkY = buffer[3];
 
-					if ((recvBuffer[1] == MT_G_PJOIN) &&
-						(recvBuffer[3] < maxPlayers)) {
+				if (buffer[0] > 4) {
 
-						printf("Player %d joined the game.\n", recvBuffer[3]);
+					checkX += buffer[4] << 8;
+					checkY += buffer[5] << 8;
 
-						// Add the new player, and any that have been missed
+				}
 
-						for (count = nPlayers; count <= recvBuffer[3]; count++) {
+			}
 
-							players[count].init(this, (char *)recvBuffer + 9,
-								recvBuffer + 5, recvBuffer[4]);
-							addLevelPlayer(players + count);
+			if (buffer[1] == MT_G_SCORE) {
 
-							printf("Player %d joined team %d.\n", count, recvBuffer[4]);
+				for (count = 0; count < nPlayers; count++) {
 
-						}
+					if (players[count].getTeam() == buffer[2])
+						players[count].teamScore++;
 
-						nPlayers = count;
+				}
 
-						if (recvBuffer[2] == clientID)
-							localPlayer = players + recvBuffer[3];
+			}
 
-					}
+			if (buffer[1] == MT_G_LTYPE) {
 
-					if ((recvBuffer[1] == MT_G_PQUIT) &&
-						(recvBuffer[2] < nPlayers)) {
+				levelType = (LevelType)buffer[2];
+				fileSize = (buffer[3] << 24) + (buffer[4] << 16) + (buffer[5] << 8) + buffer[6];
+				levelSize = (buffer[7] << 24) + (buffer[8] << 16) + (buffer[9] << 8) + buffer[10];
+				hash = (buffer[11] << 24) + (buffer[12] << 16) + (buffer[13] << 8) + buffer[14];
 
-						printf("Player %d left the game.\n", recvBuffer[2]);
+				if ((fileSize < 0) || (levelSize < 0)) return E_DATA;
 
-						// Remove the player
+				if (levelData) delete[] levelData;
+				levelData = NULL;
 
-						players[recvBuffer[2]].deinit();
+				if (levelFile) delete[] levelFile;
 
-						// If necessary, move more recent players
-						for (count = recvBuffer[2]; count < nPlayers; count++)
-							memcpy(static_cast<void*>(players + count), players + count + 1,
-								sizeof(Player));
+				if (!levelSize) {
 
-						// Clear duplicate pointers
-						memset(static_cast<void*>(players + nPlayers), 0, sizeof(Player));
+					// An empty level means the run of levels has ended
 
-					}
+					levelFile = NULL;
+					levelReady = true;
 
-					if (recvBuffer[1] == MT_G_CHECK) {
+					break;
 
-						checkX = recvBuffer[2];
-						checkY = recvBuffer[3];
+				}
 
-						if (recvBuffer[0] > 4) {
+				// Levels are stored under their hash and size, so an
+				// identical level from an earlier game can be reused
+				levelFile = new char[strlen(LEVEL_CACHE) + 16];
+				sprintf(levelFile, LEVEL_CACHE, hash, fileSize);
 
-							checkX += recvBuffer[4] << 8;
-							checkY += recvBuffer[5] << 8;
+				reply[0] = MTL_G_LREQ;
+				reply[1] = MT_G_LREQ;
 
-						}
+				if (isCached(hash)) {
 
-					}
+					reply[2] = 0;
+					levelReady = true;
 
-					if (recvBuffer[1] == MT_G_SCORE) {
+				} else {
 
-						for (count = 0; count < nPlayers; count++) {
+					// Prepare to receive the level data
+					reply[2] = 1;
+					levelData = new unsigned char[levelSize];
+					downloaded = 0;
 
-							if (players[count].getTeam() == recvBuffer[2])
-								players[count].teamScore++;
+				}
 
-						}
+				useCachedLevel(hash);
 
-					}
+				send(reply);
 
-					if (recvBuffer[1] == MT_G_LTYPE) {
+			}
 
-						levelType = (LevelType)recvBuffer[2];
+			break;
 
-					}
+		case MC_LEVEL:
 
-					break;
+			// Ignore changes which a local change will replace
+			if (baseLevel && !prediction.isReplaced(buffer)) baseLevel->receive(buffer);
 
-				case MC_LEVEL:
+			break;
 
-					if (baseLevel) baseLevel->receive(recvBuffer);
+		case MC_PLAYER:
 
-					break;
+			if (buffer[2] >= maxPlayers) break;
 
-				case MC_PLAYER:
+			if (buffer[1] == MT_P_DELTA) {
 
-					if (recvBuffer[2] < maxPlayers)
-						players[recvBuffer[2]].receive(recvBuffer);
+				// Wait for a full snapshot if the baseline is missing
+				if (!snapshots[buffer[2]].decode(buffer, temp)) break;
 
-					break;
+				buffer = temp;
 
 			}
 
-			received = 0;
+			// Remote players are moved smoothly from one update to the next
+			if (buffer[1] == MT_P_TEMP) interpolators[buffer[2]].add(buffer, globalTicks);
+			else players[buffer[2]].receive(buffer);
 
-		}
+			break;
+
+	}
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Game iteration
+ *
+ * @param ticks Current time
+ *
+ * @return Error code
+ */
+int ClientGame::step (unsigned int ticks) {
+
+	unsigned char sendBuffer[BUFFER_LENGTH];
+	unsigned char delta[BUFFER_LENGTH];
+	unsigned char* message;
+	int count, ret, received, length;
+	bool ready;
+
+	// Receive data from server, and process every complete message
+
+	connection.receive();
+
+	while ((message = connection.getMessage())) {
+
+		ready = levelReady;
+
+		ret = receive(message);
+
+		if (ret < 0) return ret;
+
+		// Leave later messages until the new level has been loaded
+		if (!ready && levelReady) break;
+
+	}
+
+	received = (datagramSock != -1)? receiveDatagrams(): 0;
+
+	for (count = 0; count < nPlayers; count++) {
+
+		if ((players + count != localPlayer) && interpolators[count].get(globalTicks, sendBuffer))
+			players[count].receive(sendBuffer);
 
 	}
 
@@ -513,19 +811,40 @@ int ClientGame::step (unsigned int ticks) {
 
 		// Check for disconnection
 
-		if (!(net->isConnected(sock))) {
+		if (!(net->isConnected(connection.getSocket()))) {
 
-			if (file) delete file;
-			file = NULL;
+			if (levelData) delete[] levelData;
+			levelData = NULL;
 
 			return E_N_DISCONNECT;
 
 		}
 
+		// Until the server replies, keep sending empty datagrams so that it
+		// learns where the client's datagrams come from
+		if (channel.isOpen() && !datagrams) channel.flush(true);
+
 		checkTime = ticks + T_CCHECK;
 
 	}
 
+	if (localPlayer && ((viewW != canvasW) || (viewH != canvasH))) {
+
+		// Tell the server how much of the level can be seen, so that it can
+		// send distant players less often
+		viewW = canvasW;
+		viewH = canvasH;
+
+		sendBuffer[0] = MTL_G_VIEW;
+		sendBuffer[1] = MT_G_VIEW;
+		sendBuffer[2] = viewW >> 8;
+		sendBuffer[3] = viewW & 255;
+		sendBuffer[4] = viewH >> 8;
+		sendBuffer[5] = viewH & 255;
+		connection.queue(sendBuffer);
+
+	}
+
 	if (localPlayer && (ticks >= sendTime)) {
 
 		// Update server
@@ -534,25 +853,87 @@ int ClientGame::step (unsigned int ticks) {
 		sendBuffer[1] = MT_P_TEMP;
 		sendBuffer[2] = 0;
 		localPlayer->send(sendBuffer);
-		send(sendBuffer);
+
+		// Only send what has changed since the last update
+		snapshot.encode(sendBuffer, delta);
+
+		if (datagrams) channel.queue(delta);
+		else if (!connection.queue(delta)) snapshot.reset();
 
 		sendTime = ticks + T_CSEND;
 
 	}
 
+	// Send everything from this step together
+	connection.flush();
+
+	length = datagrams? channel.flush(): 0;
+	netSimulator.flush();
+
+	memcpy(&netStats, connection.getStats(), sizeof(NetStats));
+	netStats.bytes += received;
+	if (length > 0) netStats.sent += length;
+
 	return E_NONE;
 
 }
 
 
 /**
- * Ask server to award team a point
+ * Process the datagrams which have arrived from the server. Only player
+ * updates are accepted this way.
+ *
+ * @return Number of bytes received
+ */
+int ClientGame::receiveDatagrams () {
+
+	unsigned char datagram[DATAGRAM_SIZE];
+	unsigned char* message;
+	int length, total;
+
+	total = 0;
+
+	while ((length = net->recvFrom(datagramSock, NULL, datagram, DATAGRAM_SIZE)) >= 0) {
+
+		if (!channel.receive(datagram, length)) continue;
+
+		total += length;
+
+		if (!datagrams) {
+
+			printf("Exchanging player updates in datagrams.\n");
+
+			// From now on, updates may be lost, so only those which are
+			// acknowledged can be used as baselines
+			datagrams = true;
+			snapshot.useAcks(true);
+
+		}
+
+		while ((message = channel.getMessage())) {
+
+			if (((message[1] == MT_P_TEMP) && (message[0] >= MTL_P_TEMP)) ||
+				(message[1] == MT_P_DELTA))
+				receive(message);
+
+		}
+
+	}
+
+	return total;
+
+}
+
+
+/**
+ * Award team a point, and ask server to do the same
  *
  * @param team Team to receive point
  */
 void ClientGame::score (unsigned char team) {
 
 	unsigned char buffer[MTL_G_SCORE];
+	int count;
 
 	// Inform server
 	buffer[0] = MTL_G_SCORE;
@@ -560,13 +941,20 @@ void ClientGame::score (unsigned char team) {
 	buffer[2] = team;
 	send(buffer);
 
+	// Update self, without waiting for the server
+	for (count = 0; count < nPlayers; count++) {
+
+		if (players[count].getTeam() == team) players[count].teamScore++;
+
+	}
+
 	return;
 
 }
 
 
 /**
- * Ask server to approve new checkpoint
+ * Set the checkpoint, and ask server to do the same
  *
  * @param gridX X-coordinate (in tiles) of the checkpoint
  * @param gridY Y-coordinate (in tiles) of the checkpoint
@@ -575,6 +963,10 @@ void ClientGame::setCheckpoint (int gridX, int gridY) {
 
 	unsigned char buffer[MTL_G_CHECK];
 
+	// Update self, without waiting for the server
+	checkX = gridX;
+	checkY = gridY;
+
 	buffer[0] = MTL_G_CHECK;
 	buffer[1] = MT_G_CHECK;
 	buffer[2] = gridX & 0xFF;
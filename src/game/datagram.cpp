@@ -0,0 +1,333 @@
+
+/**
+ *
+ * @file datagram.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 18th October 2026: Created datagram.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2026 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Player updates sent in datagrams. Late player updates are no use, so lost
+ * ones are not sent again. Instead, each datagram acknowledges the ones which
+ * have arrived, and only the player updates in those become baselines for
+ * later updates.
+ *
+ * Sequence numbers run from 1 to 65535, then start again at 1.
+ *
+ * Datagram layout:
+ * - 0: Client ID
+ * - 1-4: Token given to the client by the server
+ * - 5-6: Sequence number of this datagram
+ * - 7-8: Sequence number of the latest datagram received, or 0
+ * - 9-12: Bits showing which of the 32 datagrams before that were received
+ * - 13+: Messages, each starting with its length
+ *
+ */
+
+
+#include "game.h"
+
+#include <string.h>
+
+
+/**
+ * Find how many datagrams one sequence number is after another.
+ *
+ * @param later The later sequence number
+ * @param earlier The earlier sequence number
+ *
+ * @return Number of datagrams between them
+ */
+static int getDistance (unsigned short later, unsigned short earlier) {
+
+	return ((int)later - (int)earlier + 65535) % 65535;
+
+}
+
+
+/**
+ * Create a closed channel.
+ */
+DatagramChannel::DatagramChannel () {
+
+	open(-1, 0, 0, NULL, 0);
+
+	return;
+
+}
+
+
+/**
+ * Start exchanging datagrams, forgetting any previous exchange.
+ *
+ * @param newSock Datagram socket, or -1 to close the channel
+ * @param newClientID The client's index on the server
+ * @param newToken Identifies the client's datagrams
+ * @param newBaselines Baselines of the players whose updates are sent
+ * @param newNBaselines Number of baselines
+ */
+void DatagramChannel::open (int newSock, int newClientID, unsigned int newToken, Snapshot* newBaselines, int newNBaselines) {
+
+	sock = newSock;
+	clientID = newClientID;
+	token = newToken;
+	baselines = newBaselines;
+	nBaselines = newNBaselines;
+
+	memset(sent, 0, sizeof(sent));
+	received = 0;
+	receivedBits = 0;
+	sequence = 0;
+	inputLength = inputPosition = 0;
+	addressed = false;
+	ackDue = false;
+
+	startOutput();
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not datagrams can be exchanged.
+ *
+ * @return True if the channel is open
+ */
+bool DatagramChannel::isOpen () {
+
+	return sock != -1;
+
+}
+
+
+/**
+ * Set the address to which datagrams are sent, when the socket is not
+ * connected.
+ *
+ * @param newAddress The address
+ */
+void DatagramChannel::setAddress (NetAddress *newAddress) {
+
+	address = *newAddress;
+	addressed = true;
+
+	return;
+
+}
+
+
+/**
+ * Begin filling the next datagram.
+ */
+void DatagramChannel::startOutput () {
+
+	sequence = (sequence % 65535) + 1;
+
+	sent[sequence % DATAGRAM_WINDOW] = 0;
+	memset(updates[sequence % DATAGRAM_WINDOW], 0, MAX_PLAYERS);
+
+	outputLength = DATAGRAM_HEADER;
+
+	return;
+
+}
+
+
+/**
+ * Note that a sent datagram has arrived, so the player updates in it can be
+ * used as baselines.
+ *
+ * @param ackSequence Sequence number of the datagram
+ */
+void DatagramChannel::acknowledge (unsigned short ackSequence) {
+
+	int slot, count;
+
+	slot = ackSequence % DATAGRAM_WINDOW;
+
+	// Ignore datagrams which are no longer remembered, or already acknowledged
+	if (sent[slot] != ackSequence) return;
+
+	sent[slot] = 0;
+
+	for (count = 0; count < nBaselines; count++) {
+
+		if (updates[slot][count]) baselines[count].acknowledge(updates[slot][count]);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Accept a datagram from the other end, if it is the latest yet.
+ *
+ * @param datagram The datagram
+ * @param length Length of the datagram
+ *
+ * @return True if the datagram's messages can be read with getMessage()
+ */
+bool DatagramChannel::receive (unsigned char *datagram, int length) {
+
+	unsigned int datagramToken, ackBits;
+	unsigned short datagramSequence, ack;
+	int distance, count;
+
+	if ((sock == -1) || (length < DATAGRAM_HEADER) || (length > DATAGRAM_SIZE))
+		return false;
+
+	datagramToken = (datagram[1] << 24) + (datagram[2] << 16) + (datagram[3] << 8) + datagram[4];
+
+	if ((datagram[0] != clientID) || (datagramToken != token)) return false;
+
+	datagramSequence = (datagram[5] << 8) + datagram[6];
+
+	if (!datagramSequence) return false;
+
+	if (received) {
+
+		distance = getDistance(datagramSequence, received);
+
+		// Ignore duplicates, and datagrams overtaken by later ones
+		if (!distance || (distance >= 32768)) return false;
+
+		if (distance < 32) receivedBits = (receivedBits << distance) | (1 << (distance - 1));
+		else if (distance == 32) receivedBits = 1u << 31;
+		else receivedBits = 0;
+
+	}
+
+	received = datagramSequence;
+	ackDue = true;
+
+	// Process acknowledgements
+	ack = (datagram[7] << 8) + datagram[8];
+	ackBits = (datagram[9] << 24) + (datagram[10] << 16) + (datagram[11] << 8) + datagram[12];
+
+	if (ack) {
+
+		acknowledge(ack);
+
+		for (count = 0; count < 32; count++) {
+
+			if (ackBits & (1u << count))
+				acknowledge(((int)ack - count - 2 + 65535) % 65535 + 1);
+
+		}
+
+	}
+
+	memcpy(input, datagram, length);
+	inputLength = length;
+	inputPosition = DATAGRAM_HEADER;
+
+	return true;
+
+}
+
+
+/**
+ * Get the next message from the last datagram received.
+ *
+ * @return The message, or NULL if there are no more
+ */
+unsigned char* DatagramChannel::getMessage () {
+
+	unsigned char* message;
+
+	if (inputPosition >= inputLength) return NULL;
+
+	message = input + inputPosition;
+
+	// Ignore the rest of the datagram if it is malformed
+	if ((message[0] < 2) || (inputPosition + message[0] > inputLength)) {
+
+		inputPosition = inputLength;
+
+		return NULL;
+
+	}
+
+	inputPosition += message[0];
+
+	return message;
+
+}
+
+
+/**
+ * Add a message to the next datagram. If the datagram is full, it is sent
+ * first.
+ *
+ * @param data The message. First byte indicates length.
+ */
+void DatagramChannel::queue (unsigned char *data) {
+
+	if (sock == -1) return;
+
+	if (outputLength + data[0] > DATAGRAM_SIZE) flush(true);
+
+	memcpy(output + outputLength, data, data[0]);
+	outputLength += data[0];
+
+	// Remember which player updates went in the datagram
+	if ((data[1] == MT_P_DELTA) && (data[2] < nBaselines))
+		updates[sequence % DATAGRAM_WINDOW][data[2]] = data[3];
+
+	return;
+
+}
+
+
+/**
+ * Send the datagram which has been filled, if it holds messages or there are
+ * datagrams to acknowledge.
+ *
+ * @param force Whether or not to send the datagram even if it is empty
+ *
+ * @return Number of bytes sent, or -1 for failure
+ */
+int DatagramChannel::flush (bool force) {
+
+	int length;
+
+	if ((sock == -1) || ((outputLength == DATAGRAM_HEADER) && !ackDue && !force))
+		return 0;
+
+	output[0] = clientID;
+	output[1] = token >> 24;
+	output[2] = (token >> 16) & 255;
+	output[3] = (token >> 8) & 255;
+	output[4] = token & 255;
+	output[5] = sequence >> 8;
+	output[6] = sequence & 255;
+	output[7] = received >> 8;
+	output[8] = received & 255;
+	output[9] = receivedBits >> 24;
+	output[10] = (receivedBits >> 16) & 255;
+	output[11] = (receivedBits >> 8) & 255;
+	output[12] = receivedBits & 255;
+
+	sent[sequence % DATAGRAM_WINDOW] = sequence;
+
+	length = netSimulator.send(sock, addressed? &address: NULL, output, outputLength);
+
+	ackDue = false;
+
+	startOutput();
+
+	return length;
+
+}
+
@@ -26,13 +26,16 @@
 #include "game.h"
 #include "gamemode.h"
 
+#include "benchmark.h"
 #include "io/gfx/video.h"
 #include "io/sound.h"
 #include "jj1bonuslevel/jj1bonuslevel.h"
 #include "jj1level/jj1level.h"
 #include "jj1planet/jj1planet.h"
 #include "jj2level/jj2level.h"
+#include "level/replay.h"
 #include "player/player.h"
+#include "loop.h"
 #include "util.h"
 
 #include <string.h>
@@ -49,6 +52,8 @@ Game::Game () {
 	players = NULL;
 	baseLevel = NULL;
 
+	memset(&netStats, 0, sizeof(NetStats));
+
 	return;
 
 }
@@ -142,6 +147,34 @@ GameMode* Game::getMode () {
 }
 
 
+/**
+ * Get the rate at which data is sent to the client controlling a player
+ *
+ * @param player The player's index
+ *
+ * @return Bytes per second, or -1 if not applicable
+ */
+int Game::getBandwidth (int player) {
+
+	(void)player;
+
+	return -1;
+
+}
+
+
+/**
+ * Get the amount of data received from other players during the last step
+ *
+ * @return Reception statistics, totalled over all connections
+ */
+const NetStats* Game::getNetStats () {
+
+	return &netStats;
+
+}
+
+
 /**
  * Get the game's difficulty
  *
@@ -245,7 +278,7 @@ int Game::playLevel (char* fileName, bool intro, bool checkpoint) {
 
 		}
 
-		if (intro) {
+		if (intro && !headless && !benchmark.isActive()) {
 
 			JJ1Planet *planet;
 			char *planetFileName = NULL;
@@ -342,6 +375,9 @@ int Game::play () {
 	checkpoint = false;
 	planetId = -1;
 
+	// Record or play back single-player games
+	if (!multiplayer && levelFile) replay.start(levelFile, difficulty);
+
 	// Play the level(s)
 	while (true) {
 
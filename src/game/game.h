@@ -32,6 +32,9 @@
 
 // Constants
 
+// Protocol version, sent in MT_G_PROPS
+#define NET_VERSION 8
+
 // Time intervals
 #define T_SSEND   20
 #define T_SCHECK  1000
@@ -50,7 +53,12 @@
 #define MT_G_LEVEL 0x03 /* Level data */
 #define MT_G_CHECK 0x04
 #define MT_G_SCORE 0x05 /* Team scored a roast/lap/etc. */
-#define MT_G_LTYPE 0x06 /* Level type */
+#define MT_G_LTYPE 0x06 /* Level type, size and hash */
+#define MT_G_LREQ  0x07 /* Whether or not a client needs the level data */
+#define MT_G_PING  0x08 /* Timestamp, returned to the sender to measure latency */
+#define MT_G_VIEW  0x09 /* Size of a client's view */
+#define MT_G_UDP   0x0A /* Token identifying a client's datagrams */
+#define MT_G_ACK   0x0B /* Number of a client's predicted changes accepted */
 
 #define MT_L_PROP  0x10 /* Level property */
 #define MT_L_GRID  0x11 /* Change to gridElement */
@@ -58,15 +66,21 @@
 
 #define MT_P_ANIMS 0x20 /* Player animations */
 #define MT_P_TEMP  0x21 /* Temporary player properties, e.g. position */
+#define MT_P_DELTA 0x22 /* Changes to temporary player properties, as sent */
 
 // Minimum message lengths, including header
 #define MTL_G_PROPS 8
 #define MTL_G_PJOIN 10
 #define MTL_G_PQUIT 3
-#define MTL_G_LEVEL 4 /* + amount of level data */
+#define MTL_G_LEVEL 6 /* + amount of level data */
 #define MTL_G_CHECK 6
 #define MTL_G_SCORE 3
-#define MTL_G_LTYPE 3
+#define MTL_G_LTYPE 15
+#define MTL_G_LREQ  3
+#define MTL_G_PING  6
+#define MTL_G_VIEW  6
+#define MTL_G_UDP   6
+#define MTL_G_ACK   4
 
 #define MTL_L_PROP  5
 #define MTL_L_GRID  8
@@ -74,14 +88,148 @@
 
 #define MTL_P_ANIMS 3 /* + PANIMS, BPANIMS, or 1 (for JJ2) */
 #define MTL_P_TEMP  46
+#define MTL_P_DELTA 6 /* + changed properties */
 
 #define BUFFER_LENGTH 255 /* Should always be big enough to hold any message */
 
+// Level transfer
+#define LEVEL_CHUNK  (BUFFER_LENGTH - MTL_G_LEVEL) /* Most level data in one message */
+#define LEVEL_BUDGET 12288 /* Most level data sent to each client per step */
+
+// Player property deltas
+#define SNAPSHOT_FULL    50 /* Number of deltas between full snapshots */
+#define SNAPSHOT_SHIFT   6 /* Number of fractional position bits which are not sent */
+#define SNAPSHOT_HISTORY 32 /* Number of recent properties kept as possible baselines */
+
+// Datagrams
+#define DATAGRAM_HEADER 13 /* Client ID, token, sequence number, acknowledgements */
+#define DATAGRAM_WINDOW 64 /* Number of sent datagrams remembered until acknowledged */
+
+// Remote player smoothing
+#define T_INTERP       100 /* How far behind the latest properties remote players are shown */
+#define INTERP_SAMPLES 8 /* Number of received properties kept for each remote player */
+#define INTERP_GAP     200 /* Longest time between properties which remote players glide between */
+#define INTERP_SNAP    ITOF(64) /* Distance beyond which remote players jump rather than glide */
+
+// Client-side prediction
+#define PREDICTIONS    64 /* Most changes awaiting acceptance by the server which are remembered */
+#define PREDICTION_KEY 4 /* Most bytes identifying the state replaced by a change */
+
 
 // Classes
 
 class Anim;
-class File;
+
+/// The recent temporary player properties passed over a connection, which are
+/// the baselines for sending only the properties which have changed since
+class Snapshot {
+
+	private:
+		unsigned char states[SNAPSHOT_HISTORY][MTL_P_TEMP]; ///< Recent properties passed, in MT_P_TEMP form
+		unsigned char sequences[SNAPSHOT_HISTORY]; ///< Sequence number of each of the recent properties, or 0
+		unsigned char sequence; ///< Sequence number of the last properties passed (1 to 255)
+		unsigned char acknowledged; ///< Sequence number of the latest properties known to have arrived, or 0
+		int           deltas; ///< Number of deltas passed since the last full snapshot
+		bool          needsAcks; ///< Whether or not only properties known to have arrived can be baselines
+
+		unsigned char* getState (unsigned char stateSequence);
+
+	public:
+		Snapshot ();
+
+		void reset       ();
+		void useAcks     (bool acks);
+		void acknowledge (unsigned char ackSequence);
+		int  encode      (unsigned char *temp, unsigned char *buffer);
+		bool decode      (unsigned char *buffer, unsigned char *temp);
+
+};
+
+/// Exchanges player updates in datagrams, which may be lost, duplicated or
+/// reordered. Each datagram carries a sequence number and acknowledges the
+/// latest datagrams received, so that the updates known to have arrived can be
+/// used as baselines. Datagrams older than the latest received are ignored.
+class DatagramChannel {
+
+	private:
+		unsigned char  input[DATAGRAM_SIZE]; ///< The last datagram received
+		unsigned char  output[DATAGRAM_SIZE]; ///< Datagram being filled with messages
+		unsigned char  updates[DATAGRAM_WINDOW][MAX_PLAYERS]; ///< Sequence number of each player's update in each recent datagram, or 0
+		unsigned short sent[DATAGRAM_WINDOW]; ///< Sequence number of each recent datagram, or 0 once acknowledged
+		Snapshot*      baselines; ///< Baselines of the players whose updates are sent
+		int            nBaselines; ///< Number of baselines
+		NetAddress     address; ///< Address of the other end
+		unsigned int   token; ///< Identifies the client's datagrams
+		unsigned int   receivedBits; ///< Which of the 32 datagrams before the latest have been received
+		unsigned short sequence; ///< Sequence number of the datagram being filled
+		unsigned short received; ///< Sequence number of the latest datagram received, or 0
+		int            clientID; ///< The client's index on the server
+		int            sock; ///< Datagram socket, or -1
+		int            inputLength; ///< Length of the last datagram received
+		int            inputPosition; ///< Position of the next message in the last datagram received
+		int            outputLength; ///< Length of the datagram being filled
+		bool           addressed; ///< Whether the address is used, or the socket is connected
+		bool           ackDue; ///< Whether or not a datagram has arrived since the last was sent
+
+		void acknowledge (unsigned short ackSequence);
+		void startOutput ();
+
+	public:
+		DatagramChannel ();
+
+		void           open       (int newSock, int newClientID, unsigned int newToken, Snapshot* newBaselines, int newNBaselines);
+		bool           isOpen     ();
+		void           setAddress (NetAddress *newAddress);
+		bool           receive    (unsigned char *datagram, int length);
+		unsigned char* getMessage ();
+		void           queue      (unsigned char *data);
+		int            flush      (bool force = false);
+
+};
+
+/// Recent properties received for a remote player, which are played back a
+/// little late so that the player moves smoothly between updates
+class Interpolator {
+
+	private:
+		unsigned char samples[INTERP_SAMPLES][MTL_P_TEMP]; ///< Ring buffer of recent properties, in MT_P_TEMP form
+		unsigned int  times[INTERP_SAMPLES]; ///< Time at which each of the properties arrived
+		int           first; ///< Position of the oldest properties in the ring buffer
+		int           nSamples; ///< Number of properties kept
+		bool          applied; ///< Whether or not the oldest properties have been given out
+
+		bool isSmooth ();
+
+	public:
+		Interpolator ();
+
+		void reset ();
+		void add   (unsigned char *temp, unsigned int ticks);
+		bool get   (unsigned int ticks, unsigned char *temp);
+
+};
+
+/// Changes to the game and level made by a client, which are shown straight
+/// away but have yet to be accepted by the server
+class Prediction {
+
+	private:
+		unsigned char  keys[PREDICTIONS][PREDICTION_KEY]; ///< Ring buffer identifying the state replaced by each change, oldest first
+		unsigned char  keyLengths[PREDICTIONS]; ///< Length of each key, or 0 if the change adds to the state
+		unsigned short next; ///< Number of the next change, counting from 0
+		int            first; ///< Position of the oldest change in the ring buffer
+		int            nChanges; ///< Number of changes awaiting acceptance
+
+	public:
+		Prediction ();
+
+		static bool isPredicted (unsigned char *buffer);
+
+		void add        (unsigned char *buffer);
+		void accept     (unsigned short count);
+		bool isReplaced (unsigned char *buffer);
+
+};
 
 /// Base class for game handling classes
 class Game {
@@ -101,6 +249,7 @@ class Game {
 		unsigned int   checkTime; ///< The next time a connection/disconnection will be dealt with
 		short int      checkX; ///< X-coordinate of the level checkpoint
 		short int      checkY; ///< Y-coordinate of the level checkpoint
+		NetStats       netStats; ///< Data received during the last step
 
 		Game ();
 
@@ -114,18 +263,20 @@ class Game {
 	public:
 		virtual ~Game ();
 
-		GameMode*    getMode       ();
-		int          getDifficulty ();
-		void         setDifficulty (int diff);
-		int          playLevel     (char *fileName);
-		virtual int  setLevel      (char *fileName) = 0;
-		int          play          ();
-		void         view          (int change);
-		virtual void send          (unsigned char *buffer) = 0;
-		virtual int  step          (unsigned int ticks) = 0;
-		virtual void score         (unsigned char team) = 0;
-		virtual void setCheckpoint (int gridX, int gridY) = 0;
-		void         resetPlayer   (Player *player);
+		GameMode*       getMode       ();
+		const NetStats* getNetStats   ();
+		int             getDifficulty ();
+		void            setDifficulty (int diff);
+		int             playLevel     (char *fileName);
+		virtual int     setLevel      (char *fileName) = 0;
+		int             play          ();
+		void            view          (int change);
+		virtual void    send          (unsigned char *buffer) = 0;
+		virtual int     step          (unsigned int ticks) = 0;
+		virtual void    score         (unsigned char team) = 0;
+		virtual void    setCheckpoint (int gridX, int gridY) = 0;
+		void            resetPlayer   (Player *player);
+		virtual int     getBandwidth  (int player);
 
 };
 
@@ -151,16 +302,39 @@ class ServerGame : public Game {
 
 	private:
 		int            clientStatus[MAX_CLIENTS]; /**< Array of client statuses
+ 			-4: Waiting to hear whether the client needs the level
+ 			-3: The level has yet to be announced
  			-2: Connected and operational
  			-1: Not connected
 			>=0: Number of bytes of the level that have been sent */
 		int            clientPlayer[MAX_CLIENTS]; ///< Array of client player indexes
-		int            clientSock[MAX_CLIENTS]; ///< Array of client sockets
-		unsigned char  recvBuffers[MAX_CLIENTS][BUFFER_LENGTH]; ///< Array of buffers containing data received from clients
-		int            received[MAX_CLIENTS]; ///< Array containing the amount of data received from each client
-		unsigned char *levelData; ///< Contents of the current level file
-		int            levelSize; ///< Size of the current level file
+		Connection     clients[MAX_CLIENTS]; ///< Array of client connections
+		unsigned char *levelData; ///< Compressed contents of the current level file
+		int            levelSize; ///< Size of the compressed level data
+		int            fileSize; ///< Size of the current level file
+		unsigned int   levelHash; ///< Hash of the current level file
+		Snapshot       sentSnapshots[MAX_CLIENTS][MAX_PLAYERS]; ///< Baselines for the properties of each player sent to each client
+		Snapshot       receivedSnapshots[MAX_CLIENTS]; ///< Baselines for the properties received from each client
+		int            clientSent[MAX_CLIENTS]; ///< Bytes sent to each client since the last check
+		int            clientBandwidth[MAX_CLIENTS]; ///< Bytes sent to each client during the last check interval
+		int            clientViewW[MAX_CLIENTS]; ///< Width of each client's view
+		int            clientViewH[MAX_CLIENTS]; ///< Height of each client's view
+		unsigned int   sentTimes[MAX_CLIENTS][MAX_PLAYERS]; ///< Time at which each player's properties were last sent to each client
+		unsigned int   stepTicks; ///< Time of the current step
+		DatagramChannel channels[MAX_CLIENTS]; ///< Each client's datagram channel
+		bool           clientDatagrams[MAX_CLIENTS]; ///< Whether or not player updates are exchanged with each client in datagrams
 		int            sock; ///< Server socket
+		int            datagramSock; ///< Server datagram socket, or -1
+		NetPoller      poller; ///< Waits for activity on the server and client sockets
+		bool           polling; ///< Whether or not the poller is in use
+		unsigned short accepted[MAX_CLIENTS]; ///< Number of predicted changes accepted from each client
+
+		void addClient        (int client, int clientSock);
+		void removeClient     (int client);
+		bool isDue            (int client, unsigned char *buffer);
+		void receive          (int client, unsigned char *buffer);
+		void receiveDatagrams ();
+		void sendOthers       (int client, unsigned char *buffer);
 
 	public:
 		ServerGame         (GameModeType mode, char *firstLevel, int gameDifficulty);
@@ -171,6 +345,7 @@ class ServerGame : public Game {
 		int  step          (unsigned int ticks);
 		void score         (unsigned char team);
 		void setCheckpoint (int gridX, int gridY);
+		int  getBandwidth  (int player);
 
 };
 
@@ -179,12 +354,29 @@ class ServerGame : public Game {
 class ClientGame : public Game {
 
 	private:
-		File          *file; ///< File to which the incoming level will be written
-		unsigned char  recvBuffer[BUFFER_LENGTH]; ///< Buffer containing data received from server
-		int            received; ///< Amount of data received from server
+		Connection     connection; ///< Connection to the server
+		unsigned char *levelData; ///< Compressed contents of the incoming level file
+		int            levelSize; ///< Size of the compressed level data
+		int            fileSize; ///< Size of the incoming level file
+		int            downloaded; ///< Amount of compressed level data received
+		bool           levelReady; ///< Whether or not the next level file is ready to be played
+		Snapshot       snapshot; ///< Baseline for the local player's properties sent to the server
+		Snapshot       snapshots[MAX_PLAYERS]; ///< Baselines for the properties received for each player
 		int            clientID; ///< Client's index on the server
 		int            maxPlayers; ///< The maximum number of players in the game
-		int            sock; ///< Client socket
+		int            viewW; ///< Width of the view last reported to the server
+		int            viewH; ///< Height of the view last reported to the server
+		DatagramChannel channel; ///< Datagram channel to the server
+		Interpolator   interpolators[MAX_PLAYERS]; ///< Recent properties received for each player
+		int            datagramSock; ///< Datagram socket, or -1
+		bool           datagrams; ///< Whether or not player updates are exchanged in datagrams
+		Prediction     prediction; ///< Local changes awaiting acceptance by the server
+
+		bool isCached         (unsigned int hash);
+		void useCachedLevel   (unsigned int hash);
+		int  receive          (unsigned char *buffer);
+		int  receiveDatagrams ();
+		int  saveLevel        ();
 
 	public:
 		ClientGame         (char *address);
@@ -28,6 +28,19 @@
 #include "player/player.h"
 
 
+// Rates at which players' properties are sent, by distance from each client's
+// view: margin, range, interval within range, interval beyond range
+
+/// Co-operating players rarely need to see each other until they meet
+static const InterestSettings coopInterest = {64, 640, 100, 1000};
+
+/// Battling players hunt each other, so distant players are kept fresher
+static const InterestSettings battleInterest = {128, 960, 50, 500};
+
+/// Racing players only pass each other briefly
+static const InterestSettings raceInterest = {64, 320, 100, 1000};
+
+
 /**
  * Destroy game mode
  */
@@ -102,6 +115,18 @@ void GameMode::outOfTime () {
 }
 
 
+/**
+ * Get how often players' properties are sent to clients
+ *
+ * @return Update rates, by distance from each client's view
+ */
+const InterestSettings* GameMode::getInterest () {
+
+	return &coopInterest;
+
+}
+
+
 /**
  * Get the game mode type
  *
@@ -280,6 +305,18 @@ GameModeType BattleGameMode::getMode () {
 }
 
 
+/**
+ * Get how often players' properties are sent to clients
+ *
+ * @return Update rates, by distance from each client's view
+ */
+const InterestSettings* BattleGameMode::getInterest () {
+
+	return &battleInterest;
+
+}
+
+
 /**
  * Get the game mode type
  *
@@ -292,6 +329,18 @@ GameModeType TeamBattleGameMode::getMode () {
 }
 
 
+/**
+ * Get how often players' properties are sent to clients
+ *
+ * @return Update rates, by distance from each client's view
+ */
+const InterestSettings* TeamBattleGameMode::getInterest () {
+
+	return &battleInterest;
+
+}
+
+
 /**
  * Get the game mode type
  *
@@ -345,3 +394,15 @@ bool RaceGameMode::endOfLevel (Game* game, Player *player, int gridX, int gridY)
 
 }
 
+
+/**
+ * Get how often players' properties are sent to clients
+ *
+ * @return Update rates, by distance from each client's view
+ */
+const InterestSettings* RaceGameMode::getInterest () {
+
+	return &raceInterest;
+
+}
+
@@ -43,6 +43,20 @@ enum GameModeType {
 };
 
 
+// Datatype
+
+/// How often players' properties are sent to each client, depending on how far
+/// the players are from the client's view
+typedef struct {
+
+	int          margin; ///< Distance outside the view within which every update is sent, in pixels
+	int          range; ///< Distance outside the view within which updates are sent at the reduced rate, in pixels
+	unsigned int nearInterval; ///< Shortest time between updates within range, in milliseconds
+	unsigned int farInterval; ///< Shortest time between updates beyond range, in milliseconds
+
+} InterestSettings;
+
+
 // Classes
 
 class Font;
@@ -63,6 +77,8 @@ class GameMode {
 		virtual bool          endOfLevel (Game* game, Player *player, int gridX, int gridY);
 		virtual void          outOfTime  ();
 
+		virtual const InterestSettings* getInterest ();
+
 };
 
 /// Single-player game mode
@@ -117,7 +133,8 @@ class BattleGameMode : public FreeForAllGameMode {
 		int targetKills; ///< Number of kills required for a player to win
 
 	public:
-		GameModeType getMode ();
+		GameModeType            getMode     ();
+		const InterestSettings* getInterest ();
 
 };
 
@@ -128,7 +145,8 @@ class TeamBattleGameMode : public TeamGameMode {
 		int targetKills; ///< Number of kills required for a team to win
 
 	public:
-		GameModeType getMode ();
+		GameModeType            getMode     ();
+		const InterestSettings* getInterest ();
 
 };
 
@@ -139,9 +157,10 @@ class RaceGameMode : public FreeForAllGameMode {
 		int targetLaps; ///< Number of laps required for a player to win
 
 	public:
-		GameModeType getMode    ();
-		bool         hit        (Player *source, Player *victim);
-		bool         endOfLevel (Game* game, Player *player, int gridX, int gridY);
+		GameModeType            getMode     ();
+		bool                    hit         (Player *source, Player *victim);
+		bool                    endOfLevel  (Game* game, Player *player, int gridX, int gridY);
+		const InterestSettings* getInterest ();
 
 };
 
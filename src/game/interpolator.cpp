@@ -0,0 +1,214 @@
+
+/**
+ *
+ * @file interpolator.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 18th October 2026: Created interpolator.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2026 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Smoothing of remote players' movement. Properties received for a remote
+ * player are played back T_INTERP late, so that there is usually a later set
+ * to move towards, and the position is interpolated between the two. Once the
+ * latest properties have been played back, the player is simulated from them
+ * as usual until more arrive.
+ *
+ */
+
+
+#include "game.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * Get a position from properties in MT_P_TEMP form.
+ *
+ * @param data The position's bytes
+ *
+ * @return The position
+ */
+static int getPosition (unsigned char *data) {
+
+	return (data[0] << 24) + (data[1] << 16) + (data[2] << 8) + data[3];
+
+}
+
+
+/**
+ * Set a position in properties in MT_P_TEMP form.
+ *
+ * @param data The position's bytes
+ * @param position The position
+ */
+static void setPosition (unsigned char *data, int position) {
+
+	data[0] = position >> 24;
+	data[1] = (position >> 16) & 255;
+	data[2] = (position >> 8) & 255;
+	data[3] = position & 255;
+
+	return;
+
+}
+
+
+/**
+ * Create an empty interpolator.
+ */
+Interpolator::Interpolator () {
+
+	reset();
+
+	return;
+
+}
+
+
+/**
+ * Forget all received properties.
+ */
+void Interpolator::reset () {
+
+	first = 0;
+	nSamples = 0;
+	applied = false;
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not the player can glide from the oldest properties to
+ * the next.
+ *
+ * @return True if the properties are close enough in time and space
+ */
+bool Interpolator::isSmooth () {
+
+	unsigned char *earlier, *later;
+	int next;
+
+	next = (first + 1) % INTERP_SAMPLES;
+	earlier = samples[first];
+	later = samples[next];
+
+	return (times[next] - times[first] <= INTERP_GAP) &&
+		(abs(getPosition(later + 37) - getPosition(earlier + 37)) <= INTERP_SNAP) &&
+		(abs(getPosition(later + 41) - getPosition(earlier + 41)) <= INTERP_SNAP);
+
+}
+
+
+/**
+ * Add newly received properties. If there is no room, the oldest are dropped.
+ *
+ * @param temp The properties, in MT_P_TEMP form
+ * @param ticks Time at which the properties arrived
+ */
+void Interpolator::add (unsigned char *temp, unsigned int ticks) {
+
+	int position;
+
+	if (nSamples == INTERP_SAMPLES) {
+
+		first = (first + 1) % INTERP_SAMPLES;
+		nSamples--;
+		applied = false;
+
+	}
+
+	position = (first + nSamples) % INTERP_SAMPLES;
+
+	memcpy(samples[position], temp, MTL_P_TEMP);
+	times[position] = ticks;
+	nSamples++;
+
+	return;
+
+}
+
+
+/**
+ * Get the properties to apply to the player now.
+ *
+ * @param ticks Current time
+ * @param temp Buffer to receive the properties, in MT_P_TEMP form
+ *
+ * @return False if there is nothing new to apply
+ */
+bool Interpolator::get (unsigned int ticks, unsigned char *temp) {
+
+	unsigned int time;
+	int next, position, fraction;
+
+	time = ticks - T_INTERP;
+
+	// Move on to the next properties once they are due, or straight away if
+	// the player cannot glide to them
+	while ((nSamples > 1) &&
+		(((int)(time - times[(first + 1) % INTERP_SAMPLES]) >= 0) || !isSmooth())) {
+
+		first = (first + 1) % INTERP_SAMPLES;
+		nSamples--;
+		applied = false;
+
+	}
+
+	if (!nSamples) return false;
+
+	if (nSamples == 1) {
+
+		// Apply the latest properties once, then leave the player to move
+		if (applied) return false;
+
+		memcpy(temp, samples[first], MTL_P_TEMP);
+		applied = true;
+
+		return true;
+
+	}
+
+	next = (first + 1) % INTERP_SAMPLES;
+
+	if ((int)(time - times[first]) <= 0) {
+
+		// The properties are not due yet, so only jump to them if they have
+		// not been applied already, and otherwise leave the player to move
+		if (applied) return false;
+
+		memcpy(temp, samples[first], MTL_P_TEMP);
+		applied = true;
+
+		return true;
+
+	}
+
+	memcpy(temp, samples[first], MTL_P_TEMP);
+	applied = true;
+
+	// Out of 1024
+	fraction = ((time - times[first]) << 10) / (times[next] - times[first]);
+
+	position = getPosition(samples[first] + 37);
+	position += ((getPosition(samples[next] + 37) - position) * fraction) >> 10;
+	setPosition(temp + 37, position);
+
+	position = getPosition(samples[first] + 41);
+	position += ((getPosition(samples[next] + 41) - position) * fraction) >> 10;
+	setPosition(temp + 41, position);
+
+	return true;
+
+}
+
@@ -26,6 +26,7 @@
 #include "game.h"
 #include "gamemode.h"
 
+#include "level/replay.h"
 #include "player/player.h"
 #include "setup.h"
 #include "util.h"
@@ -61,6 +62,8 @@ LocalGame::LocalGame (const char *firstLevel, int gameDifficulty) {
  */
 LocalGame::~LocalGame () {
 
+	replay.finish();
+
 	delete mode;
 
 	return;
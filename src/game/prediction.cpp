@@ -0,0 +1,191 @@
+
+/**
+ *
+ * @file prediction.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 18th October 2026: Created prediction.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2026 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Client-side prediction of changes to the game and level state. A client
+ * makes its own changes (hits, collected events, extra time, scores,
+ * checkpoints, etc.) straight away, instead of waiting for the server. The
+ * server applies the changes in the order it receives them from all clients,
+ * and passes them on to the other clients. Instead of sending a change back to
+ * the client which made it, the server replies with MT_G_ACK, giving the
+ * number of the client's changes it has accepted so far.
+ *
+ * Until a change has been accepted, changes from elsewhere to the same state
+ * are ignored, as the server will replace them with the client's own. Once it
+ * has been accepted, the server's changes apply as usual, so the client ends
+ * up with the same state as the server. Changes which add to the state, rather
+ * than replacing it, always apply.
+ *
+ */
+
+
+#include "game.h"
+
+#include <string.h>
+
+
+/**
+ * Find which state a message changes.
+ *
+ * @param buffer The message
+ *
+ * @return Number of bytes from the message type onwards which identify the
+ * state, 0 if the message adds to the state, or -1 if the change is not
+ * predicted
+ */
+static int getKeyLength (unsigned char *buffer) {
+
+	switch (buffer[1]) {
+
+		case MT_G_CHECK:
+
+			return 1;
+
+		case MT_G_SCORE:
+
+			return 0;
+
+		case MT_L_PROP:
+
+			// Extra time is added to the level timer
+			return (buffer[2] == 2)? 0: 2;
+
+		case MT_L_GRID:
+
+			return 4;
+
+		case MT_L_STAGE:
+
+			return 1;
+
+	}
+
+	return -1;
+
+}
+
+
+/**
+ * Create an empty prediction.
+ */
+Prediction::Prediction () {
+
+	next = 0;
+	first = 0;
+	nChanges = 0;
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not a client makes the change in a message itself,
+ * before the server accepts it.
+ *
+ * @param buffer The message
+ *
+ * @return True if the change is predicted
+ */
+bool Prediction::isPredicted (unsigned char *buffer) {
+
+	return getKeyLength(buffer) >= 0;
+
+}
+
+
+/**
+ * Note a change which has been made locally and sent to the server.
+ *
+ * @param buffer The message describing the change
+ */
+void Prediction::add (unsigned char *buffer) {
+
+	int length, position;
+
+	length = getKeyLength(buffer);
+
+	if (length < 0) return;
+
+	// If too many changes are waiting, forget the oldest
+	if (nChanges == PREDICTIONS) {
+
+		first = (first + 1) % PREDICTIONS;
+		nChanges--;
+
+	}
+
+	position = (first + nChanges) % PREDICTIONS;
+
+	memcpy(keys[position], buffer + 1, length);
+	keyLengths[position] = length;
+	nChanges++;
+	next++;
+
+	return;
+
+}
+
+
+/**
+ * Forget the changes which the server has accepted.
+ *
+ * @param count Number of changes accepted so far
+ */
+void Prediction::accept (unsigned short count) {
+
+	// The number of the oldest change which is still waiting
+	while (nChanges && ((short)(count - (unsigned short)(next - nChanges)) > 0)) {
+
+		first = (first + 1) % PREDICTIONS;
+		nChanges--;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not a change from the server would be replaced by a
+ * local change which the server has yet to accept.
+ *
+ * @param buffer The message describing the change from the server
+ *
+ * @return True if the change should be ignored
+ */
+bool Prediction::isReplaced (unsigned char *buffer) {
+
+	int length, count, position;
+
+	length = getKeyLength(buffer);
+
+	if (length <= 0) return false;
+
+	for (count = 0; count < nChanges; count++) {
+
+		position = (first + count) % PREDICTIONS;
+
+		if ((keyLengths[position] == length) &&
+			!memcmp(keys[position], buffer + 1, length)) return true;
+
+	}
+
+	return false;
+
+}
+
@@ -27,11 +27,14 @@
 #include "io/gfx/font.h"
 #include "io/gfx/video.h"
 #include "io/network.h"
+#include "level/levelplayer.h"
 #include "player/player.h"
 #include "setup.h"
 #include "util.h"
 
+#include <stdlib.h>
 #include <string.h>
+#include <miniz.h>
 
 
 /**
@@ -52,6 +55,17 @@ ServerGame::ServerGame (GameModeType modeType, char* firstLevel, int gameDifficu
 
 	if (sock < 0) throw sock; // Tee hee. Throw sock.
 
+	// Player updates can also be exchanged in datagrams
+	datagramSock = net->hostDatagrams();
+
+	if (datagramSock < 0) {
+
+		log("Could not open datagram socket - code", datagramSock);
+
+		datagramSock = -1;
+
+	}
+
 
 	// Create the players
 
@@ -59,8 +73,17 @@ ServerGame::ServerGame (GameModeType modeType, char* firstLevel, int gameDifficu
 	localPlayer = players = new Player[MAX_PLAYERS];
 	localPlayer->init(this, setup.characterName, setup.characterCols, 0);
 
-	for (count = 0; count < MAX_CLIENTS; count++)
+	for (count = 0; count < MAX_CLIENTS; count++) {
+
 		clientPlayer[count] = clientStatus[count] = -1;
+		clientSent[count] = clientBandwidth[count] = 0;
+		clientViewW[count] = SW;
+		clientViewH[count] = SH;
+		clientDatagrams[count] = false;
+
+	}
+
+	stepTicks = 0;
 
 
 	// Copy the first level into memory
@@ -74,6 +97,8 @@ ServerGame::ServerGame (GameModeType modeType, char* firstLevel, int gameDifficu
 
 		net->close(sock);
 
+		if (datagramSock != -1) net->close(datagramSock);
+
 		if (levelData) delete[] levelData;
 
 		throw count;
@@ -84,6 +109,9 @@ ServerGame::ServerGame (GameModeType modeType, char* firstLevel, int gameDifficu
 
 	mode = createMode(modeType);
 
+	// Wait for clients on the network thread, if possible
+	polling = poller.start(sock);
+
 	return;
 
 }
@@ -94,16 +122,53 @@ ServerGame::ServerGame (GameModeType modeType, char* firstLevel, int gameDifficu
  */
 ServerGame::~ServerGame () {
 
-	int count;
+	unsigned char* message;
+	int count, client, clientSock;
+	NetEvent type;
+
+	if (polling) {
+
+		poller.stop();
+
+		// Catch up with connections and disconnections the game has yet to hear about
+		while ((type = poller.getEvent(client, clientSock, message)) != NE_NONE) {
+
+			if (type == NE_CONNECT) {
+
+				clients[client].open(clientSock);
+				clientStatus[client] = -2;
+
+			} else if ((type == NE_DISCONNECT) && (clientStatus[client] != -1)) {
+
+				net->close(clients[client].getSocket());
+				clientStatus[client] = -1;
+
+			}
+
+		}
+
+	}
 
 	for (count = 0; count < MAX_CLIENTS; count++) {
 
-		if (clientStatus[count] != -1) net->close(clientSock[count]);
+		if (clientStatus[count] != -1) {
+
+			clients[count].flush();
+			net->close(clients[count].getSocket());
+
+		}
 
 	}
 
 	net->close(sock);
 
+	if (datagramSock != -1) {
+
+		netSimulator.discard(datagramSock);
+		net->close(datagramSock);
+
+	}
+
 	if (levelData) delete[] levelData;
 
 	delete mode;
@@ -123,26 +188,28 @@ ServerGame::~ServerGame () {
 int ServerGame::setLevel (char* fileName) {
 
 	File* file;
+	unsigned char* fileData;
+	mz_ulong length;
 	int count;
 
 	if (levelFile) delete[] levelFile;
 	if (levelData) delete[] levelData;
 
-	// The new level will be sent to all clients
+	// The new level will be announced to all clients
 	for (count = 0; count < MAX_CLIENTS; count++) {
 
-		if (clientStatus[count] != -1) clientStatus[count] = 0;
+		if (clientStatus[count] != -1) clientStatus[count] = -3;
 
 	}
 
-	if (!fileName) {
-
-		levelFile = NULL;
-		levelData = NULL;
+	levelFile = NULL;
+	levelData = NULL;
 
-		return E_NONE;
+	// An empty level tells clients that the run of levels has ended
+	levelSize = fileSize = 0;
+	levelHash = 0;
 
-	}
+	if (!fileName) return E_NONE;
 
 	try {
 
@@ -150,9 +217,6 @@ int ServerGame::setLevel (char* fileName) {
 
 	} catch (int e) {
 
-		levelFile = NULL;
-		levelData = NULL;
-
 		return e;
 
 	}
@@ -160,21 +224,33 @@ int ServerGame::setLevel (char* fileName) {
 	levelFile = createString(fileName);
 
 	// Load the entire file into memory
-	levelSize = file->getSize();
-	levelData = file->loadBlock(levelSize);
+	fileSize = file->getSize();
+	fileData = file->loadBlock(fileSize);
 
 	delete file;
 
 	levelType = getLevelType(fileName);
 
-	if (levelType != LT_JJ1) return E_NONE;
+	if (levelType == LT_JJ1) {
+
+		// Modify the extension section to match the actual extension
+		count = fileSize - 5;
+		while (fileData[count - 1] != 3) count--;
+		fileData[count] = fileName[strlen(fileName) - 3];
+		fileData[count + 1] = fileName[strlen(fileName) - 2];
+		fileData[count + 2] = fileName[strlen(fileName) - 1];
+
+	}
+
+	levelHash = createHash(fileData, fileSize);
+
+	// Compress the level once, for sending to every client
+	length = mz_compressBound(fileSize);
+	levelData = new unsigned char[length];
+	mz_compress2(levelData, &length, fileData, fileSize, MZ_BEST_COMPRESSION);
+	levelSize = length;
 
-	// Modify the extension section to match the actual extension
-	count = levelSize - 5;
-	while (levelData[count - 1] != 3) count--;
-	levelData[count] = fileName[strlen(fileName) - 3];
-	levelData[count + 1] = fileName[strlen(fileName) - 2];
-	levelData[count + 2] = fileName[strlen(fileName) - 1];
+	delete[] fileData;
 
 	return E_NONE;
 
@@ -182,22 +258,62 @@ int ServerGame::setLevel (char* fileName) {
 
 
 /**
- * Send data to clients
+ * Send data to clients. The data is sent at the end of the current step.
  *
  * @param buffer Data to send. First byte indicates length.
  */
 void ServerGame::send (unsigned char* buffer) {
 
+	sendOthers(-1, buffer);
+
+	return;
+
+}
+
+
+/**
+ * Send data to all clients but one. The data is sent at the end of the current
+ * step.
+ *
+ * @param client The client to leave out, or -1 for none
+ * @param buffer Data to send. First byte indicates length.
+ */
+void ServerGame::sendOthers (int client, unsigned char* buffer) {
+
+	unsigned char delta[BUFFER_LENGTH];
+	Snapshot* snapshot;
 	int count;
 
 	for (count = 0; count < MAX_CLIENTS; count++) {
 
 		// Send data to client, unless the data concerns the client's player
 		// Each client is solely responsible for its player's state
-		if ((clientStatus[count] != -1) &&
-			(((buffer[1] & MCMASK) != MC_PLAYER) ||
-			(buffer[2] != clientPlayer[count])))
-			net->send(clientSock[count], buffer);
+		if ((count == client) || (clientStatus[count] == -1) ||
+			(((buffer[1] & MCMASK) == MC_PLAYER) &&
+			(buffer[2] == clientPlayer[count]))) continue;
+
+		if (buffer[1] == MT_P_TEMP) {
+
+			// Players far from the client's view are updated less often
+			if (!isDue(count, buffer)) continue;
+
+			// Only send what has changed since the client's last update
+			snapshot = sentSnapshots[count] + buffer[2];
+			snapshot->encode(buffer, delta);
+
+			if (clientDatagrams[count]) {
+
+				// Lost updates are not resent, as later ones replace them
+				channels[count].queue(delta);
+				sentTimes[count][buffer[2]] = stepTicks;
+
+			} else if (clients[count].queue(delta)) {
+
+				sentTimes[count][buffer[2]] = stepTicks;
+
+			} else snapshot->reset();
+
+		} else clients[count].queue(buffer);
 
 	}
 
@@ -207,264 +323,579 @@ void ServerGame::send (unsigned char* buffer) {
 
 
 /**
- * Game iteration
+ * Decide whether or not a player's properties are due to be sent to a client.
+ * Players in or near the client's view are sent every update, players within
+ * range of it are sent at a reduced rate, and the rest are only sent often
+ * enough to keep them alive. The distances and rates depend on the game mode.
  *
- * @param ticks Current time
+ * @param client The client
+ * @param buffer The player's properties, in MT_P_TEMP form
  *
- * @return Error code
+ * @return True if the properties should be sent
  */
-int ServerGame::step (unsigned int ticks) {
+bool ServerGame::isDue (int client, unsigned char *buffer) {
 
-	unsigned char sendBuffer[BUFFER_LENGTH];
-	int count, pcount, length;
+	const InterestSettings* interest;
+	LevelPlayer* viewer;
+	unsigned int interval;
+	int x, y, distance;
 
-	for (count = 0; count < MAX_CLIENTS; count++) {
+	interest = mode->getInterest();
 
-		if (clientStatus[count] >= 0) {
+	if (clientPlayer[client] == -1) {
+
+		// The client has no player in the level yet
+		interval = interest->farInterval;
+
+	} else {
+
+		viewer = players[clientPlayer[client]].getLevelPlayer();
 
-			if (clientStatus[count] == 0) {
+		if (!viewer) return true;
 
-				// Send level type
-				sendBuffer[0] = MTL_G_LTYPE;
-				sendBuffer[1] = MT_G_LTYPE;
-				sendBuffer[2] = levelType;
-				net->send(clientSock[count], sendBuffer);
+		x = (buffer[37] << 24) + (buffer[38] << 16) + (buffer[39] << 8) + buffer[40];
+		y = (buffer[41] << 24) + (buffer[42] << 16) + (buffer[43] << 8) + buffer[44];
+
+		// Distance outside the client's view, which is centred on its player
+		x = abs(FTOI(x - viewer->getX())) - (clientViewW[client] >> 1);
+		y = abs(FTOI(y - viewer->getY())) - (clientViewH[client] >> 1);
+		distance = (x > y)? x: y;
+
+		if (distance <= interest->margin) return true;
+
+		interval = (distance <= interest->range)? interest->nearInterval: interest->farInterval;
+
+	}
+
+	return stepTicks - sentTimes[client][buffer[2]] >= interval;
+
+}
+
+
+/**
+ * Process a message from a client, and pass it on to the other clients
+ *
+ * @param client The client from which the message was received
+ * @param buffer The message. First byte indicates length.
+ */
+void ServerGame::receive (int client, unsigned char* buffer) {
+
+	unsigned char temp[MTL_P_TEMP];
+	unsigned char ack[MTL_G_ACK];
+	int count;
+
+	switch (buffer[1] & MCMASK) {
+
+		case MC_GAME:
+
+			if (buffer[1] == MT_G_LREQ) {
+
+				// Send the level unless the client already has it
+				if (clientStatus[client] == -4)
+					clientStatus[client] = buffer[2]? 0: -2;
+
+				// Other clients do not need to know
+				return;
 
 			}
 
-			// Client is connected, but not operational
-			// Send a chunk of the level
+			if (buffer[1] == MT_G_PING) {
 
-			length = levelSize - clientStatus[count];
+				// Return the message to its sender only
+				clients[client].queue(buffer);
 
-			if (length > 251) length = 251;
+				return;
 
-			sendBuffer[0] = MTL_G_LEVEL + length;
-			sendBuffer[1] = MT_G_LEVEL;
-			sendBuffer[2] = clientStatus[count] >> 8;
-			sendBuffer[3] = clientStatus[count] & 255;
-			memcpy(sendBuffer + 4, levelData + clientStatus[count], length);
-			length = net->send(clientSock[count], sendBuffer);
+			}
 
-			// Client is operational if the whole level has been sent
-			// Otherwise, keep sending data
-			if (length == MTL_G_LEVEL) clientStatus[count] = -2;
-			else if (length > 0) clientStatus[count] += length - MTL_G_LEVEL;
+			if (buffer[1] == MT_G_VIEW) {
 
-		}
+				if (buffer[0] < MTL_G_VIEW) return;
+
+				// Used to decide which players the client needs to hear about
+				clientViewW[client] = (buffer[2] << 8) + buffer[3];
+				clientViewH[client] = (buffer[4] << 8) + buffer[5];
+
+				return;
+
+			}
+
+			if ((buffer[1] == MT_G_PJOIN) && (clientPlayer[client] == -1)) {
+
+				printf("Player %d (client %d) joined the game.\n", nPlayers, client);
+
+
+				// Set up the new player
+
+				buffer[4] = mode->chooseTeam();
+
+				players[nPlayers].init(this, (char *)buffer + 9, buffer + 5,
+					buffer[4]);
+				addLevelPlayer(players + nPlayers);
+
+				printf("Player %d joined team %d.\n", nPlayers, buffer[4]);
+
+				buffer[3] = clientPlayer[client] = nPlayers;
+
+				nPlayers++;
+
+			}
+
+			if (buffer[1] == MT_G_CHECK) {
+
+				checkX = buffer[2];
+				checkY = buffer[3];
+
+				if (buffer[0] > 4) {
+
+					checkX += buffer[4] << 8;
+					checkY += buffer[5] << 8;
+
+				}
+
+			}
+
+			if (buffer[1] == MT_G_SCORE) {
+
+				for (count = 0; count < nPlayers; count++) {
+
+					if (players[count].getTeam() == buffer[2])
+						players[count].teamScore++;
+
+				}
+
+			}
+
+			break;
+
+		case MC_LEVEL:
+
+			baseLevel->receive(buffer);
+
+			break;
+
+		case MC_PLAYER:
+
+			if (clientPlayer[client] == -1) return;
+
+			// Assign player byte based on sender
+			buffer[2] = clientPlayer[client];
+
+			if (buffer[1] == MT_P_DELTA) {
+
+				// Wait for a full snapshot if the baseline is missing
+				if (!receivedSnapshots[client].decode(buffer, temp)) return;
+
+				buffer = temp;
+
+			}
+
+			players[clientPlayer[client]].receive(buffer);
+
+			break;
+
+	}
+
+	if (Prediction::isPredicted(buffer)) {
+
+		// The client has already made the change itself, so only tell it that
+		// the change has been accepted
+		accepted[client]++;
+
+		ack[0] = MTL_G_ACK;
+		ack[1] = MT_G_ACK;
+		ack[2] = accepted[client] >> 8;
+		ack[3] = accepted[client] & 255;
+		clients[client].queue(ack);
+
+		// Update the other clients
+		sendOthers(client, buffer);
 
+	} else {
 
-		if ((clientStatus[count] == -2) && (received[count] == 0)) {
+		// Update clients
+		send(buffer);
+
+	}
+
+	return;
 
-			// Client is operational, but not currently receiving a message
-			// See if there is a new message to receive
+}
+
+
+/**
+ * Process the datagrams which have arrived from clients. Only player updates
+ * are accepted this way.
+ */
+void ServerGame::receiveDatagrams () {
 
-			length = net->recv(clientSock[count], recvBuffers[count], 1);
+	unsigned char datagram[DATAGRAM_SIZE];
+	unsigned char* message;
+	NetAddress address;
+	int length, client, count;
 
-			if (length > 0) received[count]++;
+	while ((length = net->recvFrom(datagramSock, &address, datagram, DATAGRAM_SIZE)) >= 0) {
+
+		if (length < DATAGRAM_HEADER) continue;
+
+		client = datagram[0];
+
+		if ((client >= MAX_CLIENTS) || (clientStatus[client] == -1) ||
+			!channels[client].receive(datagram, length)) continue;
+
+		// Reply to wherever the client's datagrams come from
+		channels[client].setAddress(&address);
+
+		if (!clientDatagrams[client]) {
+
+			printf("Client %d is sending player updates in datagrams.\n", client);
+
+			// From now on, updates may be lost, so only those which are
+			// acknowledged can be used as baselines
+			clientDatagrams[client] = true;
+
+			for (count = 0; count < MAX_PLAYERS; count++)
+				sentSnapshots[client][count].useAcks(true);
 
 		}
 
+		netStats.bytes += length;
 
-		if ((clientStatus[count] == -2) && (received[count] > 0)) {
+		while ((message = channels[client].getMessage())) {
 
-			// Currently receiving a message
-			// See if there is any more data
+			if (((message[1] == MT_P_TEMP) && (message[0] >= MTL_P_TEMP)) ||
+				(message[1] == MT_P_DELTA))
+				receive(client, message);
 
-			length = net->recv(clientSock[count],
-				recvBuffers[count] + received[count],
-				recvBuffers[count][0] - received[count]);
+		}
 
-			if (length > 0) received[count] += length;
+	}
 
+	return;
 
-			// See if the whole message has arrived
+}
 
-			if (received[count] >= recvBuffers[count][0]) {
 
-				switch (recvBuffers[count][1] & MCMASK) {
+/**
+ * Start serving a newly-connected client
+ *
+ * @param client The client's slot
+ * @param clientSock The client's socket
+ */
+void ServerGame::addClient (int client, int clientSock) {
 
-					case MC_GAME:
+	unsigned char sendBuffer[BUFFER_LENGTH];
+	unsigned int token;
+	int count;
 
-						if ((recvBuffers[count][1] == MT_G_PJOIN) &&
-							(clientPlayer[count] == -1)) {
+	printf("Client %d connected.\n", client);
 
-							printf("Player %d (client %d) joined the game.\n", nPlayers, count);
+	clients[client].open(clientSock);
+	clientPlayer[client] = -1;
 
+	receivedSnapshots[client].reset();
+	clientSent[client] = clientBandwidth[client] = 0;
+	accepted[client] = 0;
 
-							// Set up the new player
+	// Until the client says otherwise, assume the original view size
+	clientViewW[client] = SW;
+	clientViewH[client] = SH;
 
-							recvBuffers[count][4] = mode->chooseTeam();
+	for (count = 0; count < MAX_PLAYERS; count++) {
 
-							players[nPlayers].init(this,
-								(char *)(recvBuffers[count]) + 9,
-								recvBuffers[count] + 5, recvBuffers[count][4]);
-							addLevelPlayer(players + nPlayers);
+		sentSnapshots[client][count].reset();
+		sentSnapshots[client][count].useAcks(false);
+		sentTimes[client][count] = 0;
 
-							printf("Player %d joined team %d.\n", nPlayers, recvBuffers[count][4]);
+	}
 
-							recvBuffers[count][3] = clientPlayer[count] = nPlayers;
+	// Player updates use the connection until the client's datagrams arrive
+	clientDatagrams[client] = false;
+	channels[client].open(-1, client, 0, NULL, 0);
 
-							nPlayers++;
+	// Incorporate the new client
 
-						}
+	// Send data
+	sendBuffer[0] = MTL_G_PROPS;
+	sendBuffer[1] = MT_G_PROPS;
+	sendBuffer[2] = NET_VERSION; // Server version
+	sendBuffer[3] = mode->getMode();
+	sendBuffer[4] = difficulty;
+	sendBuffer[5] = MAX_PLAYERS;
+	sendBuffer[6] = nPlayers; // Number of players
+	sendBuffer[7] = client; // Client's clientID
+	clients[client].queue(sendBuffer);
 
-						if (recvBuffers[count][1] == MT_G_CHECK) {
+	// Initiate sending of level data
+	clientStatus[client] = -3;
 
-							checkX = recvBuffers[count][2];
-							checkY = recvBuffers[count][3];
+	// Inform the new client of the checkpoint
+	sendBuffer[0] = MTL_G_CHECK;
+	sendBuffer[1] = MT_G_CHECK;
+	sendBuffer[2] = checkX & 0xFF;
+	sendBuffer[3] = checkY & 0xFF;
+	sendBuffer[4] = (checkX >> 8) & 0xFF;
+	sendBuffer[5] = (checkY >> 8) & 0xFF;
+	clients[client].queue(sendBuffer);
 
-							if (recvBuffers[count][0] > 4) {
+	// Inform the new client of the existing players
 
-								checkX += recvBuffers[count][4] << 8;
-								checkY += recvBuffers[count][5] << 8;
+	sendBuffer[1] = MT_G_PJOIN;
 
-							}
+	for (count = 0; count < nPlayers; count++) {
 
-						}
+		sendBuffer[0] = MTL_G_PJOIN + strlen(players[count].getName());
+		sendBuffer[2] = client;
+		sendBuffer[3] = count;
+		sendBuffer[4] = players[count].getTeam();
+		memcpy(sendBuffer + 5, players[count].getCols(), PCOLOURS);
+		memcpy(sendBuffer + 9, players[count].getName(), strlen(players[count].getName()) + 1);
 
-						if (recvBuffers[count][1] == MT_G_SCORE) {
+		clients[client].queue(sendBuffer);
 
-							for (pcount = 0; pcount < nPlayers; pcount++) {
+	}
 
-								if (players[pcount].getTeam() == recvBuffers[count][2])
-									players[pcount].teamScore++;
+	if (datagramSock != -1) {
 
-							}
+		// Give the client a token to put in its datagrams, so that stray
+		// datagrams are not mistaken for the client's
+		token = (getMicroTicks() * 2654435761u) ^ client;
+		channels[client].open(datagramSock, client, token, sentSnapshots[client], MAX_PLAYERS);
 
-						}
+		sendBuffer[0] = MTL_G_UDP;
+		sendBuffer[1] = MT_G_UDP;
+		sendBuffer[2] = token >> 24;
+		sendBuffer[3] = (token >> 16) & 255;
+		sendBuffer[4] = (token >> 8) & 255;
+		sendBuffer[5] = token & 255;
+		clients[client].queue(sendBuffer);
 
-						break;
+	}
 
-					case MC_LEVEL:
+	return;
 
-						baseLevel->receive(recvBuffers[count]);
+}
 
-						break;
 
-					case MC_PLAYER:
+/**
+ * Stop serving a disconnected client, and remove its player
+ *
+ * @param client The client's slot
+ */
+void ServerGame::removeClient (int client) {
 
-						if (clientPlayer[count] != -1) {
+	unsigned char sendBuffer[MTL_G_PQUIT];
+	int count, other;
 
-							// Assign player byte based on sender
-							recvBuffers[count][2] = clientPlayer[count];
+	// Disconnect client
+	net->close(clients[client].getSocket());
+	clientStatus[client] = -1;
+	clientDatagrams[client] = false;
+	channels[client].open(-1, client, 0, NULL, 0);
 
-							players[clientPlayer[count]].receive(recvBuffers[count]);
+	if (clientPlayer[client] == -1) return;
 
-						}
+	// Remove the client's player
 
-						break;
+	printf("Player %d (client %d) left the game.\n", clientPlayer[client], client);
 
-				}
+	nPlayers--;
+
+	players[clientPlayer[client]].deinit();
+
+	// If necessary, move more recent players
+	for (count = clientPlayer[client]; count < nPlayers; count++)
+		memcpy(static_cast<void*>(players + count), players + count + 1, sizeof(Player));
+
+	// Clear duplicate pointers
+	memset(static_cast<void*>(players + nPlayers), 0, sizeof(Player));
+
+	// The remaining players have moved, so their baselines no longer apply
+	for (other = 0; other < MAX_CLIENTS; other++) {
+
+		for (count = 0; count < MAX_PLAYERS; count++) {
+
+			sentSnapshots[other][count].reset();
+			sentTimes[other][count] = 0;
+
+		}
+
+	}
+
+	// Inform remaining clients that the player has left
+	sendBuffer[0] = MTL_G_PQUIT;
+	sendBuffer[1] = MT_G_PQUIT;
+	sendBuffer[2] = clientPlayer[client];
+	send(sendBuffer);
+
+	clientPlayer[client] = -1;
+
+	return;
+
+}
+
+
+/**
+ * Game iteration
+ *
+ * @param ticks Current time
+ *
+ * @return Error code
+ */
+int ServerGame::step (unsigned int ticks) {
+
+	unsigned char sendBuffer[BUFFER_LENGTH];
+	unsigned char* message;
+	int count, length, budget, client, clientSock;
+	NetEvent type;
+
+	memset(&netStats, 0, sizeof(NetStats));
+
+	stepTicks = ticks;
+
+	if (polling) {
+
+		// Only accept new clients while there is a level to send them
+		poller.setAccepting(levelData != NULL);
+
+		// Deal with everything the network thread has received, in order
+
+		while ((type = poller.getEvent(client, clientSock, message)) != NE_NONE) {
+
+			if (type == NE_CONNECT) {
+
+				addClient(client, clientSock);
+
+			} else if (type == NE_DISCONNECT) {
 
-				// Update clients
-				send(recvBuffers[count]);
+				printf("Client %d disconnected.\n", client);
 
-				received[count] = 0;
+				removeClient(client);
+
+			} else if (clientStatus[client] != -1) {
+
+				netStats.bytes += message[0];
+				netStats.messages++;
+
+				receive(client, message);
 
 			}
 
 		}
 
-		if (ticks >= checkTime) {
+		netStats.backlog = poller.getBacklog();
 
-			if ((clientStatus[count] == -1) && levelData) {
+	}
 
-				// Client is not connected
-				// Check for new connection
+	if (datagramSock != -1) receiveDatagrams();
 
-				clientSock[count] = net->accept(sock);
+	for (count = 0; count < MAX_CLIENTS; count++) {
 
-				if (clientSock[count] != -1) {
+		// Start a new step for the connection
+		if (clientStatus[count] != -1) {
 
-					printf("Client %d connected.\n", count);
+			if (polling) clients[count].resetStats();
+			else clients[count].receive();
 
-					clientPlayer[count] = -1;
-					received[count] = 0;
+		}
 
-					// Incorporate the new client
+		if ((clientStatus[count] == -3) &&
+			(clients[count].getSpace() >= MTL_G_LTYPE)) {
+
+			// Announce the level type, size and hash
+			sendBuffer[0] = MTL_G_LTYPE;
+			sendBuffer[1] = MT_G_LTYPE;
+			sendBuffer[2] = levelType;
+			sendBuffer[3] = fileSize >> 24;
+			sendBuffer[4] = (fileSize >> 16) & 255;
+			sendBuffer[5] = (fileSize >> 8) & 255;
+			sendBuffer[6] = fileSize & 255;
+			sendBuffer[7] = levelSize >> 24;
+			sendBuffer[8] = (levelSize >> 16) & 255;
+			sendBuffer[9] = (levelSize >> 8) & 255;
+			sendBuffer[10] = levelSize & 255;
+			sendBuffer[11] = levelHash >> 24;
+			sendBuffer[12] = (levelHash >> 16) & 255;
+			sendBuffer[13] = (levelHash >> 8) & 255;
+			sendBuffer[14] = levelHash & 255;
+			clients[count].queue(sendBuffer);
+
+			// Wait for the client to say whether or not it needs the level
+			// An empty level needs no reply
+			clientStatus[count] = levelSize? -4: -2;
 
-					// Send data
-					sendBuffer[0] = MTL_G_PROPS;
-					sendBuffer[1] = MT_G_PROPS;
-					sendBuffer[2] = 1; // Server version
-					sendBuffer[3] = mode->getMode();
-					sendBuffer[4] = difficulty;
-					sendBuffer[5] = MAX_PLAYERS;
-					sendBuffer[6] = nPlayers; // Number of players
-					sendBuffer[7] = count; // Client's clientID
-					net->send(clientSock[count], sendBuffer);
+		}
 
-					// Initiate sending of level data
-					clientStatus[count] = 0;
+		if (clientStatus[count] >= 0) {
 
-					// Inform the new client of the checkpoint
-					sendBuffer[0] = MTL_G_CHECK;
-					sendBuffer[1] = MT_G_CHECK;
-					sendBuffer[2] = checkX & 0xFF;
-					sendBuffer[3] = checkY & 0xFF;
-					sendBuffer[4] = (checkX >> 8) & 0xFF;
-					sendBuffer[5] = (checkY >> 8) & 0xFF;
-					net->send(clientSock[count], sendBuffer);
+			budget = LEVEL_BUDGET;
 
-					// Inform the new client of the existing players
+			// Client is connected, but not operational
+			// Send as many chunks of the level as the budget and the
+			// connection allow
 
-					sendBuffer[1] = MT_G_PJOIN;
+			while ((clientStatus[count] >= 0) && (budget > 0)) {
 
-					for (pcount = 0; pcount < nPlayers; pcount++) {
+				length = levelSize - clientStatus[count];
 
-						sendBuffer[0] = MTL_G_PJOIN + strlen(players[pcount].getName());
-						sendBuffer[2] = count;
-						sendBuffer[3] = pcount;
-						sendBuffer[4] = players[pcount].getTeam();
-						memcpy(sendBuffer + 5, players[pcount].getCols(), PCOLOURS);
-						memcpy(sendBuffer + 9, players[pcount].getName(), strlen(players[pcount].getName()) + 1);
+				if (length > LEVEL_CHUNK) length = LEVEL_CHUNK;
 
-						net->send(clientSock[count], sendBuffer);
+				if (clients[count].getSpace() < MTL_G_LEVEL + length) break;
 
-					}
+				sendBuffer[0] = MTL_G_LEVEL + length;
+				sendBuffer[1] = MT_G_LEVEL;
+				sendBuffer[2] = clientStatus[count] >> 24;
+				sendBuffer[3] = (clientStatus[count] >> 16) & 255;
+				sendBuffer[4] = (clientStatus[count] >> 8) & 255;
+				sendBuffer[5] = clientStatus[count] & 255;
+				memcpy(sendBuffer + MTL_G_LEVEL, levelData + clientStatus[count], length);
+				clients[count].queue(sendBuffer);
 
-				}
+				// Client is operational if the whole level has been sent
+				// Otherwise, keep sending data
+				if (length == 0) clientStatus[count] = -2;
+				else clientStatus[count] += length;
 
-			} else {
+				budget -= MTL_G_LEVEL + length;
 
-				// Client is connected
-				// Check for disconnection
+			}
 
-				if (!(net->isConnected(clientSock[count]))) {
+		}
 
-					printf("Client %d disconnected (code: %d).\n", count, net->getError());
+		// Without the poller, check each connection in turn
+		if (polling) continue;
 
-					// Disconnect client
-					net->close(clientSock[count]);
-					clientStatus[count] = -1;
+		if (clientStatus[count] != -1) {
 
-					if (clientPlayer[count] != -1) {
+			// Client is connected
+			// Process every complete message that has arrived
 
-						// Remove the client's player
+			while ((message = clients[count].getMessage()))
+				receive(count, message);
 
-						printf("Player %d (client %d) left the game.\n", clientPlayer[count], count);
+		}
 
-						nPlayers--;
+		if (ticks >= checkTime) {
 
-						players[clientPlayer[count]].deinit();
+			if ((clientStatus[count] == -1) && levelData) {
 
-						// If necessary, move more recent players
-						for (pcount = clientPlayer[count]; pcount < nPlayers; pcount++)
-							memcpy(static_cast<void*>(players + pcount), players + pcount + 1, sizeof(Player));
+				// Client is not connected
+				// Check for new connection
 
-						// Clear duplicate pointers
-						memset(static_cast<void*>(players + nPlayers), 0, sizeof(Player));
+				clientSock = net->accept(sock);
+
+				if (clientSock != -1) addClient(count, clientSock);
+
+			} else if (clientStatus[count] != -1) {
+
+				// Client is connected
+				// Check for disconnection
 
-						// Inform remaining clients that the player has left
-						sendBuffer[0] = MTL_G_PQUIT;
-						sendBuffer[1] = MT_G_PQUIT;
-						sendBuffer[2] = clientPlayer[count];
-						send(sendBuffer);
+				if (!(net->isConnected(clients[count].getSocket()))) {
 
-						clientPlayer[count] = -1;
+					printf("Client %d disconnected (code: %d).\n", count, net->getError());
 
-					}
+					removeClient(count);
 
 				}
 
@@ -474,7 +905,19 @@ int ServerGame::step (unsigned int ticks) {
 
 	}
 
-	if (ticks >= checkTime) checkTime = ticks + T_SCHECK;
+	if (ticks >= checkTime) {
+
+		// Measure the rate at which data is being sent to each client
+		for (count = 0; count < MAX_CLIENTS; count++) {
+
+			clientBandwidth[count] = (clientSent[count] * 1000) / T_SCHECK;
+			clientSent[count] = 0;
+
+		}
+
+		checkTime = ticks + T_SCHECK;
+
+	}
 
 	if (ticks >= sendTime) {
 
@@ -495,11 +938,69 @@ int ServerGame::step (unsigned int ticks) {
 
 	}
 
+	// Send everything from this step together
+
+	for (count = 0; count < MAX_CLIENTS; count++) {
+
+		if (clientStatus[count] != -1) {
+
+			clients[count].flush();
+
+			netStats.bytes += clients[count].getStats()->bytes;
+			netStats.messages += clients[count].getStats()->messages;
+			netStats.backlog += clients[count].getStats()->backlog;
+			netStats.sent += clients[count].getStats()->sent;
+			netStats.dropped += clients[count].getStats()->dropped;
+
+			clientSent[count] += clients[count].getStats()->sent;
+
+			if (clientDatagrams[count]) {
+
+				length = channels[count].flush();
+
+				if (length > 0) {
+
+					netStats.sent += length;
+					clientSent[count] += length;
+
+				}
+
+			}
+
+		}
+
+	}
+
+	netSimulator.flush();
+
 	return E_NONE;
 
 }
 
 
+/**
+ * Get the rate at which data is sent to the client controlling a player
+ *
+ * @param player The player's index
+ *
+ * @return Bytes per second, or -1 if the player is not controlled by a client
+ */
+int ServerGame::getBandwidth (int player) {
+
+	int count;
+
+	for (count = 0; count < MAX_CLIENTS; count++) {
+
+		if ((clientStatus[count] != -1) && (clientPlayer[count] == player))
+			return clientBandwidth[count];
+
+	}
+
+	return -1;
+
+}
+
+
 /**
  * Assign point to team and inform clients
  *
@@ -0,0 +1,440 @@
+
+/**
+ *
+ * @file snapshot.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 18th October 2026: Created snapshot.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2026 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Delta encoding of temporary player properties. An MT_P_DELTA message holds
+ * a bitmask of the properties which differ from the baseline, followed by
+ * their new values. Single-byte properties are sent as they are, and larger
+ * ones as variable-length differences from the baseline. Positions lose their
+ * least significant bits.
+ *
+ * Over a connection which delivers everything, the baseline is the last
+ * properties sent. Over one which may lose them, it is the latest properties
+ * acknowledged by the receiver, so recent properties are kept on both sides.
+ *
+ * MT_P_DELTA layout:
+ * - 0: Length
+ * - 1: MT_P_DELTA
+ * - 2: Player
+ * - 3: Sequence number of these properties
+ * - 4: Sequence number of the baseline, or 0 for a full snapshot
+ * - 5+: Bitmask of changed properties, then their values
+ *
+ */
+
+
+#include "game.h"
+
+#include <string.h>
+
+
+// Properties, by their position in an MT_P_TEMP message
+
+#define SNAPSHOT_FIELDS 18
+
+/// Position of each property (0 for the controls)
+static const unsigned char fieldOffsets[SNAPSHOT_FIELDS] = {
+	0, 9, 10, 12, 14, 16, 18, 19, 23, 24, 25, 26, 27, 28, 29, 33, 37, 41};
+
+/// Size of each property, in bytes
+static const unsigned char fieldSizes[SNAPSHOT_FIELDS] = {
+	1, 1, 2, 2, 2, 2, 1, 4, 1, 1, 1, 1, 1, 1, 4, 4, 4, 4};
+
+/// Position of each control (each a single bit of the controls property)
+static const unsigned char controlOffsets[7] = {3, 4, 5, 6, 7, 8, 45};
+
+
+/**
+ * Get the value of a property.
+ *
+ * @param temp Properties in MT_P_TEMP form
+ * @param field The property
+ *
+ * @return The value
+ */
+static int getField (unsigned char *temp, int field) {
+
+	unsigned char *data;
+	int count, value;
+
+	if (!fieldOffsets[field]) {
+
+		value = 0;
+
+		for (count = 0; count < 7; count++)
+			if (temp[controlOffsets[count]]) value |= 1 << count;
+
+		return value;
+
+	}
+
+	data = temp + fieldOffsets[field];
+
+	if (fieldSizes[field] == 4)
+		return (data[0] << 24) + (data[1] << 16) + (data[2] << 8) + data[3];
+
+	if (fieldSizes[field] == 2) return (data[0] << 8) + data[1];
+
+	return data[0];
+
+}
+
+
+/**
+ * Set the value of a property.
+ *
+ * @param temp Properties in MT_P_TEMP form
+ * @param field The property
+ * @param value The new value
+ */
+static void setField (unsigned char *temp, int field, int value) {
+
+	unsigned char *data;
+	int count;
+
+	if (!fieldOffsets[field]) {
+
+		for (count = 0; count < 7; count++)
+			temp[controlOffsets[count]] = (value >> count) & 1;
+
+		return;
+
+	}
+
+	data = temp + fieldOffsets[field];
+
+	if (fieldSizes[field] == 4) {
+
+		data[0] = value >> 24;
+		data[1] = (value >> 16) & 255;
+		data[2] = (value >> 8) & 255;
+		data[3] = value & 255;
+
+	} else if (fieldSizes[field] == 2) {
+
+		data[0] = (value >> 8) & 255;
+		data[1] = value & 255;
+
+	} else data[0] = value;
+
+	return;
+
+}
+
+
+/**
+ * Write a variable-length number, 7 bits per byte.
+ *
+ * @param buffer Buffer to write to
+ * @param value The number
+ *
+ * @return Number of bytes written
+ */
+static int writeVarint (unsigned char *buffer, unsigned int value) {
+
+	int length;
+
+	length = 0;
+
+	while (value >= 128) {
+
+		buffer[length++] = (value & 127) | 128;
+		value >>= 7;
+
+	}
+
+	buffer[length++] = value;
+
+	return length;
+
+}
+
+
+/**
+ * Read a variable-length number, 7 bits per byte.
+ *
+ * @param buffer Message to read from. First byte indicates length.
+ * @param position Position in the message, advanced past the number
+ * @param value The number
+ *
+ * @return False if the number runs past the end of the message
+ */
+static bool readVarint (unsigned char *buffer, int &position, unsigned int &value) {
+
+	int shift;
+
+	value = 0;
+
+	for (shift = 0; shift < 35; shift += 7) {
+
+		if (position >= buffer[0]) return false;
+
+		value |= (buffer[position] & 127) << shift;
+
+		if (!(buffer[position++] & 128)) return true;
+
+	}
+
+	return false;
+
+}
+
+
+/**
+ * Create an empty snapshot, which cannot be used as a baseline.
+ */
+Snapshot::Snapshot () {
+
+	sequence = 0;
+	needsAcks = false;
+
+	reset();
+
+	return;
+
+}
+
+
+/**
+ * Forget the baselines, so that the next properties are passed in full. The
+ * sequence numbers carry on, so that late acknowledgements do not match.
+ */
+void Snapshot::reset () {
+
+	memset(sequences, 0, SNAPSHOT_HISTORY);
+	acknowledged = 0;
+	deltas = 0;
+
+	return;
+
+}
+
+
+/**
+ * Choose whether the baseline is the last properties sent, or the latest
+ * known to have arrived.
+ *
+ * @param acks True if properties may be lost, and are acknowledged
+ */
+void Snapshot::useAcks (bool acks) {
+
+	needsAcks = acks;
+
+	return;
+
+}
+
+
+/**
+ * Note that sent properties have arrived, so they can be used as a baseline.
+ *
+ * @param ackSequence Sequence number of the properties
+ */
+void Snapshot::acknowledge (unsigned char ackSequence) {
+
+	if (!getState(ackSequence)) return;
+
+	// Keep the latest, allowing for the sequence numbers wrapping around
+	if (!acknowledged || ((ackSequence + 255 - acknowledged) % 255 < 128))
+		acknowledged = ackSequence;
+
+	return;
+
+}
+
+
+/**
+ * Find recent properties.
+ *
+ * @param stateSequence Sequence number of the properties
+ *
+ * @return The properties in MT_P_TEMP form, or NULL if they are no longer kept
+ */
+unsigned char* Snapshot::getState (unsigned char stateSequence) {
+
+	if (!stateSequence || (sequences[stateSequence % SNAPSHOT_HISTORY] != stateSequence))
+		return NULL;
+
+	return states[stateSequence % SNAPSHOT_HISTORY];
+
+}
+
+
+/**
+ * Create an MT_P_DELTA message from an MT_P_TEMP message, and make the result
+ * the baseline for the next.
+ *
+ * @param temp The MT_P_TEMP message
+ * @param buffer Buffer to receive the MT_P_DELTA message
+ *
+ * @return Length of the MT_P_DELTA message
+ */
+int Snapshot::encode (unsigned char *temp, unsigned char *buffer) {
+
+	unsigned char next[MTL_P_TEMP];
+	unsigned char empty[MTL_P_TEMP];
+	unsigned char *state;
+	unsigned int mask, difference;
+	int field, value, length;
+
+	// Quantise the position
+	memcpy(next, temp, MTL_P_TEMP);
+
+	for (field = SNAPSHOT_FIELDS - 2; field < SNAPSHOT_FIELDS; field++) {
+
+		value = getField(next, field) + (1 << (SNAPSHOT_SHIFT - 1));
+		setField(next, field, value & ~((1 << SNAPSHOT_SHIFT) - 1));
+
+	}
+
+	// Send a full snapshot when there is no baseline, and every so often
+	buffer[4] = needsAcks? acknowledged: sequence;
+	state = getState(buffer[4]);
+
+	if (!state || (deltas >= SNAPSHOT_FULL)) {
+
+		memset(empty, 0, MTL_P_TEMP);
+		state = empty;
+		buffer[4] = 0;
+		deltas = 0;
+
+	} else deltas++;
+
+	sequence = (sequence % 255) + 1;
+
+	buffer[1] = MT_P_DELTA;
+	buffer[2] = temp[2];
+	buffer[3] = sequence;
+
+	mask = 0;
+
+	for (field = 0; field < SNAPSHOT_FIELDS; field++) {
+
+		if (getField(next, field) != getField(state, field)) mask |= 1 << field;
+
+	}
+
+	length = MTL_P_DELTA - 1;
+	length += writeVarint(buffer + length, mask);
+
+	for (field = 0; field < SNAPSHOT_FIELDS; field++) {
+
+		if (!(mask & (1 << field))) continue;
+
+		if (fieldSizes[field] == 1) {
+
+			buffer[length++] = getField(next, field);
+
+		} else {
+
+			// Zigzag-encoded difference, so small changes either way are short
+			value = (unsigned int)getField(next, field) - (unsigned int)getField(state, field);
+			if (field >= SNAPSHOT_FIELDS - 2) value /= 1 << SNAPSHOT_SHIFT;
+			difference = ((unsigned int)value << 1) ^ (unsigned int)(value >> 31);
+
+			length += writeVarint(buffer + length, difference);
+
+		}
+
+	}
+
+	buffer[0] = length;
+
+	// The properties replaced may have been the acknowledged ones
+	if (acknowledged == sequences[sequence % SNAPSHOT_HISTORY]) acknowledged = 0;
+
+	memcpy(states[sequence % SNAPSHOT_HISTORY], next, MTL_P_TEMP);
+	sequences[sequence % SNAPSHOT_HISTORY] = sequence;
+
+	return length;
+
+}
+
+
+/**
+ * Recreate an MT_P_TEMP message from an MT_P_DELTA message, and make the
+ * result the baseline for the next.
+ *
+ * @param buffer The MT_P_DELTA message
+ * @param temp Buffer to receive the MT_P_TEMP message
+ *
+ * @return False if the baseline is missing or the message is corrupt
+ */
+bool Snapshot::decode (unsigned char *buffer, unsigned char *temp) {
+
+	unsigned char next[MTL_P_TEMP];
+	unsigned char *state;
+	unsigned int mask, difference;
+	int field, value, position;
+
+	if ((buffer[0] < MTL_P_DELTA) || !buffer[3]) return false;
+
+	if (!buffer[4]) {
+
+		// Full snapshot
+		memset(next, 0, MTL_P_TEMP);
+
+	} else if ((state = getState(buffer[4]))) {
+
+		memcpy(next, state, MTL_P_TEMP);
+
+	} else {
+
+		// Wait for the next full snapshot
+		return false;
+
+	}
+
+	position = MTL_P_DELTA - 1;
+
+	if (!readVarint(buffer, position, mask)) return false;
+
+	for (field = 0; field < SNAPSHOT_FIELDS; field++) {
+
+		if (!(mask & (1 << field))) continue;
+
+		if (fieldSizes[field] == 1) {
+
+			if (position >= buffer[0]) return false;
+
+			setField(next, field, buffer[position++]);
+
+		} else {
+
+			if (!readVarint(buffer, position, difference)) return false;
+
+			value = (int)(difference >> 1) ^ -(int)(difference & 1);
+			if (field >= SNAPSHOT_FIELDS - 2) value *= 1 << SNAPSHOT_SHIFT;
+
+			setField(next, field, (unsigned int)getField(next, field) + value);
+
+		}
+
+	}
+
+	next[0] = MTL_P_TEMP;
+	next[1] = MT_P_TEMP;
+	next[2] = buffer[2];
+
+	memcpy(temp, next, MTL_P_TEMP);
+	memcpy(states[buffer[3] % SNAPSHOT_HISTORY], next, MTL_P_TEMP);
+	sequences[buffer[3] % SNAPSHOT_HISTORY] = buffer[3];
+	sequence = buffer[3];
+
+	return true;
+
+}
+
@@ -24,9 +24,14 @@
 
 
 #include "controls.h"
+#include "file.h"
 #include "gfx/video.h"
 
 #include "loop.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <string.h>
 
 #define DEFAULT_KEY_UP                  (SDLK_UP)
 #define DEFAULT_KEY_DOWN                (SDLK_DOWN)
@@ -309,8 +314,13 @@ Controls::Controls () {
 		controls[count].time = 0;
 		controls[count].state = false;
 
+		scripted[count] = false;
+
 	}
 
+	script = NULL;
+	scriptLength = scriptPosition = 0;
+
 	cursorPressed = false;
 	cursorReleased = false;
 
@@ -319,6 +329,106 @@ Controls::Controls () {
 }
 
 
+/**
+ * Delete the input script.
+ */
+Controls::~Controls () {
+
+	if (script) delete[] script;
+
+	return;
+
+}
+
+
+/**
+ * Load a script of timed control changes.
+ *
+ * Each line of the script gives a time (in milliseconds), the name of a control
+ * and its new state (0 or 1). Lines starting with # are ignored. Changes must
+ * be listed in order of time.
+ *
+ * @param fileName Name of the script file
+ *
+ * @return Error code
+ */
+int Controls::loadScript (const char *fileName) {
+
+	const char* controlNames[CONTROLS] = {"up", "down", "left", "right",
+		"jump", "swim", "fire", "change", "enter", "escape", "blaster",
+		"toaster", "missile", "bouncer", "tnt", "stats", "pause", "yes", "no"};
+	File* file;
+	char* text;
+	char* line;
+	char name[STRING_LENGTH + 1];
+	unsigned int time;
+	int size, state, count;
+
+	try {
+
+		file = new File(fileName, false);
+
+	} catch (int e) {
+
+		return e;
+
+	}
+
+	size = file->getSize();
+
+	// Load the script as a string
+	file->seek(0, true);
+	line = (char *)(file->loadBlock(size));
+	delete file;
+
+	text = new char[size + 1];
+	memcpy(text, line, size);
+	text[size] = 0;
+	delete[] line;
+
+	if (script) delete[] script;
+
+	// There can be no more changes than lines
+	script = new ScriptedInput[(size >> 1) + 1];
+	scriptLength = scriptPosition = 0;
+
+	line = text;
+
+	while (line && *line) {
+
+		if ((*line != '#') &&
+			(sscanf(line, "%u %32s %d", &time, name, &state) == 3)) {
+
+			for (count = 0; count < CONTROLS; count++) {
+
+				if (!strcmp(name, controlNames[count])) break;
+
+			}
+
+			if (count < CONTROLS) {
+
+				script[scriptLength].time = time;
+				script[scriptLength].control = count;
+				script[scriptLength].state = state;
+				scriptLength++;
+
+			} else logError("Unknown control in input script", name);
+
+		}
+
+		// Move on to the next line
+		line = strchr(line, '\n');
+		if (line) line++;
+
+	}
+
+	delete[] text;
+
+	return E_NONE;
+
+}
+
+
 /**
  * Set the key to use for the specified control.
  *
@@ -651,11 +761,20 @@ void Controls::loop () {
 
 	int count;
 
+	// Apply any scripted changes which have become due
+	while ((scriptPosition < scriptLength) &&
+		(script[scriptPosition].time <= globalTicks)) {
+
+		scripted[script[scriptPosition].control] = script[scriptPosition].state;
+		scriptPosition++;
+
+	}
+
 	// Apply controls to universal control tracking
 	for (count = 0; count < CONTROLS; count++)
 		controls[count].state = (controls[count].time < globalTicks) &&
 			(keys[count].pressed || buttons[count].pressed ||
-			axes[count].pressed || hats[count].pressed);
+			axes[count].pressed || hats[count].pressed || scripted[count]);
 
 	if (wheelUp) {
 
@@ -56,6 +56,18 @@
 #define T_KEY   200
 
 
+// Datatype
+
+/// Scripted change in the state of a control
+typedef struct {
+
+	unsigned int time; ///< Time at which the change takes place
+	int          control; ///< The control
+	bool         state; ///< The new state of the control
+
+} ScriptedInput;
+
+
 // Class
 
 /// Keeps track of all control input
@@ -99,6 +111,11 @@ class Controls {
 
 		} controls[CONTROLS];
 
+		bool           scripted[CONTROLS]; ///< Whether or not the input script is using each control
+		ScriptedInput* script; ///< Scripted control changes, in order of time
+		int            scriptLength; ///< Number of scripted control changes
+		int            scriptPosition; ///< Index of the next scripted control change
+
 		int          cursorX; ///< X-coordinate of the cursor
 		int          cursorY; ///< Y-coordinate of the cursor
 		bool         cursorPressed; ///< Whether or not the cursor is being pressed
@@ -109,7 +126,8 @@ class Controls {
 		void setCursor (int x, int y, bool pressed);
 
 	public:
-		Controls ();
+		Controls  ();
+		~Controls ();
 
 		void setKey           (int control, int key);
 		void setButton        (int control, int button);
@@ -122,6 +140,8 @@ class Controls {
 		int  getHat           (int control);
 		int  getHatDirection  (int control);
 
+		int  loadScript       (const char *fileName);
+
 		int  update           (SDL_Event *event, LoopType type);
 		void loop             ();
 
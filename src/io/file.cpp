@@ -81,6 +81,37 @@ File::~File () {
 }
 
 
+/**
+ * Delete a file from the first of the available paths which holds it.
+ *
+ * @param name File name
+ *
+ * @return Whether or not a file was deleted
+ */
+bool File::remove (const char* name) {
+
+	Path* path;
+	char* fullPath;
+	bool removed;
+
+	removed = false;
+	path = firstPath;
+
+	while (path && !removed) {
+
+		fullPath = createString(path->path, name);
+		removed = !::remove(fullPath);
+		delete[] fullPath;
+
+		path = path->next;
+
+	}
+
+	return removed;
+
+}
+
+
 /**
  * Try opening a file from the given path
  *
@@ -323,6 +354,36 @@ unsigned char * File::loadBlock (int length) {
 }
 
 
+/**
+ * Load a block of uncompressed data from the file into an existing buffer.
+ *
+ * @param buffer Buffer to hold the block of data
+ * @param length The length of the block
+ *
+ * @return The number of bytes read
+ */
+int File::loadBlock (unsigned char* buffer, int length) {
+
+	return fread(buffer, 1, length, file);
+
+}
+
+
+/**
+ * Store a block of uncompressed data in the file.
+ *
+ * @param buffer Buffer containing the block of data
+ * @param length The length of the block
+ */
+void File::storeBlock (const unsigned char* buffer, int length) {
+
+	fwrite(buffer, 1, length, file);
+
+	return;
+
+}
+
+
 /**
  * Load a block of RLE compressed data from the file.
  *
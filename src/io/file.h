@@ -43,6 +43,8 @@ class File {
 		File                           (const char* name, bool write);
 		~File                          ();
 
+		static bool        remove      (const char* name);
+
 		int                getSize     ();
 		void               seek        (int offset, bool reset);
 		int                tell        ();
@@ -54,6 +56,8 @@ class File {
 		signed int         loadInt     ();
 		void               storeInt    (signed int val);
 		unsigned char*     loadBlock   (int length);
+		int                loadBlock   (unsigned char* buffer, int length);
+		void               storeBlock  (const unsigned char* buffer, int length);
 		unsigned char*     loadRLE     (int length);
 		void               skipRLE     ();
 		unsigned char*     loadLZ      (int compressedLength, int length);
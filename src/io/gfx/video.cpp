@@ -31,6 +31,9 @@
 	#include <scalebit.h>
 #endif
 
+#include "benchmark.h"
+#include "profiler.h"
+#include "trace.h"
 #include "util.h"
 
 #include <string.h>
@@ -488,6 +491,15 @@ bool Video::reset (int width, int height) {
  */
 void Video::setPalette (SDL_Color *palette) {
 
+	// Without a screen, only keep track of the palette
+	if (!screen) {
+
+		currentPalette = palette;
+
+		return;
+
+	}
+
 	// Make palette changes invisible until the next draw. Hopefully.
 	clearScreen(SDL_MapRGB(screen->format, 0, 0, 0));
 	flip(0);
@@ -521,6 +533,8 @@ SDL_Color* Video::getPalette () {
  */
 void Video::changePalette (SDL_Color *palette, unsigned char first, unsigned int amount) {
 
+	if (!screen) return;
+
 	SDL_SetPalette(screen, SDL_PHYSPAL, palette, first, amount);
 
 	return;
@@ -749,6 +763,12 @@ void Video::update (SDL_Event *event) {
 void Video::flip (int mspf, PaletteEffect* paletteEffects, bool effectsStopped) {
 
 	SDL_Color shownPalette[256];
+	unsigned int startTime;
+
+	TRACE_SCOPE("Video::flip");
+
+	startTime = getMicroTicks();
+	PROFILE_START(timer);
 
 #ifdef SCALE
 	if (canvas != screen) {
@@ -762,7 +782,12 @@ void Video::flip (int mspf, PaletteEffect* paletteEffects, bool effectsStopped)
 	}
 #endif
 
+	benchmark.addTime(BP_FLIP, startTime);
+	PROFILE_MARK(timer, PP_SCALE);
+
 	// Apply palette effects
+	startTime = getMicroTicks();
+
 	if (paletteEffects) {
 
 		/* If the palette is being emulated, compile all palette changes and
@@ -786,9 +811,17 @@ void Video::flip (int mspf, PaletteEffect* paletteEffects, bool effectsStopped)
 
 	}
 
+	benchmark.addTime(BP_EFFECTS, startTime);
+	PROFILE_MARK(timer, PP_EFFECTS);
+
 	// Show what has been drawn
+	startTime = getMicroTicks();
+
 	SDL_Flip(screen);
 
+	benchmark.addTime(BP_FLIP, startTime);
+	PROFILE_MARK(timer, PP_FLIP);
+
 	return;
 
 }
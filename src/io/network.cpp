@@ -22,6 +22,10 @@
  *
  * On most platforms, USE_SOCKETS should be defined.
  *
+ * Where sockets can be polled, servers wait on all of their connections at once
+ * from a network thread (using epoll on Linux, and poll elsewhere). Otherwise,
+ * each connection is checked in turn by the game.
+ *
  */
 
 
@@ -47,9 +51,13 @@
 		#include <sys/select.h>
 		#include <sys/ioctl.h>
 		#include <netinet/in.h>
+		#include <netinet/tcp.h>
 		#include <unistd.h>
 		#include <errno.h>
-		#include <string.h>
+		#include <poll.h>
+		#ifdef USE_EPOLL
+			#include <sys/epoll.h>
+		#endif
 	#endif
 	#ifdef __APPLE__
 		#define MSG_NOSIGNAL 0
@@ -60,6 +68,34 @@
 	#include <arpa/inet.h>
 #endif
 
+#include <string.h>
+
+
+// Room needed in the event queue to read from a connection. Each byte read
+// could complete a two-byte message, which takes four bytes with its header.
+#define NET_ROOM ((NET_READ << 1) + NET_MESSAGE + 8)
+
+
+#ifdef USE_SOCKETS
+/**
+ * Send small writes immediately. Messages are gathered into one write per
+ * step, so there is nothing for Nagle's algorithm to gain by holding them back.
+ * (SDL_net does this itself.)
+ *
+ * @param sock Connection socket
+ */
+static void setNoDelay (int sock) {
+
+	int noDelay;
+
+	noDelay = 1;
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (char *)&noDelay, sizeof(int));
+
+	return;
+
+}
+#endif
+
 
 /**
  * Initialise networking.
@@ -195,6 +231,8 @@ int Network::join (char *address) {
 	con = 1;
 	ioctl(sock, FIONBIO, (u_long *)&con);
 
+	setNoDelay(sock);
+
 
 	// Connect to server
 
@@ -209,7 +247,7 @@ int Network::join (char *address) {
 	#endif
 
 	// Initiate connection
-	con = connect(sock, (sockaddr *)&sockAddr, sizeof(sockAddr));
+	con = ::connect(sock, (sockaddr *)&sockAddr, sizeof(sockAddr));
 
 	// If the connection completed, return
 	if (con == 0) return sock;
@@ -286,6 +324,121 @@ int Network::join (char *address) {
 }
 
 
+/**
+ * Open a client connection to the specified server, without showing progress.
+ * Waits until the connection completes, or for at most T_CONNECT.
+ *
+ * @param address Address of the server
+ *
+ * @return Connection socket or error code
+ */
+int Network::connect (const char *address) {
+
+#ifdef USE_SOCKETS
+	sockaddr_in sockAddr;
+	fd_set writefds, exceptfds;
+	timeval timeouttv;
+	socklen_t length;
+	int sock, con;
+
+	sock = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (sock == -1) return E_N_SOCKET;
+
+	// Make the socket non-blocking, so that the connection can time out
+	con = 1;
+	ioctl(sock, FIONBIO, (u_long *)&con);
+
+	setNoDelay(sock);
+
+	memset(&sockAddr, 0, sizeof(sockaddr_in));
+	sockAddr.sin_family = AF_INET;
+	sockAddr.sin_port = htons(NET_PORT);
+
+	#ifdef _WIN32
+	sockAddr.sin_addr.s_addr = inet_addr(address);
+	#else
+	if (inet_aton(address, &(sockAddr.sin_addr)) == 0) {
+
+		close(sock);
+
+		return E_N_ADDRESS;
+
+	}
+	#endif
+
+	// Initiate connection
+	con = ::connect(sock, (sockaddr *)&sockAddr, sizeof(sockAddr));
+
+	// If the connection completed, return
+	if (con == 0) return sock;
+
+	if ((getError() != EINPROGRESS) && (getError() != EWOULDBLOCK)) {
+
+		log("Could not connect to server - code", getError());
+
+		close(sock);
+
+		return E_N_CONNECT;
+
+	}
+
+
+	// Wait for connection to complete
+
+	FD_ZERO(&writefds);
+	FD_SET(sock, &writefds);
+	FD_ZERO(&exceptfds);
+	FD_SET(sock, &exceptfds);
+	timeouttv.tv_sec = T_CONNECT / 1000;
+	timeouttv.tv_usec = (T_CONNECT % 1000) * 1000;
+	con = select(sock + 1, NULL, &writefds, &exceptfds, &timeouttv);
+
+	if (con == 0) {
+
+		log("Timed out connecting to server", address);
+
+		close(sock);
+
+		return E_TIMEOUT;
+
+	}
+
+	// Find out whether the connection succeeded
+	length = sizeof(int);
+
+	if ((con == -1) || (getsockopt(sock, SOL_SOCKET, SO_ERROR, (char *)&con, &length) == -1))
+		con = getError();
+
+	if (con) {
+
+		log("Could not connect to server - code", con);
+
+		close(sock);
+
+		return E_N_CONNECT;
+
+	}
+
+	return sock;
+#elif defined USE_SDL_NET
+	IPaddress serverAddress;
+	TCPsocket serverSocket;
+
+	serverAddress.port = NET_PORT;
+	serverAddress.host = inet_addr(address);
+	serverSocket = SDLNet_TCP_Open(&serverAddress);
+
+	if (serverSocket == NULL) return E_N_CONNECT;
+
+	return (int)serverSocket;
+#else
+	return E_N_OTHER;
+#endif
+
+}
+
+
 /**
  * Accept a connection to a client
  *
@@ -309,6 +462,8 @@ int Network::accept (int sock) {
 		length = 1;
 		ioctl(clientSocket, FIONBIO, (u_long *)&length);
 
+		setNoDelay(clientSocket);
+
 	}
 
 	return clientSocket;
@@ -357,10 +512,27 @@ void Network::close (int sock) {
  */
 int Network::send (int sock, unsigned char *buffer) {
 
+	return send(sock, buffer, buffer[0]);
+
+}
+
+
+/**
+ * Send a block of data, which may hold several messages, over the specified
+ * connection.
+ *
+ * @param sock Connection socket
+ * @param buffer Data to be sent
+ * @param length Number of bytes to send
+ *
+ * @return Number of bytes sent, or -1 for failure
+ */
+int Network::send (int sock, unsigned char *buffer, int length) {
+
 #ifdef USE_SOCKETS
-	return ::send(sock, (char *)buffer, buffer[0], MSG_NOSIGNAL);
+	return ::send(sock, (char *)buffer, length, MSG_NOSIGNAL);
 #elif defined USE_SDL_NET
-	return SDLNet_TCP_Send((TCPsocket)sock, (char *)buffer, buffer[0]);
+	return SDLNet_TCP_Send((TCPsocket)sock, (char *)buffer, length);
 #else
 	return 0;
 #endif
@@ -439,3 +611,1135 @@ int Network::getError () {
 }
 
 
+
+/**
+ * Open a datagram socket on which a server receives from all of its clients.
+ *
+ * @return Datagram socket or error code
+ */
+int Network::hostDatagrams () {
+
+#ifdef USE_SOCKETS
+	sockaddr_in sockAddr;
+	int sock, nonblock;
+
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+	if (sock == -1) return E_N_SOCKET;
+
+	nonblock = 1;
+	ioctl(sock, FIONBIO, (u_long *)&nonblock);
+
+	memset(&sockAddr, 0, sizeof(sockaddr_in));
+	sockAddr.sin_family = AF_INET;
+	sockAddr.sin_addr.s_addr = INADDR_ANY;
+	sockAddr.sin_port = htons(NET_PORT);
+
+	if (bind(sock, (sockaddr *)&sockAddr, sizeof(sockaddr_in))) {
+
+		close(sock);
+
+		return E_N_BIND;
+
+	}
+
+	return sock;
+#else
+	return E_N_OTHER;
+#endif
+
+}
+
+
+/**
+ * Open a datagram socket on which a client exchanges datagrams with a server.
+ *
+ * @param address Address of the server
+ *
+ * @return Datagram socket or error code
+ */
+int Network::joinDatagrams (const char *address) {
+
+#ifdef USE_SOCKETS
+	sockaddr_in sockAddr;
+	int sock, nonblock;
+
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+	if (sock == -1) return E_N_SOCKET;
+
+	nonblock = 1;
+	ioctl(sock, FIONBIO, (u_long *)&nonblock);
+
+	memset(&sockAddr, 0, sizeof(sockaddr_in));
+	sockAddr.sin_family = AF_INET;
+	sockAddr.sin_port = htons(NET_PORT);
+
+	#ifdef _WIN32
+	sockAddr.sin_addr.s_addr = inet_addr(address);
+	#else
+	if (inet_aton(address, &(sockAddr.sin_addr)) == 0) {
+
+		close(sock);
+
+		return E_N_ADDRESS;
+
+	}
+	#endif
+
+	// Only accept datagrams from the server
+	if (::connect(sock, (sockaddr *)&sockAddr, sizeof(sockAddr))) {
+
+		close(sock);
+
+		return E_N_CONNECT;
+
+	}
+
+	return sock;
+#else
+	(void)address;
+
+	return E_N_OTHER;
+#endif
+
+}
+
+
+/**
+ * Send a datagram.
+ *
+ * @param sock Datagram socket
+ * @param address Destination, or NULL if the socket is connected
+ * @param buffer The datagram
+ * @param length Length of the datagram
+ *
+ * @return Number of bytes sent, or -1 for failure
+ */
+int Network::sendTo (int sock, NetAddress *address, unsigned char *buffer, int length) {
+
+#ifdef USE_SOCKETS
+	sockaddr_in sockAddr;
+
+	if (!address) return ::send(sock, (char *)buffer, length, MSG_NOSIGNAL);
+
+	memset(&sockAddr, 0, sizeof(sockaddr_in));
+	sockAddr.sin_family = AF_INET;
+	sockAddr.sin_addr.s_addr = address->host;
+	sockAddr.sin_port = address->port;
+
+	return ::sendto(sock, (char *)buffer, length, MSG_NOSIGNAL, (sockaddr *)&sockAddr, sizeof(sockaddr_in));
+#else
+	(void)sock;
+	(void)address;
+	(void)buffer;
+	(void)length;
+
+	return -1;
+#endif
+
+}
+
+
+/**
+ * Receive a datagram, if one is waiting.
+ *
+ * @param sock Datagram socket
+ * @param address Receives the sender's address, unless NULL
+ * @param buffer Buffer to receive the datagram
+ * @param length The size of the buffer, in bytes
+ *
+ * @return Length of the datagram, or -1 if there is none
+ */
+int Network::recvFrom (int sock, NetAddress *address, unsigned char *buffer, int length) {
+
+#ifdef USE_SOCKETS
+	sockaddr_in sockAddr;
+	socklen_t addressLength;
+
+	addressLength = sizeof(sockaddr_in);
+
+	length = ::recvfrom(sock, (char *)buffer, length, MSG_NOSIGNAL, (sockaddr *)&sockAddr, &addressLength);
+
+	if ((length >= 0) && address) {
+
+		address->host = sockAddr.sin_addr.s_addr;
+		address->port = sockAddr.sin_port;
+
+	}
+
+	return length;
+#else
+	(void)sock;
+	(void)address;
+	(void)buffer;
+	(void)length;
+
+	return -1;
+#endif
+
+}
+
+
+
+/**
+ * Create an unused connection.
+ */
+Connection::Connection () {
+
+	open(-1);
+
+	return;
+
+}
+
+
+/**
+ * Use the connection for a new socket, discarding any buffered data.
+ *
+ * @param newSock The connection socket
+ */
+void Connection::open (int newSock) {
+
+	sock = newSock;
+	readPos = writePos = 0;
+	outputLength = 0;
+
+	memset(&stats, 0, sizeof(NetStats));
+
+	return;
+
+}
+
+
+/**
+ * Get the connection's socket.
+ *
+ * @return The connection socket
+ */
+int Connection::getSocket () {
+
+	return sock;
+
+}
+
+
+/**
+ * Receive as much waiting data as will fit into the buffer. This starts a new
+ * step, so it should be followed by calls to getMessage() until no complete
+ * message remains.
+ *
+ * @return Number of bytes received
+ */
+int Connection::receive () {
+
+	unsigned int position, space;
+	int length;
+
+	resetStats();
+
+	do {
+
+		space = NET_BUFFER - (writePos - readPos);
+
+		if (!space) break;
+
+		// Fill up to the end of the buffer. If that fills it, carry on from the start.
+		position = writePos & (NET_BUFFER - 1);
+		if (space > NET_BUFFER - position) space = NET_BUFFER - position;
+
+		length = net->recv(sock, buffer + position, space);
+
+		if (length <= 0) break;
+
+		writePos += length;
+		stats.bytes += length;
+
+	} while (length == (int)space);
+
+	stats.backlog = writePos - readPos;
+
+	return stats.bytes;
+
+}
+
+
+/**
+ * Take the next complete message from the buffer.
+ *
+ * @return The message (valid until the next call to receive()), or NULL if no complete message has arrived
+ */
+unsigned char* Connection::getMessage () {
+
+	unsigned int position, length, first;
+
+	while (writePos != readPos) {
+
+		position = readPos & (NET_BUFFER - 1);
+		length = buffer[position];
+
+		// Skip lengths too short to hold a message type
+		if (length < 2) {
+
+			readPos++;
+
+			continue;
+
+		}
+
+		if (writePos - readPos < length) break;
+
+		readPos += length;
+
+		stats.messages++;
+		stats.backlog = writePos - readPos;
+
+		if (position + length <= NET_BUFFER) return buffer + position;
+
+		// The message wraps around the end of the buffer, so join its parts
+		first = NET_BUFFER - position;
+		memcpy(message, buffer + position, first);
+		memcpy(message + first, buffer, length - first);
+
+		return message;
+
+	}
+
+	stats.backlog = writePos - readPos;
+
+	return NULL;
+
+}
+
+
+/**
+ * Add a message to those waiting to be sent. If there is no room, the waiting
+ * messages are sent first.
+ *
+ * @param data The message. First byte indicates length.
+ *
+ * @return False if the message was dropped because the connection is backed up
+ */
+bool Connection::queue (unsigned char *data) {
+
+	if (outputLength + data[0] > NET_OUTPUT) flush();
+
+	if (outputLength + data[0] > NET_OUTPUT) {
+
+		stats.dropped++;
+
+		return false;
+
+	}
+
+	memcpy(output + outputLength, data, data[0]);
+	outputLength += data[0];
+
+	return true;
+
+}
+
+
+/**
+ * Get the amount of room left for messages waiting to be sent.
+ *
+ * @return Number of bytes
+ */
+int Connection::getSpace () {
+
+	return NET_OUTPUT - outputLength;
+
+}
+
+
+/**
+ * Send as many of the waiting messages as the connection will take. Anything
+ * left over is kept for the next flush.
+ *
+ * @return Number of bytes sent, or -1 for failure
+ */
+int Connection::flush () {
+
+	int length;
+
+	if (!outputLength) return 0;
+
+	length = net->send(sock, output, outputLength);
+
+	if (length <= 0) return length;
+
+	// Keep whatever did not fit
+	if (length < outputLength)
+		memmove(output, output + length, outputLength - length);
+
+	outputLength -= length;
+	stats.sent += length;
+
+	return length;
+
+}
+
+
+/**
+ * Start a new step without receiving data, for connections whose data is
+ * received by a NetPoller.
+ */
+void Connection::resetStats () {
+
+	stats.bytes = 0;
+	stats.messages = 0;
+	stats.sent = 0;
+	stats.dropped = 0;
+
+	return;
+
+}
+
+
+/**
+ * Get the amount of data passed during the current step.
+ *
+ * @return Traffic statistics
+ */
+const NetStats* Connection::getStats () {
+
+	return &stats;
+
+}
+
+
+
+
+
+/**
+ * Create an idle poller.
+ */
+NetPoller::NetPoller () {
+
+	readPos = writePos = 0;
+	hostSock = pollSock = -1;
+	hostWatched = false;
+	accepting = false;
+	full = false;
+	running = false;
+	thread = NULL;
+	drained = NULL;
+
+	return;
+
+}
+
+
+/**
+ * Stop the network thread.
+ */
+NetPoller::~NetPoller () {
+
+	stop();
+
+	return;
+
+}
+
+
+/**
+ * Start waiting for connections to the host socket, and for data from the
+ * clients that connect.
+ *
+ * @param sock The host socket
+ *
+ * @return False if connections cannot be polled, and must instead be checked by the game
+ */
+bool NetPoller::start (int sock) {
+
+#ifdef USE_POLL
+	int count;
+
+	if (running) return true;
+
+	for (count = 0; count < MAX_CLIENTS; count++) {
+
+		socks[count] = -1;
+		partialLength[count] = 0;
+
+	}
+
+	hostSock = sock;
+	hostWatched = false;
+	readPos = writePos = 0;
+	accepting = true;
+	full = false;
+
+	#ifdef USE_EPOLL
+	pollSock = epoll_create(MAX_CLIENTS + 1);
+
+	if (pollSock == -1) {
+
+		log("Could not create epoll instance - code", net->getError());
+
+		return false;
+
+	}
+	#endif
+
+	drained = SDL_CreateSemaphore(0);
+	running = true;
+	thread = SDL_CreateThread(loop, this);
+
+	if (!thread) {
+
+		logError("Unable to start network thread", SDL_GetError());
+
+		running = false;
+
+		SDL_DestroySemaphore(drained);
+		drained = NULL;
+
+	#ifdef USE_EPOLL
+		::close(pollSock);
+		pollSock = -1;
+	#endif
+
+		return false;
+
+	}
+
+	return true;
+#else
+	(void)sock;
+
+	return false;
+#endif
+
+}
+
+
+/**
+ * Stop the network thread. Events already in the queue can still be taken.
+ * The client sockets are left open.
+ */
+void NetPoller::stop () {
+
+	if (!running) return;
+
+	running = false;
+	SDL_SemPost(drained);
+	SDL_WaitThread(thread, NULL);
+	thread = NULL;
+
+	SDL_DestroySemaphore(drained);
+	drained = NULL;
+
+#ifdef USE_EPOLL
+	::close(pollSock);
+	pollSock = -1;
+#endif
+
+	return;
+
+}
+
+
+/**
+ * Set whether or not new connections are accepted. Connections which are not
+ * accepted wait until they are.
+ *
+ * @param accept Whether or not to accept new connections
+ */
+void NetPoller::setAccepting (bool accept) {
+
+	accepting = accept;
+
+	return;
+
+}
+
+
+/**
+ * Network thread.
+ *
+ * @param data The poller
+ *
+ * @return Always 0
+ */
+int NetPoller::loop (void *data) {
+
+	((NetPoller *)data)->run();
+
+	return 0;
+
+}
+
+
+/**
+ * Wait for activity on any of the sockets, and deal with it, until stopped.
+ */
+void NetPoller::run () {
+
+#ifdef USE_POLL
+	#ifdef USE_EPOLL
+	epoll_event pollEvents[MAX_CLIENTS + 1];
+	epoll_event pollEvent;
+	#else
+	pollfd pollSocks[MAX_CLIENTS + 1];
+	int pollClients[MAX_CLIENTS + 1];
+	int nSocks;
+	#endif
+	int count, client, ready;
+	bool watch;
+
+	while (running) {
+
+		// Wait for the game to make room for more events
+		if (getRoom() < NET_ROOM) {
+
+			full = true;
+			SDL_SemWaitTimeout(drained, T_POLL);
+
+			continue;
+
+		}
+
+		// Only wait for new connections while one could be accepted
+
+		watch = false;
+
+		if (accepting) {
+
+			for (client = 0; client < MAX_CLIENTS; client++) {
+
+				if (socks[client] == -1) {
+
+					watch = true;
+
+					break;
+
+				}
+
+			}
+
+		}
+
+	#ifdef USE_EPOLL
+		if (watch != hostWatched) {
+
+			memset(&pollEvent, 0, sizeof(epoll_event));
+			pollEvent.events = EPOLLIN;
+			pollEvent.data.u32 = MAX_CLIENTS;
+
+			// If this fails, it is tried again next time round
+			if (epoll_ctl(pollSock, watch? EPOLL_CTL_ADD: EPOLL_CTL_DEL, hostSock, &pollEvent) != -1)
+				hostWatched = watch;
+
+		}
+
+		ready = epoll_wait(pollSock, pollEvents, MAX_CLIENTS + 1, T_POLL);
+
+		for (count = 0; count < ready; count++) {
+
+			client = pollEvents[count].data.u32;
+
+			if (client == MAX_CLIENTS) acceptClient();
+			else if (getRoom() >= NET_ROOM) readClient(client);
+
+		}
+	#else
+		nSocks = 0;
+
+		if (watch) {
+
+			pollSocks[0].fd = hostSock;
+			pollSocks[0].events = POLLIN;
+			pollClients[0] = MAX_CLIENTS;
+			nSocks = 1;
+
+		}
+
+		for (client = 0; client < MAX_CLIENTS; client++) {
+
+			if (socks[client] != -1) {
+
+				pollSocks[nSocks].fd = socks[client];
+				pollSocks[nSocks].events = POLLIN;
+				pollClients[nSocks] = client;
+				nSocks++;
+
+			}
+
+		}
+
+		ready = poll(pollSocks, nSocks, T_POLL);
+
+		for (count = 0; (ready > 0) && (count < nSocks); count++) {
+
+			if (!pollSocks[count].revents) continue;
+
+			client = pollClients[count];
+
+			if (client == MAX_CLIENTS) acceptClient();
+			else if (getRoom() >= NET_ROOM) readClient(client);
+
+		}
+	#endif
+
+	}
+#endif
+
+	return;
+
+}
+
+
+/**
+ * Add an event to the queue. Only used by the network thread.
+ *
+ * @param type The type of event
+ * @param client The client concerned
+ * @param data Data accompanying the event
+ * @param length Number of bytes of data
+ *
+ * @return False if there was no room for the event
+ */
+bool NetPoller::add (NetEvent type, int client, unsigned char *data, int length) {
+
+	unsigned int position;
+	int count;
+
+	if (getRoom() < length + 2) return false;
+
+	position = writePos;
+
+	events[position++ & (NET_QUEUE - 1)] = type;
+	events[position++ & (NET_QUEUE - 1)] = client;
+
+	for (count = 0; count < length; count++)
+		events[position++ & (NET_QUEUE - 1)] = data[count];
+
+	// Only let the game see the event once it is complete
+	MEMORY_BARRIER();
+	writePos = position;
+
+	return true;
+
+}
+
+
+/**
+ * Get the amount of room left in the queue.
+ *
+ * @return Number of bytes
+ */
+int NetPoller::getRoom () {
+
+	MEMORY_BARRIER();
+
+	return NET_QUEUE - (writePos - readPos);
+
+}
+
+
+/**
+ * Accept a new connection into a free client slot. Only used by the network
+ * thread.
+ */
+void NetPoller::acceptClient () {
+
+#ifdef USE_EPOLL
+	epoll_event pollEvent;
+#endif
+	unsigned char data[4];
+	int client, sock;
+
+	for (client = 0; client < MAX_CLIENTS; client++) {
+
+		if (socks[client] == -1) break;
+
+	}
+
+	if (client == MAX_CLIENTS) return;
+
+	sock = net->accept(hostSock);
+
+	if (sock == -1) return;
+
+#ifdef USE_EPOLL
+	memset(&pollEvent, 0, sizeof(epoll_event));
+	pollEvent.events = EPOLLIN;
+	pollEvent.data.u32 = client;
+
+	if (epoll_ctl(pollSock, EPOLL_CTL_ADD, sock, &pollEvent) == -1) {
+
+		net->close(sock);
+
+		return;
+
+	}
+#endif
+
+	socks[client] = sock;
+	partialLength[client] = 0;
+
+	data[0] = sock >> 24;
+	data[1] = (sock >> 16) & 255;
+	data[2] = (sock >> 8) & 255;
+	data[3] = sock & 255;
+	add(NE_CONNECT, client, data, 4);
+
+	return;
+
+}
+
+
+/**
+ * Read whatever a client has sent, and add each complete message to the
+ * queue. Only used by the network thread.
+ *
+ * @param client The client
+ */
+void NetPoller::readClient (int client) {
+
+	unsigned char data[NET_READ];
+	unsigned char *message;
+	int length, position, part;
+
+	if (socks[client] == -1) return;
+
+	length = net->recv(socks[client], data, NET_READ);
+
+	if (length <= 0) {
+
+#ifdef USE_POLL
+		// Nothing to read after all
+		if ((length == -1) && ((errno == EWOULDBLOCK) || (errno == EAGAIN) || (errno == EINTR)))
+			return;
+#endif
+
+		dropClient(client);
+
+		return;
+
+	}
+
+	message = partial[client];
+	position = 0;
+
+	while (position < length) {
+
+		if (!partialLength[client]) {
+
+			// Skip lengths too short to hold a message type
+			if (data[position] < 2) {
+
+				position++;
+
+				continue;
+
+			}
+
+			message[0] = data[position++];
+			partialLength[client] = 1;
+
+		}
+
+		part = message[0] - partialLength[client];
+		if (part > length - position) part = length - position;
+
+		memcpy(message + partialLength[client], data + position, part);
+		partialLength[client] += part;
+		position += part;
+
+		if (partialLength[client] == message[0]) {
+
+			add(NE_MESSAGE, client, message, message[0]);
+			partialLength[client] = 0;
+
+		}
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Stop waiting on a client which has disconnected, and tell the game. The game
+ * closes the socket. Only used by the network thread.
+ *
+ * @param client The client
+ */
+void NetPoller::dropClient (int client) {
+
+#ifdef USE_EPOLL
+	epoll_event pollEvent;
+
+	// Older kernels need an event, even though it is not used
+	memset(&pollEvent, 0, sizeof(epoll_event));
+
+	// Closing the socket also stops it being watched, so carry on regardless
+	if (epoll_ctl(pollSock, EPOLL_CTL_DEL, socks[client], &pollEvent) == -1)
+		log("Could not stop waiting on client - code", net->getError());
+#endif
+
+	socks[client] = -1;
+	partialLength[client] = 0;
+
+	add(NE_DISCONNECT, client, NULL, 0);
+
+	return;
+
+}
+
+
+/**
+ * Take the next event from the queue.
+ *
+ * @param client The client concerned
+ * @param sock For NE_CONNECT, the new client's socket
+ * @param message For NE_MESSAGE, the message (valid until the next call). First byte indicates length.
+ *
+ * @return The type of event, or NE_NONE if the queue is empty
+ */
+NetEvent NetPoller::getEvent (int &client, int &sock, unsigned char *&message) {
+
+	unsigned int position;
+	int length, count;
+	NetEvent type;
+
+	MEMORY_BARRIER();
+
+	if (writePos == readPos) {
+
+		// Let the network thread carry on
+		if (full && drained) {
+
+			full = false;
+			SDL_SemPost(drained);
+
+		}
+
+		return NE_NONE;
+
+	}
+
+	position = readPos;
+
+	type = (NetEvent)events[position++ & (NET_QUEUE - 1)];
+	client = events[position++ & (NET_QUEUE - 1)];
+
+	if (type == NE_MESSAGE) length = events[position & (NET_QUEUE - 1)];
+	else if (type == NE_CONNECT) length = 4;
+	else length = 0;
+
+	for (count = 0; count < length; count++)
+		event[count] = events[position++ & (NET_QUEUE - 1)];
+
+	if (type == NE_CONNECT)
+		sock = (event[0] << 24) + (event[1] << 16) + (event[2] << 8) + event[3];
+
+	message = event;
+
+	// Only let the network thread reuse the space once the event has been copied
+	MEMORY_BARRIER();
+	readPos = position;
+
+	return type;
+
+}
+
+
+/**
+ * Get the amount of data waiting in the queue.
+ *
+ * @return Number of bytes
+ */
+int NetPoller::getBacklog () {
+
+	MEMORY_BARRIER();
+
+	return writePos - readPos;
+
+}
+
+
+
+
+/**
+ * Create an inactive network simulator.
+ */
+NetSimulator::NetSimulator () {
+
+	held = NULL;
+	seed = 1;
+	loss = latency = jitter = dropped = 0;
+
+	return;
+
+}
+
+
+/**
+ * Destroy the simulator, discarding any datagrams still held back.
+ */
+NetSimulator::~NetSimulator () {
+
+	if (held) {
+
+		if (dropped) log("Simulated datagrams dropped", dropped);
+
+		delete[] held;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Start dropping and delaying datagrams.
+ *
+ * @param newLoss Percentage of datagrams dropped
+ * @param newLatency Delay added to every datagram, in milliseconds
+ * @param newJitter Most extra delay added to each datagram, in milliseconds
+ */
+void NetSimulator::activate (int newLoss, int newLatency, int newJitter) {
+
+	int count;
+
+	if (!held) {
+
+		held = new HeldDatagram[NET_HELD];
+
+		for (count = 0; count < NET_HELD; count++) held[count].sock = -1;
+
+	}
+
+	loss = (newLoss < 0)? 0: newLoss;
+	latency = (newLatency < 0)? 0: newLatency;
+	jitter = (newJitter < 0)? 0: newJitter;
+	seed = SDL_GetTicks() | 1;
+
+	log("Simulating datagram loss (%)", loss);
+	log("Simulating datagram latency (ms)", latency);
+	log("Simulating datagram jitter (ms)", jitter);
+
+	return;
+
+}
+
+
+/**
+ * Get the next number from the random number generator.
+ *
+ * @return A number from 0 to 32767
+ */
+int NetSimulator::random () {
+
+	seed = (seed * 1103515245) + 12345;
+
+	return (seed >> 16) & 32767;
+
+}
+
+
+/**
+ * Send a datagram, unless the simulator drops it, once its delay has passed.
+ *
+ * @param sock Datagram socket
+ * @param address Destination, or NULL if the socket is connected
+ * @param buffer The datagram
+ * @param length Length of the datagram
+ *
+ * @return Number of bytes sent, or -1 for failure
+ */
+int NetSimulator::send (int sock, NetAddress *address, unsigned char *buffer, int length) {
+
+	HeldDatagram* datagram;
+	int count;
+
+	if (!held) return net->sendTo(sock, address, buffer, length);
+
+	if ((length > DATAGRAM_SIZE) || ((random() % 100) < loss)) {
+
+		dropped++;
+
+		return length;
+
+	}
+
+	for (count = 0; count < NET_HELD; count++) {
+
+		datagram = held + count;
+
+		if (datagram->sock != -1) continue;
+
+		memcpy(datagram->data, buffer, length);
+		if (address) datagram->address = *address;
+		datagram->addressed = (address != NULL);
+		datagram->time = SDL_GetTicks() + latency + (jitter? random() % (jitter + 1): 0);
+		datagram->sock = sock;
+		datagram->length = length;
+
+		return length;
+
+	}
+
+	// No room, so the datagram is lost as if the network were congested
+	dropped++;
+
+	return length;
+
+}
+
+
+/**
+ * Send the held datagrams whose delay has passed. With jitter, this may be in
+ * a different order to that in which they were given.
+ */
+void NetSimulator::flush () {
+
+	HeldDatagram* datagram;
+	unsigned int ticks;
+	int count;
+
+	if (!held) return;
+
+	ticks = SDL_GetTicks();
+
+	for (count = 0; count < NET_HELD; count++) {
+
+		datagram = held + count;
+
+		if ((datagram->sock == -1) || ((int)(ticks - datagram->time) < 0)) continue;
+
+		net->sendTo(datagram->sock, datagram->addressed? &(datagram->address): NULL,
+			datagram->data, datagram->length);
+
+		datagram->sock = -1;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Discard the held datagrams for a socket which is about to be closed.
+ *
+ * @param sock Datagram socket
+ */
+void NetSimulator::discard (int sock) {
+
+	int count;
+
+	if (!held) return;
+
+	for (count = 0; count < NET_HELD; count++)
+		if (held[count].sock == sock) held[count].sock = -1;
+
+	return;
+
+}
+
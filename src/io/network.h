@@ -26,6 +26,16 @@
 #ifdef USE_SDL_NET
 #include <SDL_net.h>
 #endif
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
+
+// Wait on all connections at once, where possible
+#if defined(USE_SOCKETS) && !defined(_WIN32)
+	#define USE_POLL
+	#ifdef __linux__
+		#define USE_EPOLL
+	#endif
+#endif
 
 // Constants
 
@@ -37,17 +47,82 @@
 #endif
 #define NET_PORT    10052
 
-// Timeout interval
+// Timeout intervals
 #define T_TIMEOUT 30000
+#define T_CONNECT 5000 /* Longest wait for a connection made without showing progress */
+
+// Longest wait for network activity, so that the network thread notices being stopped
+#define T_POLL 50
 
 // Client limit
-#define MAX_CLIENTS   31
+#define MAX_CLIENTS   63
+
+// Level files received from servers, named by content hash and size
+#define LEVEL_FILE  "openjazz"
+#define LEVEL_CACHE LEVEL_FILE "-%08x-%d.tmp"
+#define LEVEL_CACHE_INDEX LEVEL_FILE "-cache.dat" /* Received levels, least recently used first */
+#define LEVEL_CACHE_FILES 32 /* Number of received levels kept */
+
+// Buffering
+#define NET_BUFFER  8192 /* Size of each connection's receive buffer (a power of two) */
+#define NET_OUTPUT  16384 /* Size of each connection's send buffer */
+#define NET_MESSAGE 255 /* Longest message, as the first byte holds its length */
+#define NET_QUEUE   65536 /* Size of the queue of network events (a power of two) */
+#define NET_READ    4096 /* Largest amount of data read from a connection at once by the network thread */
+
+// Datagrams
+#define DATAGRAM_SIZE 1200 /* Largest datagram, small enough not to be fragmented */
+#define NET_HELD      256 /* Most datagrams held back by the network simulator */
+
+
+// Enum
+
+/// Events passed from the network thread to the game
+enum NetEvent {
+
+	NE_NONE, ///< No event waiting
+	NE_CONNECT, ///< A client has connected
+	NE_MESSAGE, ///< A message has been received from a client
+	NE_DISCONNECT ///< A client has disconnected
+
+};
 
-// Level file
-#define LEVEL_FILE  "openjazz.tmp"
 
+// Datatype
 
-// Class
+/// Data passed over a connection during one game step
+typedef struct {
+
+	int bytes; ///< Number of bytes received
+	int messages; ///< Number of complete messages taken from the buffer
+	int backlog; ///< Number of bytes waiting in the buffer
+	int sent; ///< Number of bytes sent
+	int dropped; ///< Number of messages which did not fit in the send buffer
+
+} NetStats;
+
+/// Address of the other end of a datagram socket
+typedef struct {
+
+	unsigned int   host; ///< IPv4 address, in network byte order
+	unsigned short port; ///< Port, in network byte order
+
+} NetAddress;
+
+/// Datagram held back by the network simulator
+typedef struct {
+
+	unsigned char data[DATAGRAM_SIZE]; ///< The datagram
+	NetAddress    address; ///< Destination
+	unsigned int  time; ///< Time at which the datagram is sent
+	int           sock; ///< Datagram socket, or -1 if unused
+	int           length; ///< Length of the datagram
+	bool          addressed; ///< Whether the destination is given, or the socket is connected
+
+} HeldDatagram;
+
+
+// Classes
 
 /// Networking
 class Network {
@@ -65,20 +140,125 @@ class Network {
 
 		int  host        ();
 		int  join        (char *address);
+		int  connect     (const char *address);
 		int  accept      (int sock);
 		void close       (int sock);
 		int  send        (int sock, unsigned char *buffer);
+		int  send        (int sock, unsigned char *buffer, int length);
 		int  recv        (int sock, unsigned char *buffer, int length);
 		bool isConnected (int sock);
 		int  getError    ();
 
+		int  hostDatagrams ();
+		int  joinDatagrams (const char *address);
+		int  sendTo        (int sock, NetAddress *address, unsigned char *buffer, int length);
+		int  recvFrom      (int sock, NetAddress *address, unsigned char *buffer, int length);
+
+};
+
+/// Buffers the data passed over a connection. Received data is split into
+/// messages, and messages to be sent are gathered and sent together.
+class Connection {
+
+	private:
+		unsigned char buffer[NET_BUFFER]; ///< Ring buffer of received data
+		unsigned char message[NET_MESSAGE]; ///< Copy of a message which wraps around the end of the buffer
+		unsigned char output[NET_OUTPUT]; ///< Messages waiting to be sent
+		unsigned int  readPos; ///< Position of the first byte not yet taken
+		unsigned int  writePos; ///< Position of the next byte to be received
+		int           outputLength; ///< Number of bytes waiting to be sent
+		NetStats      stats; ///< Data passed during the current step
+		int           sock; ///< Connection socket
+
+	public:
+		Connection ();
+
+		void            open       (int newSock);
+		int             getSocket  ();
+		int             receive    ();
+		unsigned char*  getMessage ();
+		bool            queue      (unsigned char *data);
+		int             getSpace   ();
+		int             flush      ();
+		void            resetStats ();
+		const NetStats* getStats   ();
+
+};
+
+/// Waits for activity on a host socket and its clients' sockets on a thread of
+/// its own. New connections, complete messages and disconnections are passed to
+/// the game, in the order in which they happened, through a queue.
+class NetPoller {
+
+	private:
+		unsigned char          events[NET_QUEUE]; ///< Ring buffer of events
+		unsigned char          event[NET_MESSAGE]; ///< Copy of the data of the event most recently taken
+		volatile unsigned int  readPos; ///< Position of the first event not yet taken. Only changed by the game.
+		volatile unsigned int  writePos; ///< Position of the next event to be added. Only changed by the network thread.
+		unsigned char          partial[MAX_CLIENTS][NET_MESSAGE]; ///< Incomplete message from each client
+		int                    partialLength[MAX_CLIENTS]; ///< Number of bytes of each incomplete message
+		int                    socks[MAX_CLIENTS]; ///< Socket of each client, or -1. Only used by the network thread.
+		int                    hostSock; ///< Host socket
+		int                    pollSock; ///< epoll instance
+		bool                   hostWatched; ///< Whether or not the host socket is in the epoll instance
+		volatile bool          accepting; ///< Whether or not new connections are accepted
+		volatile bool          full; ///< Whether or not the network thread is waiting for room in the queue
+		volatile bool          running; ///< Whether or not the network thread should keep running
+		SDL_Thread*            thread; ///< The network thread
+		SDL_sem*               drained; ///< Signalled when the game has emptied the queue
+
+		static int loop        (void *data);
+		void       run         ();
+		bool       add         (NetEvent type, int client, unsigned char *data, int length);
+		int        getRoom     ();
+		void       acceptClient ();
+		void       readClient  (int client);
+		void       dropClient  (int client);
+
+	public:
+		NetPoller  ();
+		~NetPoller ();
+
+		bool     start        (int sock);
+		void     stop         ();
+		void     setAccepting (bool accept);
+		NetEvent getEvent     (int &client, int &sock, unsigned char *&message);
+		int      getBacklog   ();
+
+};
+
+/// Simulates a poor network, by dropping some datagrams and delaying the rest
+/// before they are sent
+class NetSimulator {
+
+	private:
+		HeldDatagram* held; ///< Datagrams waiting to be sent
+		unsigned int  seed; ///< State of the random number generator
+		int           loss; ///< Percentage of datagrams dropped
+		int           latency; ///< Delay added to every datagram, in milliseconds
+		int           jitter; ///< Most extra delay added to each datagram, in milliseconds
+		int           dropped; ///< Number of datagrams dropped
+
+		int random ();
+
+	public:
+		NetSimulator  ();
+		~NetSimulator ();
+
+		void activate (int newLoss, int newLatency, int newJitter);
+		int  send     (int sock, NetAddress *address, unsigned char *buffer, int length);
+		void flush    ();
+		void discard  (int sock);
+
 };
 
 
 // Variables
 
-EXTERN char    *netAddress; /// Server address
-EXTERN Network *net;
+EXTERN char         *netAddress; /// Server address
+EXTERN bool          netDatagrams; /// Whether or not to send player updates over UDP, where the server allows
+EXTERN Network      *net;
+EXTERN NetSimulator  netSimulator; /// Drops and delays datagrams, for testing
 
 #endif
 
@@ -23,15 +23,19 @@
 
 #include "file.h"
 #include "sound.h"
+#include "trace.h"
 #include "util.h"
 
 #include <SDL_audio.h>
+#include <SDL_mutex.h>
+#include <SDL_thread.h>
 #include <psmplug.h>
+#include <stdio.h>
 
 #if defined(__SYMBIAN32__) || defined(_3DS) || defined(PSP) || defined(__vita__)
-	#define SOUND_FREQ 22050
+	#define SOUND_RATE 22050
 #else
-	#define SOUND_FREQ 44100
+	#define SOUND_RATE 44100
 #endif
 
 #if defined(GP2X) || defined(PSP) || defined(_3DS) || defined(__vita__)
@@ -42,77 +46,1157 @@
 
 #ifdef __SYMBIAN32__
 	#define MUSIC_RESAMPLEMODE MODPLUG_RESAMPLE_LINEAR
-	#define MUSIC_FLAGS MODPLUG_ENABLE_MEGABASS
+	#define MUSIC_FLAGS MODPLUG_ENABLE_MEGABASS | MODPLUG_ENABLE_SIMD
 #elif defined(CAANOO) || defined(WIZ) || defined(GP2X) || defined(DINGOO) || defined(PSP)
 	#define MUSIC_RESAMPLEMODE MODPLUG_RESAMPLE_LINEAR
-	#define MUSIC_FLAGS 0
+	#define MUSIC_FLAGS MODPLUG_ENABLE_SIMD
 #else
 	#define MUSIC_RESAMPLEMODE MODPLUG_RESAMPLE_FIR
-	#define MUSIC_FLAGS MODPLUG_ENABLE_NOISE_REDUCTION | MODPLUG_ENABLE_REVERB | MODPLUG_ENABLE_MEGABASS | MODPLUG_ENABLE_SURROUND
+	#define MUSIC_FLAGS MODPLUG_ENABLE_NOISE_REDUCTION | MODPLUG_ENABLE_REVERB | MODPLUG_ENABLE_MEGABASS | MODPLUG_ENABLE_SURROUND | MODPLUG_ENABLE_SIMD
 #endif
 
+#if defined(CAANOO) || defined(WIZ) || defined(GP2X) || defined(DINGOO) || defined(PSP) || defined(_3DS) || defined(__vita__)
+	#define MUSIC_CACHE true
+#else
+	#define MUSIC_CACHE false
+#endif
+
+#define MUSIC_BUFFERS 4 /* Audio buffers' worth of music decoded ahead */
+#define MUSIC_CHUNKS 8 /* Number of pieces in which the ring buffer is filled */
+
+#define MUSIC_CACHE_VERSION 2
+#define MUSIC_CACHE_HEADER (4 + ((MUSIC_CACHE_KEYS + 2 + MUSIC_ORDERS) * 4))
+#define MUSIC_CACHE_SECONDS 600 /* Longest music rendered before it is assumed not to repeat */
+#define MUSIC_RENDER_FRAMES 1024 /* Largest number of sample frames rendered at once */
+#define MUSIC_RENDER_REST 2 /* Milliseconds the music thread waits between rendered pieces */
+
+#define AUDIO_STATS_CALLBACKS 16 /* Number of callbacks for which times are kept */
+
+#define AUDIO_BENCHMARK_SECONDS 60 /* Default length of music rendered by the audio benchmark */
+#define AUDIO_BENCHMARK_TRIGGER 50 /* Milliseconds between sound effects in the audio benchmark */
+#define AUDIO_BENCHMARK_CONFIGS 9
+
 ModPlugFile *musicFile;
 SDL_AudioSpec  audioSpec;
-bool musicPaused = false;
+bool musicPaused = false; // Only changed by the audio callback
 int musicVolume = MAX_VOLUME >> 1; // 50%
 int soundVolume = MAX_VOLUME >> 2; // 25%
 char *currentMusic = NULL;
 int musicTempo = MUSIC_NORMAL;
+int soundRate = SOUND_RATE;
+int soundSamples = SOUND_SAMPLES;
+bool audioOpen = false;
+Voice voices[MAX_VOICES];
+int nVoices = SOUND_VOICES;
+unsigned int voiceAge = 0;
+int mixVolume = MAX_VOLUME >> 2; // Sound effect volume used by the audio callback
+int activeVoices = SOUND_VOICES; // Number of voices used by the audio callback
+fixed listenerX = 0;
+fixed listenerY = 0;
+int *mixBuffer = NULL;
+int mixLength = 0;
+
+SDL_Thread *musicThread = NULL;
+SDL_mutex *musicMutex = NULL;
+SDL_sem *musicSem = NULL;
+volatile bool musicRunning = false;
+unsigned char *musicRing = NULL;
+unsigned int musicRingSize = 0;
+unsigned int musicChunk = 0;
+volatile unsigned int musicRead = 0; // Only changed by the audio callback
+volatile unsigned int musicWrite = 0; // Only changed by the music thread
+volatile unsigned int musicFlushPosition = 0;
+volatile unsigned int musicFlushes = 0;
+unsigned int musicFlushesDone = 0;
+
+bool musicCacheEnabled = MUSIC_CACHE;
+MusicCache musicCache;
+MusicRender *musicRender = NULL; // Only used by the music thread while set
+int musicLivePosition = 0; // Only changed by the music thread
+
+AudioCommand commands[AUDIO_COMMANDS];
+volatile unsigned int commandRead = 0; // Only changed by the audio callback
+volatile unsigned int commandWrite = 0; // Only changed by the game
+unsigned int soundPosted[32];
+volatile unsigned int playingSounds = 0;
+
+unsigned int callbackTimes[AUDIO_STATS_CALLBACKS];
+unsigned int callbackStart = 0;
+int callback = 0;
+volatile int lateCallbacks = 0;
+volatile int underruns = 0;
+
+
+/**
+ * Prevent the music decoder from being used by the music thread, or by the
+ * audio callback if there is no music thread.
+ */
+void lockMusic () {
+
+	if (musicThread) SDL_LockMutex(musicMutex);
+	else SDL_LockAudio();
+
+	return;
+
+}
+
+
+/**
+ * Allow the music decoder to be used again.
+ */
+void unlockMusic () {
+
+	if (musicThread) SDL_UnlockMutex(musicMutex);
+	else SDL_UnlockAudio();
+
+	return;
+
+}
+
+
+/**
+ * Copy pre-rendered music into a buffer, going back to the point from which it
+ * repeats at the end. The music volume is applied, as the music was rendered at
+ * full volume.
+ *
+ * @param buffer Buffer to fill
+ * @param len Length of data to be placed in the buffer
+ *
+ * @return Length of data placed in the buffer
+ */
+int readMusicCache (unsigned char *buffer, int len) {
+
+	short *samples;
+	int total, length, count;
+
+	total = 0;
+
+	while (total < len) {
+
+		if (musicCache.position >= musicCache.length)
+			musicCache.position = musicCache.loop;
+
+		length = musicCache.length - musicCache.position;
+		if (length > len - total) length = len - total;
+
+		musicCache.file->seek(MUSIC_CACHE_HEADER + musicCache.position, true);
+		length = musicCache.file->loadBlock(buffer + total, length);
+
+		if (length <= 0) break;
+
+		musicCache.position += length;
+		total += length;
+
+	}
+
+	samples = (short *)buffer;
+
+	for (count = 0; count < total >> 1; count++)
+		samples[count] = (samples[count] * musicVolume) / MAX_VOLUME;
+
+	return total;
+
+}
+
+
+/**
+ * Write the header of a pre-rendered music file.
+ *
+ * @param file The file
+ * @param key Values identifying the music data and the settings used
+ * @param cache The rendered music's length, loop point and order positions
+ */
+void storeMusicCacheHeader (File *file, int *key, MusicCache *cache) {
+
+	int count;
+
+	file->seek(0, true);
+
+	file->storeChar('O');
+	file->storeChar('J');
+	file->storeChar('M');
+	file->storeChar(MUSIC_CACHE_VERSION);
+
+	for (count = 0; count < MUSIC_CACHE_KEYS; count++) file->storeInt(key[count]);
+
+	file->storeInt(cache->length);
+	file->storeInt(cache->loop);
+
+	for (count = 0; count < MUSIC_ORDERS; count++) file->storeInt(cache->orders[count]);
+
+	return;
+
+}
+
+
+/**
+ * Open a pre-rendered music file, if it was rendered from the same music data
+ * with the same settings.
+ *
+ * @param cache Pre-rendered music to fill in
+ * @param cacheName Name of the pre-rendered music file
+ * @param key Values identifying the music data and the settings used
+ *
+ * @return Whether or not the file can be used
+ */
+bool loadMusicCache (MusicCache *cache, const char *cacheName, int *key) {
+
+	File *file;
+	bool valid;
+	int count;
+
+	try {
+
+		file = new File(cacheName, false);
+
+	} catch (int e) {
+
+		return false;
+
+	}
+
+	valid = (file->getSize() > MUSIC_CACHE_HEADER) &&
+		(file->loadChar() == 'O') && (file->loadChar() == 'J') &&
+		(file->loadChar() == 'M') && (file->loadChar() == MUSIC_CACHE_VERSION);
+
+	for (count = 0; valid && (count < MUSIC_CACHE_KEYS); count++)
+		valid = (file->loadInt() == key[count]);
+
+	if (valid) {
+
+		cache->length = file->loadInt();
+		cache->loop = file->loadInt();
+
+		for (count = 0; count < MUSIC_ORDERS; count++)
+			cache->orders[count] = file->loadInt();
+
+		// Check that the file is complete
+		valid = (cache->length > 0) && (cache->loop >= 0) &&
+			(cache->loop < cache->length) &&
+			(file->getSize() == MUSIC_CACHE_HEADER + cache->length);
+
+	}
+
+	if (!valid) {
+
+		delete file;
+
+		return false;
+
+	}
+
+	cache->file = file;
+	cache->position = 0;
+	cache->live = false;
+
+	return true;
+
+}
+
+
+/**
+ * Switch between playing pre-rendered music and decoding the music, carrying on
+ * from the start of the order being played.
+ *
+ * @param live Whether or not to decode the music
+ */
+void switchMusicCache (bool live) {
+
+	int order, count;
+
+	if (live == musicCache.live) return;
+
+	if (live) {
+
+		// Find the order being played
+		order = 0;
+
+		for (count = 0; count < MUSIC_ORDERS; count++) {
+
+			if ((musicCache.orders[count] >= musicCache.orders[order]) &&
+				(musicCache.orders[count] <= musicCache.position))
+				order = count;
+
+		}
+
+		ModPlug_SeekOrder(musicFile, order);
+
+	} else {
+
+		order = ModPlug_GetCurrentOrder(musicFile);
+
+		if ((order >= 0) && (order < MUSIC_ORDERS) && (musicCache.orders[order] >= 0))
+			musicCache.position = musicCache.orders[order];
+
+	}
+
+	musicCache.live = live;
+
+	return;
+
+}
+
+
+/**
+ * Render the next piece of music to its file.
+ *
+ * The position of each row is noted as it is reached. When the player reports
+ * that the music has jumped back to repeat itself, the row it jumped to is
+ * looked up to find where the loop starts. This also finds loops back to an
+ * earlier row of the same order. Such jumps happen at the start of a tick, so
+ * the music is rendered up to each tick, then the first sample of the tick on
+ * its own.
+ *
+ * @param render The music being rendered
+ *
+ * @return Whether or not the music has been rendered completely
+ */
+bool renderMusic (MusicRender *render) {
+
+	MusicEntry *newEntries;
+	int rendered, left, length, order, row, count;
+
+	rendered = 0;
+
+	while (rendered < MUSIC_RENDER_FRAMES * render->frameSize) {
+
+		if (render->cache.length >= render->maxLength) return true;
+
+		left = ModPlug_GetTickSamples(render->music);
+
+		length = left? left: 1;
+		if (length > MUSIC_RENDER_FRAMES) length = MUSIC_RENDER_FRAMES;
+
+		length = ModPlug_Read(render->music, render->buffer, length * render->frameSize);
+
+		if (length <= 0) return true;
+
+		order = ModPlug_GetCurrentOrder(render->music);
+		row = ModPlug_GetCurrentRow(render->music);
+
+		if (!left && (ModPlug_GetLoops(render->music) != render->loops)) {
+
+			// Find where the row jumped to was first played
+			for (count = 0; count < render->nEntries; count++) {
+
+				if ((render->entries[count].order == order) &&
+					(render->entries[count].row == row))
+					break;
+
+			}
+
+			if (count < render->nEntries) {
+
+				render->cache.loop = render->entries[count].position;
+
+				return true;
+
+			}
+
+			// The row has not been played yet, so keep going
+			render->loops = ModPlug_GetLoops(render->music);
+
+		}
+
+		if (!left && ((order != render->lastOrder) || (row != render->lastRow))) {
+
+			if (render->nEntries == render->maxEntries) {
+
+				// Expand the entry array
+				render->maxEntries = render->maxEntries? render->maxEntries << 1: 64;
+				newEntries = new MusicEntry[render->maxEntries];
+
+				if (render->entries) {
+
+					memcpy(newEntries, render->entries, render->nEntries * sizeof(MusicEntry));
+					delete[] render->entries;
+
+				}
+
+				render->entries = newEntries;
+
+			}
+
+			render->entries[render->nEntries].order = order;
+			render->entries[render->nEntries].row = row;
+			render->entries[render->nEntries].position = render->cache.length;
+			render->nEntries++;
+
+			if ((order >= 0) && (order < MUSIC_ORDERS) && (render->cache.orders[order] < 0))
+				render->cache.orders[order] = render->cache.length;
+
+			render->lastOrder = order;
+			render->lastRow = row;
+
+		}
+
+		render->file->storeBlock(render->buffer, length);
+		render->cache.length += length;
+		rendered += length;
+
+	}
+
+	return false;
+
+}
+
+
+/**
+ * Delete music being rendered, and its copy of the music. An incomplete file is
+ * left with an empty header, so it is not used.
+ *
+ * @param render The music being rendered
+ */
+void freeMusicRender (MusicRender *render) {
+
+	ModPlug_Unload(render->music);
+
+	if (render->file) delete render->file;
+	if (render->entries) delete[] render->entries;
+
+	delete[] render->buffer;
+	delete[] render->name;
+	delete render;
+
+	return;
+
+}
+
+
+/**
+ * Complete the file of pre-rendered music, and play the music from it from then
+ * on. Called by the music thread.
+ *
+ * @param render The music being rendered
+ */
+void finishMusicRender (MusicRender *render) {
+
+	MusicCache cache;
+
+	storeMusicCacheHeader(render->file, render->key, &(render->cache));
+
+	delete render->file;
+	render->file = NULL;
+
+	if (!loadMusicCache(&cache, render->name, render->key)) return;
+
+	if ((musicLivePosition >= 0) && (musicTempo == MUSIC_NORMAL)) {
+
+		// Carry on from the point the decoder has reached
+		if (musicLivePosition < cache.length) cache.position = musicLivePosition;
+		else cache.position = cache.loop + ((musicLivePosition - cache.length) % (cache.length - cache.loop));
+
+		musicCache = cache;
+
+	} else {
+
+		// The tempo has changed, so only the order being played is known
+		cache.live = true;
+		musicCache = cache;
+
+		switchMusicCache(musicTempo == MUSIC_FAST);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Decode the next portion of music. Pre-rendered music is used, if there is
+ * any and it is being played at its normal tempo.
+ *
+ * @param buffer Buffer to fill
+ * @param len Length of data to be placed in the buffer
+ *
+ * @return Length of data placed in the buffer
+ */
+int decodeMusic (unsigned char *buffer, int len) {
+
+	int length;
+
+	if (musicCache.file && !musicCache.live) return readMusicCache(buffer, len);
+
+	if (!musicFile) return 0;
+
+	length = ModPlug_Read(musicFile, buffer, len);
+
+	// Keep track of the position reached, for when the music being rendered
+	// is ready, which is lost if the music is played at another tempo
+	if (musicRender && (length > 0)) {
+
+		if ((musicLivePosition >= 0) && (musicTempo == MUSIC_NORMAL))
+			musicLivePosition += length;
+		else musicLivePosition = -1;
+
+	}
+
+	return length;
+
+}
+
+
+/**
+ * Decode music ahead of the audio callback, into the ring buffer.
+ *
+ * @param data N/A
+ *
+ * @return Always 0
+ */
+int musicLoop (void *data) {
+
+	(void)data;
+
+	unsigned int space, position;
+	int length, wait;
+
+	while (musicRunning) {
+
+		length = 0;
+		wait = 20;
+
+		SDL_LockMutex(musicMutex);
+
+		MEMORY_BARRIER();
+
+		space = musicRingSize - (musicWrite - musicRead);
+		position = musicWrite & (musicRingSize - 1);
+
+		if ((musicFile || musicCache.file) && (space >= musicChunk)) {
+
+			TRACE_THREAD_SCOPE(TT_MUSIC, "decodeMusic");
+
+			space = musicRingSize - position;
+			if (space > musicChunk) space = musicChunk;
+
+			length = decodeMusic(musicRing + position, space);
+
+			if (length > 0) {
+
+				MEMORY_BARRIER();
+				musicWrite += length;
+
+			}
+
+		} else if (musicRender) {
+
+			TRACE_THREAD_SCOPE(TT_MUSIC, "renderMusic");
+
+			// Render music in advance while there is nothing to decode
+			if (renderMusic(musicRender)) {
+
+				finishMusicRender(musicRender);
+				freeMusicRender(musicRender);
+				musicRender = NULL;
+
+			}
+
+			wait = MUSIC_RENDER_REST;
+
+		}
+
+		SDL_UnlockMutex(musicMutex);
+
+		// Wait for the audio callback to make room, resting only briefly while
+		// rendering
+		if (length <= 0) SDL_SemWaitTimeout(musicSem, wait);
+
+	}
+
+	return 0;
+
+}
+
+
+/**
+ * Copy decoded music from the ring buffer to the output stream. Anything the
+ * music thread has not yet decoded is left silent.
+ *
+ * @param stream Output stream
+ * @param len Length of data to be placed in the output stream
+ */
+void readMusic (unsigned char *stream, int len) {
+
+	unsigned int available, position, part;
+
+	// Skip anything decoded before the music was changed
+	if (musicFlushesDone != musicFlushes) {
+
+		musicFlushesDone = musicFlushes;
+		MEMORY_BARRIER();
+
+		if ((int)(musicFlushPosition - musicRead) > 0) musicRead = musicFlushPosition;
+
+	}
+
+	MEMORY_BARRIER();
+
+	available = musicWrite - musicRead;
+
+	if (available > (unsigned int)len) available = len;
+	else if ((available < (unsigned int)len) && currentMusic) underruns++;
+
+	MEMORY_BARRIER();
+
+	position = musicRead & (musicRingSize - 1);
+	part = musicRingSize - position;
+	if (part > available) part = available;
+
+	memcpy(stream, musicRing + position, part);
+	memcpy(stream + part, musicRing, available - part);
+	memset(stream + available, audioSpec.silence, len - available);
+
+	MEMORY_BARRIER();
+
+	musicRead += available;
+
+	SDL_SemPost(musicSem);
+
+	return;
+
+}
+
+
+/**
+ * Replace the music being played. Music already decoded from the old file is
+ * not played.
+ *
+ * @param newMusic The new music (NULL for none)
+ * @param newCache The new music, pre-rendered (NULL for none)
+ * @param newRender The new music, to be rendered in advance (NULL for none)
+ */
+void swapMusic (ModPlugFile *newMusic, MusicCache *newCache, MusicRender *newRender) {
+
+	ModPlugFile *oldMusic;
+	File *oldCache;
+	MusicRender *oldRender;
+
+	lockMusic();
+
+	oldMusic = musicFile;
+	musicFile = newMusic;
+
+	oldCache = musicCache.file;
+	if (newCache) musicCache = *newCache;
+	else musicCache.file = NULL;
+
+	oldRender = musicRender;
+	musicRender = newRender;
+	musicLivePosition = 0;
+
+	musicFlushPosition = musicWrite;
+	MEMORY_BARRIER();
+	musicFlushes++;
+
+	unlockMusic();
+
+	if (oldMusic) ModPlug_Unload(oldMusic);
+	if (oldCache) delete oldCache;
+	if (oldRender) freeMusicRender(oldRender);
+
+	return;
+
+}
+
+
+/**
+ * Pass an operation to the audio callback, without waiting for it. If the queue
+ * is full, the operation is dropped.
+ *
+ * @param command The operation
+ *
+ * @return Whether or not the operation was queued
+ */
+bool postAudioCommand (AudioCommand *command) {
+
+	if (!audioOpen) return false;
+
+	MEMORY_BARRIER();
+
+	if (commandWrite - commandRead >= AUDIO_COMMANDS) return false;
+
+	commands[commandWrite & (AUDIO_COMMANDS - 1)] = *command;
+
+	MEMORY_BARRIER();
+
+	commandWrite++;
+
+	return true;
+
+}
+
+
+/**
+ * Start playing a sound effect, on a free voice or on the least important one.
+ *
+ * @param command The operation
+ */
+void startVoice (AudioCommand *command) {
+
+	Voice *voice;
+	int count;
+
+	voice = NULL;
+
+	for (count = 0; count < activeVoices; count++) {
+
+		if (voices[count].sound < 0) {
+
+			voice = voices + count;
+
+			break;
+
+		}
+
+		if (!voice || (voices[count].priority < voice->priority) ||
+			((voices[count].priority == voice->priority) &&
+			(voices[count].age < voice->age)))
+			voice = voices + count;
+
+	}
+
+	if (voice && ((voice->sound < 0) || (voice->priority <= command->priority))) {
+
+		voice->sound = command->value;
+		voice->data = command->data;
+		voice->length = command->length;
+		voice->position = 0;
+		voice->volume = command->volume;
+		voice->pan = command->pan;
+		voice->priority = command->priority;
+		voice->age = voiceAge++;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Carry out the operations passed to the audio callback.
+ *
+ * @return Position in the queue up to which operations have been carried out
+ */
+unsigned int runAudioCommands () {
+
+	AudioCommand *command;
+	unsigned int position, end;
+	int count;
+
+	end = commandWrite;
+
+	MEMORY_BARRIER();
+
+	for (position = commandRead; position != end; position++) {
+
+		command = commands + (position & (AUDIO_COMMANDS - 1));
+
+		switch (command->type) {
+
+			case AC_PLAY:
+
+				startVoice(command);
+
+				break;
+
+			case AC_STOP:
+
+				for (count = 0; count < MAX_VOICES; count++) {
+
+					if (voices[count].sound == command->value) voices[count].sound = -1;
+
+				}
+
+				break;
+
+			case AC_SOUND_VOLUME:
+
+				mixVolume = command->value;
+
+				break;
+
+			case AC_VOICES:
+
+				// Stop any sounds playing on voices which are no longer used
+				for (count = command->value; count < activeVoices; count++)
+					voices[count].sound = -1;
+
+				activeVoices = command->value;
+
+				break;
+
+			case AC_PAUSE_MUSIC:
+
+				musicPaused = command->value;
+
+				break;
+
+		}
+
+	}
+
+	return end;
+
+}
+
+
+/**
+ * Add the sound effects being played to the mix buffer.
+ *
+ * @param frames Number of sample frames to mix
+ */
+void mixVoices (int frames) {
+
+	Voice *voice;
+	short *data;
+	int count, sample, length, gain, left, right;
+	int channels;
+
+	channels = audioSpec.channels;
+
+	memset(mixBuffer, 0, frames * channels * sizeof(int));
+
+	for (count = 0; count < activeVoices; count++) {
+
+		voice = voices + count;
+
+		if (voice->sound < 0) continue;
+
+		// Gains are out of 256
+		gain = (mixVolume * voice->volume * 256) / (MAX_VOLUME * MAX_VOLUME);
+		left = voice->pan > 0? (gain * (MAX_PAN - voice->pan)) / MAX_PAN: gain;
+		right = voice->pan < 0? (gain * (MAX_PAN + voice->pan)) / MAX_PAN: gain;
+
+		data = voice->data + voice->position;
+		length = voice->length - voice->position;
+
+		if (length > frames) {
+
+			// Play as much of the clip as possible
+			length = frames;
+			voice->position += frames;
+
+		} else {
+
+			// Play the remainder of the clip
+			voice->sound = -1;
+
+		}
+
+		// Voices too quiet to be heard keep their place, but are not mixed
+		if ((left < SOUND_CULL_GAIN) && (right < SOUND_CULL_GAIN)) continue;
+
+		if (channels == 1) {
+
+			gain = (left + right) >> 1;
+
+			for (sample = 0; sample < length; sample++)
+				mixBuffer[sample] += data[sample] * gain;
+
+		} else {
+
+			for (sample = 0; sample < length; sample++) {
+
+				mixBuffer[sample * channels] += data[sample] * left;
+				mixBuffer[(sample * channels) + 1] += data[sample] * right;
+
+			}
+
+		}
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Add the mix buffer to the output stream, clipping the result.
+ *
+ * @param stream Output stream, already containing music
+ * @param samples Number of samples
+ */
+void clipMix (unsigned char *stream, int samples) {
+
+	short *output16;
+	int count, sample;
+
+	if (audioSpec.format == AUDIO_U8) {
+
+		for (count = 0; count < samples; count++) {
+
+			sample = stream[count] - 128 + (mixBuffer[count] >> 16);
+			sample = sample > 127? 127: (sample < -128? -128: sample);
+			stream[count] = sample + 128;
+
+		}
+
+	} else if (audioSpec.format == AUDIO_S8) {
+
+		for (count = 0; count < samples; count++) {
+
+			sample = ((signed char *)stream)[count] + (mixBuffer[count] >> 16);
+			sample = sample > 127? 127: (sample < -128? -128: sample);
+			stream[count] = sample;
+
+		}
+
+	} else {
+
+		// Simple enough for the compiler to vectorise
+		output16 = (short *)stream;
+
+		for (count = 0; count < samples; count++) {
+
+			sample = output16[count] + (mixBuffer[count] >> 8);
+			sample = sample > 32767? 32767: (sample < -32768? -32768: sample);
+			output16[count] = sample;
+
+		}
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Callback used to provide data to the audio subsystem.
+ *
+ * @param userdata N/A
+ * @param stream Output stream
+ * @param len Length of data to be placed in the output stream
+ */
+void audioCallback (void * userdata, unsigned char * stream, int len) {
+
+	(void)userdata;
+
+	unsigned int start, period, done, playing;
+	int length, frameSize, frames, count;
+
+	TRACE_THREAD_SCOPE(TT_AUDIO, "audioCallback");
+
+	start = getMicroTicks();
+
+	// Apply the game's audio operations
+	done = runAudioCommands();
+
+	// Count callbacks which came too late to keep the output buffer filled
+	period = ((audioSpec.samples * 15625) / audioSpec.freq) << 6;
+
+	if (callbackStart && (start - callbackStart > period + (period >> 1)))
+		lateCallbacks++;
+
+	callbackStart = start;
+
+	if (!musicPaused && musicThread) {
+
+		// Copy the next portion of music into the audio stream
+		readMusic(stream, len);
+
+	} else if (!musicPaused && (musicFile || musicCache.file)) {
+
+		// Without a music thread, decode the music here
+		length = decodeMusic(stream, len);
+		memset(stream + length, audioSpec.silence, len - length);
+
+	} else {
+
+		memset(stream, audioSpec.silence, len);
+
+	}
+
+	if (mixBuffer) {
+
+		frameSize = audioSpec.channels *
+			(((audioSpec.format == AUDIO_U8) || (audioSpec.format == AUDIO_S8))? 1: 2);
+
+		// Add all the sound effects in one pass per portion of the stream
+		while (len >= frameSize) {
+
+			frames = len / frameSize;
+			if (frames > mixLength) frames = mixLength;
+
+			mixVoices(frames);
+			clipMix(stream, frames * audioSpec.channels);
+
+			stream += frames * frameSize;
+			len -= frames * frameSize;
+
+		}
+
+	}
+
+	// Let the game see which sound effects are still playing
+	playing = 0;
+
+	for (count = 0; count < activeVoices; count++) {
+
+		if (voices[count].sound >= 0) playing |= 1u << voices[count].sound;
+
+	}
+
+	playingSounds = playing;
+
+	MEMORY_BARRIER();
+
+	commandRead = done;
+
+	callbackTimes[callback] = getMicroTicks() - start;
+	callback = (callback + 1) % AUDIO_STATS_CALLBACKS;
+
+	return;
+
+}
+
+
+/**
+ * Stop all voices and clear the operation queue, before the audio callback
+ * starts. The audio callback's copies of the settings are brought up to date.
+ */
+void resetVoices () {
+
+	int count;
+
+	for (count = 0; count < MAX_VOICES; count++) voices[count].sound = -1;
+
+	commandRead = commandWrite = 0;
+	memset(soundPosted, 0, sizeof(soundPosted));
+	playingSounds = 0;
+
+	activeVoices = nVoices;
+	mixVolume = soundVolume;
+	musicPaused = false;
+
+	return;
+
+}
+
+
+/**
+ * Open the audio device, and start decoding music and mixing sound effects.
+ */
+void startAudio () {
+
+	SDL_AudioSpec asDesired;
+
+	// Set up SDL audio
 
+	asDesired.freq = soundRate;
+	asDesired.format = AUDIO_S16SYS;
+	asDesired.channels = 2;
+	asDesired.samples = soundSamples;
+	asDesired.callback = audioCallback;
+	asDesired.userdata = NULL;
 
-/**
- * Callback used to provide data to the audio subsystem.
- *
- * @param userdata N/A
- * @param stream Output stream
- * @param len Length of data to be placed in the output stream
- */
-void audioCallback (void * userdata, unsigned char * stream, int len) {
+	if (SDL_OpenAudio(&asDesired, &audioSpec) < 0) {
 
-	(void)userdata;
+		logError("Unable to open audio", SDL_GetError());
 
-	int count;
+		memset(&audioSpec, 0, sizeof(SDL_AudioSpec));
+
+		return;
+
+	}
+
+	audioOpen = true;
 
-	if (!musicPaused) {
+	// Start decoding music ahead of the audio callback
 
-		// Read the next portion of music into the audio stream
+	musicRingSize = 1;
+	while (musicRingSize < audioSpec.size * MUSIC_BUFFERS) musicRingSize <<= 1;
 
-		if (musicFile) ModPlug_Read(musicFile, stream, len);
+	musicChunk = musicRingSize / MUSIC_CHUNKS;
+	musicRing = new unsigned char[musicRingSize];
+	musicRead = musicWrite = 0;
+	musicFlushes = musicFlushesDone = 0;
+
+	musicMutex = SDL_CreateMutex();
+	musicSem = SDL_CreateSemaphore(0);
+	musicRunning = true;
+	musicThread = SDL_CreateThread(musicLoop, NULL);
+
+	if (!musicThread) {
+
+		logError("Unable to start music thread", SDL_GetError());
+		musicRunning = false;
 
 	}
 
-	if (!sounds) return;
 
-	for (count = 0; count < 32; count++) {
+	// Set up sound effect mixing
 
-		if (sounds[count].data && (sounds[count].position >= 0)) {
+	resetVoices();
 
-			// Add the next portion of the sound clip to the audio stream
+	mixLength = audioSpec.samples;
+	mixBuffer = new int[mixLength * audioSpec.channels];
 
-			if (len < sounds[count].length - sounds[count].position) {
 
-				// Play as much of the clip as possible
+	// Reset statistics
 
-				SDL_MixAudio(stream,
-					sounds[count].data + sounds[count].position, len,
-					soundVolume * SDL_MIX_MAXVOLUME / MAX_VOLUME);
+	memset(callbackTimes, 0, sizeof(callbackTimes));
+	callbackStart = 0;
+	lateCallbacks = 0;
+	underruns = 0;
 
-				sounds[count].position += len;
+	// Start audio for sfx to work
 
-			} else {
+	SDL_PauseAudio(0);
 
-				// Play the remainder of the clip
+	return;
 
-				SDL_MixAudio(stream,
-					sounds[count].data + sounds[count].position,
-					sounds[count].length - sounds[count].position,
-					soundVolume * SDL_MIX_MAXVOLUME / MAX_VOLUME);
+}
 
-				sounds[count].position = -1;
 
-			}
+/**
+ * Close the audio device, and stop decoding music.
+ */
+void stopAudio () {
 
-		}
+	if (!audioOpen) return;
+
+	SDL_CloseAudio();
+
+	audioOpen = false;
+
+	if (musicThread) {
+
+		musicRunning = false;
+		SDL_SemPost(musicSem);
+		SDL_WaitThread(musicThread, NULL);
+		musicThread = NULL;
+
+	}
+
+	if (musicSem) {
+
+		SDL_DestroySemaphore(musicSem);
+		musicSem = NULL;
+
+	}
+
+	if (musicMutex) {
+
+		SDL_DestroyMutex(musicMutex);
+		musicMutex = NULL;
+
+	}
+
+	if (musicRing) {
+
+		delete[] musicRing;
+		musicRing = NULL;
+
+	}
+
+	if (mixBuffer) {
+
+		delete[] mixBuffer;
+		mixBuffer = NULL;
 
 	}
 
@@ -126,30 +1210,14 @@ void audioCallback (void * userdata, unsigned char * stream, int len) {
  */
 void openAudio () {
 
-	SDL_AudioSpec asDesired;
 	musicFile = NULL;
 
-	// Set up SDL audio
-
-	asDesired.freq = SOUND_FREQ;
-	asDesired.format = AUDIO_S16;
-	asDesired.channels = 2;
-	asDesired.samples = SOUND_SAMPLES;
-	asDesired.callback = audioCallback;
-	asDesired.userdata = NULL;
-
-	if (SDL_OpenAudio(&asDesired, &audioSpec) < 0)
-		logError("Unable to open audio", SDL_GetError());
-
+	startAudio();
 
 	// Load sounds
 
 	if (loadSounds("SOUNDS.000") != E_NONE) sounds = NULL;
 
-	// Start audio for sfx to work
-
-	SDL_PauseAudio(0);
-
 	return;
 
 }
@@ -164,7 +1232,9 @@ void closeAudio () {
 
 	stopMusic();
 
-	SDL_CloseAudio();
+	stopAudio();
+
+	freeSounds();
 
 	if (rawSounds) {
 
@@ -176,13 +1246,94 @@ void closeAudio () {
 		}
 
 		delete[] rawSounds;
+		rawSounds = NULL;
 
 	}
 
 	if (sounds) {
 
-		freeSounds();
 		delete[] sounds;
+		sounds = NULL;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Gets the output sample rate
+ *
+ * @return sample rate (in Hz)
+ */
+int getSoundRate () {
+
+	return soundRate;
+
+}
+
+
+/**
+ * Gets the output buffer size, which determines latency
+ *
+ * @return buffer size (in samples)
+ */
+int getSoundSamples () {
+
+	return soundSamples;
+
+}
+
+
+/**
+ * Sets the output sample rate and buffer size. If audio is open, it is
+ * reopened, and the current music is restarted.
+ *
+ * @param rate new sample rate (MIN_SOUND_RATE-MAX_SOUND_RATE Hz)
+ * @param samples new buffer size (a power of 2, MIN_SOUND_SAMPLES-MAX_SOUND_SAMPLES)
+ */
+void setSoundFormat (int rate, int samples) {
+
+	char *music;
+	int count;
+
+	if ((rate >= MIN_SOUND_RATE) && (rate <= MAX_SOUND_RATE)) soundRate = rate;
+
+	if ((samples >= MIN_SOUND_SAMPLES) && (samples <= MAX_SOUND_SAMPLES) &&
+		!(samples & (samples - 1)))
+		soundSamples = samples;
+
+	if (!audioOpen || ((audioSpec.freq == soundRate) &&
+		(audioSpec.samples == soundSamples)))
+		return;
+
+	music = currentMusic? createString(currentMusic): NULL;
+	stopMusic();
+
+	stopAudio();
+
+	// Sound effects need converting to the new sample rate
+	freeSounds();
+
+	startAudio();
+
+	if (sounds) {
+
+		for (count = 0; count < 32; count++) {
+
+			if (sounds[count].raw >= 0)
+				resampleSound(count, rawSounds[sounds[count].raw].name, sounds[count].rate);
+
+		}
+
+	}
+
+	if (music) {
+
+		playMusic(music);
+		setMusicTempo(musicTempo);
+		delete[] music;
 
 	}
 
@@ -191,6 +1342,230 @@ void closeAudio () {
 }
 
 
+/**
+ * Gets the longest recent audio callback
+ *
+ * @return time (in microseconds)
+ */
+int getAudioCallbackTime () {
+
+	unsigned int longest;
+	int count;
+
+	longest = 0;
+
+	for (count = 0; count < AUDIO_STATS_CALLBACKS; count++) {
+
+		if (callbackTimes[count] > longest) longest = callbackTimes[count];
+
+	}
+
+	return longest;
+
+}
+
+
+/**
+ * Gets the number of audio callbacks which came late, since audio was opened
+ *
+ * @return number of late callbacks
+ */
+int getLateAudioCallbacks () {
+
+	return lateCallbacks;
+
+}
+
+
+/**
+ * Gets the number of times music was not decoded in time, since audio was
+ * opened
+ *
+ * @return number of underruns
+ */
+int getAudioUnderruns () {
+
+	return underruns;
+
+}
+
+
+/**
+ * Load music data into libpsmplug, to be decoded for the current output format.
+ *
+ * @param psmData The contents of the music file
+ * @param size The size of the music file
+ * @param resamplingMode The libpsmplug resampling mode
+ * @param flags The libpsmplug flags
+ *
+ * @return The music (NULL if the data could not be loaded)
+ */
+ModPlugFile* loadMusic (unsigned char *psmData, int size, int resamplingMode, int flags) {
+
+	ModPlugFile *music;
+	ModPlug_Settings settings;
+
+	// Set up libpsmplug
+
+	settings.mFlags = flags;
+	settings.mChannels = audioSpec.channels;
+
+	if ((audioSpec.format == AUDIO_U8) || (audioSpec.format == AUDIO_S8))
+		settings.mBits = 8;
+	else settings.mBits = 16;
+
+	settings.mFrequency = audioSpec.freq;
+	settings.mResamplingMode = resamplingMode;
+	settings.mReverbDepth = 25;
+	settings.mReverbDelay = 40;
+	settings.mBassAmount = 50;
+	settings.mBassRange = 10;
+	settings.mSurroundDepth = 50;
+	settings.mSurroundDelay = 40;
+
+	// unlimited looping
+	settings.mLoopCount = -1;
+
+	/* Load the file into libmodplug. The settings are shared with the music
+	   being decoded, so the music thread waits, but music already decoded
+	   carries on playing. */
+	lockMusic();
+	ModPlug_SetSettings(&settings);
+	music = ModPlug_Load(psmData, size);
+	unlockMusic();
+
+	return music;
+
+}
+
+
+/**
+ * Start rendering music to a file, until it starts to repeat. The music thread
+ * renders it a piece at a time, while the music is decoded as usual.
+ *
+ * @param psmData The contents of the music file
+ * @param size The size of the music file
+ * @param cacheName Name of the pre-rendered music file
+ * @param key Values identifying the music data and the settings used
+ *
+ * @return The music being rendered (NULL if it cannot be rendered)
+ */
+MusicRender* startMusicRender (unsigned char *psmData, int size, const char *cacheName, int *key) {
+
+	MusicRender *render;
+	ModPlugFile *music;
+	File *file;
+	int count;
+
+	try {
+
+		file = new File(cacheName, true);
+
+	} catch (int e) {
+
+		logError("Could not write music cache", cacheName);
+
+		return NULL;
+
+	}
+
+	// Render from a copy of the music, so that the music being played is left
+	// where it is
+	music = loadMusic(psmData, size, MUSIC_RESAMPLEMODE, MUSIC_FLAGS);
+
+	if (!music) {
+
+		delete file;
+
+		return NULL;
+
+	}
+
+	log("Rendering music", cacheName);
+
+	render = new MusicRender;
+	render->music = music;
+	render->file = file;
+	render->name = createString(cacheName);
+
+	for (count = 0; count < MUSIC_CACHE_KEYS; count++) render->key[count] = key[count];
+
+	// Leave room for the header, which is completed afterwards
+	render->cache.length = 0;
+	render->cache.loop = 0;
+
+	for (count = 0; count < MUSIC_ORDERS; count++) render->cache.orders[count] = -1;
+
+	storeMusicCacheHeader(file, key, &(render->cache));
+
+	render->frameSize = audioSpec.channels * 2;
+	render->maxLength = MUSIC_CACHE_SECONDS * audioSpec.freq * render->frameSize;
+	render->buffer = new unsigned char[MUSIC_RENDER_FRAMES * render->frameSize];
+
+	render->entries = NULL;
+	render->nEntries = render->maxEntries = 0;
+	render->lastOrder = render->lastRow = -1;
+	render->loops = ModPlug_GetLoops(music);
+
+	// Render at full volume, and apply the music volume during playback
+	ModPlug_SetMasterVolume(music, MAX_VOLUME * 2.56);
+
+	return render;
+
+}
+
+
+/**
+ * Open the pre-rendered version of the music. If there is none, or it was
+ * rendered from different music data or with different settings, rendering is
+ * started instead, to be carried out by the music thread.
+ *
+ * @param cache Pre-rendered music to fill in
+ * @param fileName Name of the music file
+ * @param psmData The contents of the music file
+ * @param size The size of the music file
+ *
+ * @return The music to be rendered (NULL if the pre-rendered music was opened,
+ * or cannot be rendered)
+ */
+MusicRender* openMusicCache (MusicCache *cache, const char *fileName, unsigned char *psmData, int size) {
+
+	MusicRender *render;
+	char *cacheName;
+	unsigned int hash;
+	int key[MUSIC_CACHE_KEYS];
+	int count;
+
+	// The rendered music is kept alongside the configuration file
+	cacheName = createString(fileName, ".PCM");
+
+	// FNV-1a hash of the music data
+	hash = 2166136261u;
+
+	for (count = 0; count < size; count++)
+		hash = (hash ^ psmData[count]) * 16777619u;
+
+	key[0] = size;
+	key[1] = hash;
+	key[2] = audioSpec.freq;
+	key[3] = audioSpec.format;
+	key[4] = audioSpec.channels;
+	key[5] = MUSIC_FLAGS;
+	key[6] = MUSIC_RESAMPLEMODE;
+	key[7] = MUSIC_CACHE_SECONDS;
+
+	render = NULL;
+
+	if (!loadMusicCache(cache, cacheName, key))
+		render = startMusicRender(psmData, size, cacheName, key);
+
+	delete[] cacheName;
+
+	return render;
+
+}
+
+
 /**
  * Play music from the specified file.
  *
@@ -202,15 +1577,19 @@ void playMusic (const char * fileName, bool restart) {
 	File *file;
 	unsigned char *psmData;
 	int size;
-	bool loadOk = false;
-	ModPlug_Settings settings;
+	ModPlugFile *newMusic;
+	MusicCache newCache;
+	MusicRender *newRender;
+
+	TRACE_SCOPE("playMusic");
 
 	/* Only stop any existing music playing, if a different file
 	   should be played or a restart has been requested. */
 	if ((currentMusic && (strcmp(fileName, currentMusic) == 0)) && !restart)
 		return;
 
-	stopMusic();
+	// Without audio output, there is no need for music
+	if (!audioSpec.freq) return;
 
 	// Load the music file
 
@@ -220,6 +1599,8 @@ void playMusic (const char * fileName, bool restart) {
 
 	} catch (int e) {
 
+		stopMusic();
+
 		return;
 
 	}
@@ -229,58 +1610,45 @@ void playMusic (const char * fileName, bool restart) {
 	if (currentMusic) delete[] currentMusic;
 	currentMusic = createString(fileName);
 
-	// Find the size of the file
-	size = file->getSize();
-
-	// Read the entire file into memory
-	file->seek(0, true);
-	psmData = file->loadBlock(size);
-
-	delete file;
-
-	// Set up libpsmplug
-
-	settings.mFlags = MUSIC_FLAGS;
-	settings.mChannels = audioSpec.channels;
-
-	if ((audioSpec.format == AUDIO_U8) || (audioSpec.format == AUDIO_S8))
-		settings.mBits = 8;
-	else settings.mBits = 16;
-
-	settings.mFrequency = audioSpec.freq;
-	settings.mResamplingMode = MUSIC_RESAMPLEMODE;
-	settings.mReverbDepth = 25;
-	settings.mReverbDelay = 40;
-	settings.mBassAmount = 50;
-	settings.mBassRange = 10;
-	settings.mSurroundDepth = 50;
-	settings.mSurroundDelay = 40;
+	// Find the size of the file
+	size = file->getSize();
 
-	// unlimited looping
-	settings.mLoopCount = -1;
+	// Read the entire file into memory
+	file->seek(0, true);
+	psmData = file->loadBlock(size);
 
-	ModPlug_SetSettings(&settings);
+	delete file;
 
-	// Load the file into libmodplug
-	musicFile = ModPlug_Load(psmData, size);
-	loadOk = (musicFile != NULL);
+	newMusic = loadMusic(psmData, size, MUSIC_RESAMPLEMODE, MUSIC_FLAGS);
 
-	delete[] psmData;
+	if (!newMusic) {
 
-	if (!loadOk) {
+		delete[] psmData;
 
 		logError("Could not play music file", fileName);
 
+		stopMusic();
+
 		return;
 
 	}
 
+	newCache.file = NULL;
+	newRender = NULL;
+
+	/* Music is rendered in advance by the music thread, as rendering uses the
+	   decoder's shared buffers */
+	if (musicCacheEnabled && musicThread && (audioSpec.format == AUDIO_S16SYS))
+		newRender = openMusicCache(&newCache, fileName, psmData, size);
+
+	delete[] psmData;
+
 	// Re-apply volume setting
-	setMusicVolume(musicVolume);
+	ModPlug_SetMasterVolume(newMusic, musicVolume * 2.56);
 
-	// Start the audio playing
-	SDL_PauseAudio(0);
-	musicPaused = false;
+	// Start the new music playing, until any music being rendered is ready
+	swapMusic(newMusic, newCache.file? &newCache: NULL, newRender);
+	pauseMusic(false);
 
 	return;
 
@@ -293,7 +1661,15 @@ void playMusic (const char * fileName, bool restart) {
  * @param pause set to true to pause
  */
 void pauseMusic (bool pause) {
-	musicPaused = pause;
+
+	AudioCommand command;
+
+	command.type = AC_PAUSE_MUSIC;
+	command.value = pause;
+	postAudioCommand(&command);
+
+	return;
+
 }
 
 
@@ -302,10 +1678,6 @@ void pauseMusic (bool pause) {
  */
 void stopMusic () {
 
-	// Stop the music playing
-
-	SDL_PauseAudio(~0);
-
 	// Cleanup
 
 	if (currentMusic) {
@@ -315,14 +1687,7 @@ void stopMusic () {
 
 	}
 
-	if (musicFile) {
-
-		ModPlug_Unload(musicFile);
-		musicFile = NULL;
-
-	}
-
-	SDL_PauseAudio(0);
+	swapMusic(NULL, NULL, NULL);
 
 	return;
 
@@ -354,7 +1719,9 @@ void setMusicVolume (int volume) {
 
 	// do not access music player settings when not playing
 
+	lockMusic();
 	if (musicFile) ModPlug_SetMasterVolume(musicFile, musicVolume * 2.56);
+	unlockMusic();
 
 }
 
@@ -385,8 +1752,13 @@ void setMusicTempo (int tempo) {
 
 	// do not access music player settings when not playing
 
+	lockMusic();
+
 	if (musicFile) {
 
+		// Pre-rendered music can only be played at its normal tempo
+		if (musicCache.file) switchMusicCache(musicTempo == MUSIC_FAST);
+
 		if (musicTempo == MUSIC_FAST)
 			ModPlug_SetMusicTempoFactor(musicFile, 80);
 		else
@@ -394,6 +1766,35 @@ void setMusicTempo (int tempo) {
 
 	}
 
+	unlockMusic();
+
+}
+
+
+/**
+ * Determines whether music is rendered in advance
+ *
+ * @return true if music is rendered in advance
+ */
+bool getMusicCache () {
+
+	return musicCacheEnabled;
+
+}
+
+
+/**
+ * Sets whether music is rendered in advance, to a file from which it is then
+ * played. This takes effect from the next music to be played.
+ *
+ * @param cache true to render music in advance
+ */
+void setMusicCache (bool cache) {
+
+	musicCacheEnabled = cache;
+
+	return;
+
 }
 
 
@@ -422,6 +1823,7 @@ int loadSounds (const char *fileName) {
 	for (count = 0; count < 32; count++) {
 
 		sounds[count].data = NULL;
+		sounds[count].raw = -1;
 
 	}
 
@@ -453,6 +1855,8 @@ int loadSounds (const char *fileName) {
 		file->seek(offset, true);
 		rawSounds[count].data = file->loadBlock(rawSounds[count].length);
 
+		rawSounds[count].resampled = NULL;
+
 	}
 
 	delete file;
@@ -465,40 +1869,133 @@ int loadSounds (const char *fileName) {
 
 
 /**
- * Resample sound clip data.
+ * Stop any voices playing a sound effect.
+ *
+ * @param index Index of the sound effect
+ */
+void stopVoices (int index) {
+
+	AudioCommand command;
+
+	command.type = AC_STOP;
+	command.value = index;
+	postAudioCommand(&command);
+
+	return;
+
+}
+
+
+/**
+ * Convert raw sound clip data to signed 16-bit samples at the output rate,
+ * using linear interpolation.
+ *
+ * @param raw The raw sound clip
+ * @param rate Sample rate of the raw sound clip
+ *
+ * @return The converted sound clip
+ */
+ResampledSound* convertSound (RawSound *raw, int rate) {
+
+	ResampledSound *resampled;
+	unsigned int step, fraction;
+	int sample, position, current, next;
+
+	resampled = new ResampledSound;
+	resampled->rate = rate;
+	resampled->outputRate = audioSpec.freq;
+
+	// Without an output rate, there is nothing to convert to
+	if (audioSpec.freq) resampled->length = ((unsigned int)raw->length * audioSpec.freq) / rate;
+	else resampled->length = 0;
+
+	resampled->data = new short[resampled->length];
+
+	if (!resampled->length) return resampled;
+
+	// Distance between output samples, in 16.16 fixed point
+	step = ((unsigned int)rate << 16) / audioSpec.freq;
+
+	position = 0;
+	fraction = 0;
+
+	for (sample = 0; sample < resampled->length; sample++) {
+
+		current = (signed char)(raw->data[position]);
+		next = (position + 1 < raw->length)? (signed char)(raw->data[position + 1]): 0;
+
+		resampled->data[sample] = (current << 8) +
+			(((next - current) * (int)fraction) >> 8);
+
+		fraction += step;
+		position += fraction >> 16;
+		fraction &= 0xFFFF;
+
+	}
+
+	return resampled;
+
+}
+
+
+/**
+ * Resample sound clip data. Each raw sound clip is only converted once for
+ * each sample rate.
+ *
+ * @param index Index of the sound effect to set
+ * @param name Name of the raw sound clip
+ * @param rate Sample rate of the raw sound clip
  */
 void resampleSound (int index, const char* name, int rate) {
 
-	int count, rsFactor, sample;
+	ResampledSound *resampled;
+	int count;
+
+	if (!sounds) return;
+
+	if (sounds[index].data) {
 
-    if (sounds[index].data) {
+		stopVoices(index);
 
-		delete[] sounds[index].data;
 		sounds[index].data = NULL;
 
 	}
 
+	sounds[index].raw = -1;
+
+	if (rate <= 0) return;
+
 	// Search for matching sound
 
 	for (count = 0; count < nRawSounds; count++) {
 
 		if (!strcmp(name, rawSounds[count].name)) {
 
-			// Calculate the resampling factor
-			if ((audioSpec.format == AUDIO_U8) || (audioSpec.format == AUDIO_S8))
-				rsFactor = (F2 * audioSpec.freq) / rate;
-			else rsFactor = (F4 * audioSpec.freq) / rate;
+			// Remember the sound clip, so that it can be converted if the
+			// audio device is reopened
+			sounds[index].raw = count;
+			sounds[index].rate = rate;
+
+			// Sound clips cannot be converted without an output rate
+			if (!audioOpen || !audioSpec.freq) return;
+
+			// Use the cached conversion, if there is one
+			resampled = rawSounds[count].resampled;
+
+			while (resampled && ((resampled->rate != rate) ||
+				(resampled->outputRate != audioSpec.freq)))
+				resampled = resampled->next;
 
-			sounds[index].length = MUL(rawSounds[count].length, rsFactor);
+			if (!resampled) {
 
-			// Allocate the buffer for the resampled clip
-			sounds[index].data = new unsigned char[sounds[index].length];
+				resampled = convertSound(rawSounds + count, rate);
+				resampled->next = rawSounds[count].resampled;
+				rawSounds[count].resampled = resampled;
 
-			// Resample the clip
-			for (sample = 0; sample < sounds[index].length; sample++)
-				sounds[index].data[sample] = rawSounds[count].data[DIV(sample, rsFactor)];
+			}
 
-			sounds[index].position = -1;
+			sounds[index].data = resampled->data;
+			sounds[index].length = resampled->length;
 
 			return;
 
@@ -532,13 +2029,28 @@ void resampleSounds () {
  */
 void freeSounds () {
 
+	ResampledSound *resampled;
 	int count;
 
 	if (sounds) {
 
-		for (count = 0; count < 32; count++) {
+		for (count = 0; count < 32; count++) sounds[count].data = NULL;
+
+	}
+
+	if (rawSounds) {
+
+		for (count = 0; count < nRawSounds; count++) {
 
-			if (sounds[count].data) delete[] sounds[count].data;
+			while (rawSounds[count].resampled) {
+
+				resampled = rawSounds[count].resampled;
+				rawSounds[count].resampled = resampled->next;
+
+				delete[] resampled->data;
+				delete resampled;
+
+			}
 
 		}
 
@@ -550,13 +2062,92 @@ void freeSounds () {
 
 
 /**
- * Set the sound clip to be played.
+ * Play a sound clip. If all voices are in use, the voice with the lowest
+ * priority is stolen, or the oldest of those with equally low priority.
  *
  * @param index Number of the sound to play plus one (0 to play no sound)
+ * @param volume Volume (0-MAX_VOLUME)
+ * @param pan Position from left (-MAX_PAN) to right (MAX_PAN)
+ * @param priority Priority of the sound
+ */
+void playSound (char index, int volume, int pan, int priority) {
+
+	AudioCommand command;
+
+	if (!sounds || (index <= 0) || (index > 32) || !sounds[index - 1].data)
+		return;
+
+	command.type = AC_PLAY;
+	command.value = index - 1;
+	command.data = sounds[index - 1].data;
+	command.length = sounds[index - 1].length;
+	command.volume = volume;
+	command.pan = pan;
+	command.priority = priority;
+
+	if (postAudioCommand(&command)) soundPosted[index - 1] = commandWrite;
+
+	return;
+
+}
+
+
+/**
+ * Play a sound clip made at the given point in the level. The volume and pan
+ * depend on where the point is relative to the listener, and clips which would
+ * be too quiet to hear are not played at all.
+ *
+ * @param index Number of the sound to play plus one
+ * @param x X-coordinate of the source of the sound
+ * @param y Y-coordinate of the source of the sound
+ * @param priority Voices with lower priority are stolen first
+ */
+void playSoundAt (char index, fixed x, fixed y, int priority) {
+
+	int dx, dy, distance, volume, pan;
+
+	dx = FTOI(x - listenerX);
+	dy = FTOI(y - listenerY);
+
+	// Approximate the distance without a square root
+	if (dx < 0) distance = -dx;
+	else distance = dx;
+
+	if (dy < 0) dy = -dy;
+
+	if (dy > distance) distance = dy + (distance >> 1);
+	else distance += dy >> 1;
+
+	if (distance >= SOUND_FAR) return;
+
+	if (distance <= SOUND_NEAR) volume = MAX_VOLUME;
+	else volume = (MAX_VOLUME * (SOUND_FAR - distance)) / (SOUND_FAR - SOUND_NEAR);
+
+	if ((soundVolume * volume * 256) / (MAX_VOLUME * MAX_VOLUME) < SOUND_CULL_GAIN)
+		return;
+
+	pan = (dx * MAX_PAN) / SOUND_PAN_RANGE;
+	if (pan < -MAX_PAN) pan = -MAX_PAN;
+	if (pan > MAX_PAN) pan = MAX_PAN;
+
+	playSound(index, volume, pan, priority);
+
+	return;
+
+}
+
+
+/**
+ * Set the point from which sound clips made in the level are heard, usually the
+ * centre of the view.
+ *
+ * @param x X-coordinate of the listener
+ * @param y Y-coordinate of the listener
  */
-void playSound (char index) {
+void setSoundListener (fixed x, fixed y) {
 
-	if (sounds && (index > 0) && (index <= 32)) sounds[index - 1].position = 0;
+	listenerX = x;
+	listenerY = y;
 
 	return;
 
@@ -575,7 +2166,12 @@ bool isSoundPlaying (char index) {
 	if (!sounds || (index <= 0) || (index > 32))
 		return false;
 
-	return (sounds[index - 1].position > 0);
+	MEMORY_BARRIER();
+
+	// Count the sound as playing if the audio callback has yet to start it
+	if ((int)(commandRead - soundPosted[index - 1]) < 0) return true;
+
+	return (playingSounds >> (index - 1)) & 1;
 
 }
 
@@ -599,8 +2195,223 @@ int getSoundVolume () {
  */
 void setSoundVolume (int volume) {
 
+	AudioCommand command;
+
 	soundVolume = volume;
 	if (volume < 1) soundVolume = 0;
 	if (volume > MAX_VOLUME) soundVolume = MAX_VOLUME;
 
+	command.type = AC_SOUND_VOLUME;
+	command.value = soundVolume;
+	postAudioCommand(&command);
+
+}
+
+
+/**
+ * Gets the number of sound effects which can be played at once
+ *
+ * @return number of voices (1-MAX_VOICES)
+ */
+int getSoundVoices () {
+
+	return nVoices;
+
+}
+
+
+/**
+ * Sets the number of sound effects which can be played at once
+ *
+ * @param number new number of voices (1-MAX_VOICES)
+ */
+void setSoundVoices (int number) {
+
+	AudioCommand command;
+
+	if (number < 1) number = 1;
+	if (number > MAX_VOICES) number = MAX_VOICES;
+
+	nVoices = number;
+
+	command.type = AC_VOICES;
+	command.value = number;
+	postAudioCommand(&command);
+
+}
+
+
+/**
+ * Measure how quickly music and sound effects can be mixed with various
+ * settings. The music and a regular pattern of sound effects are rendered into
+ * memory by the audio callback, without opening the audio device.
+ *
+ * @param fileName Name of a file containing music data
+ * @param seconds Length of music to render with each configuration
+ * @param csvFile File to which results are written (NULL for none)
+ *
+ * @return Error code
+ */
+int benchmarkAudio (const char *fileName, int seconds, const char *csvFile) {
+
+	const char* names[AUDIO_BENCHMARK_CONFIGS] = {"nearest", "linear", "spline",
+		"fir", "fir+reverb", "fir+surround", "default", "default/4", "default/32"};
+	const int modes[AUDIO_BENCHMARK_CONFIGS] = {MODPLUG_RESAMPLE_NEAREST,
+		MODPLUG_RESAMPLE_LINEAR, MODPLUG_RESAMPLE_SPLINE, MODPLUG_RESAMPLE_FIR,
+		MODPLUG_RESAMPLE_FIR, MODPLUG_RESAMPLE_FIR, MUSIC_RESAMPLEMODE,
+		MUSIC_RESAMPLEMODE, MUSIC_RESAMPLEMODE};
+	const int flags[AUDIO_BENCHMARK_CONFIGS] = {MODPLUG_ENABLE_SIMD,
+		MODPLUG_ENABLE_SIMD, MODPLUG_ENABLE_SIMD, MODPLUG_ENABLE_SIMD,
+		MODPLUG_ENABLE_REVERB | MODPLUG_ENABLE_SIMD,
+		MODPLUG_ENABLE_SURROUND | MODPLUG_ENABLE_SIMD, MUSIC_FLAGS, MUSIC_FLAGS,
+		MUSIC_FLAGS};
+	const int voiceCounts[AUDIO_BENCHMARK_CONFIGS] = {SOUND_VOICES, SOUND_VOICES,
+		SOUND_VOICES, SOUND_VOICES, SOUND_VOICES, SOUND_VOICES, SOUND_VOICES, 4,
+		MAX_VOICES};
+	File *file;
+	FILE *csv;
+	unsigned char *psmData, *stream;
+	unsigned int start, time;
+	int size, config, frames, total, trigger, triggerFrames, mismatches;
+	float rate;
+
+	if (seconds <= 0) seconds = AUDIO_BENCHMARK_SECONDS;
+
+	try {
+
+		file = new File(fileName, false);
+
+	} catch (int e) {
+
+		return e;
+
+	}
+
+	size = file->getSize();
+	file->seek(0, true);
+	psmData = file->loadBlock(size);
+
+	delete file;
+
+	// Set up the output format, without an audio device
+	memset(&audioSpec, 0, sizeof(SDL_AudioSpec));
+	audioSpec.freq = soundRate;
+	audioSpec.format = AUDIO_S16SYS;
+	audioSpec.channels = 2;
+	audioSpec.samples = soundSamples;
+	audioSpec.size = soundSamples * 4;
+
+	// Sound effects are converted as if the audio device were open
+	audioOpen = true;
+
+	if (loadSounds("SOUNDS.000") != E_NONE) {
+
+		log("Could not load sound effects, so only music will be mixed");
+		sounds = NULL;
+
+	}
+
+	audioOpen = false;
+
+	mixLength = audioSpec.samples;
+	mixBuffer = new int[mixLength * audioSpec.channels];
+	stream = new unsigned char[audioSpec.size];
+
+	csv = NULL;
+
+	if (csvFile) {
+
+		csv = fopen(csvFile, "w");
+
+		if (csv) fprintf(csv, "config,resampling,flags,voices,samples_per_sec\n");
+		else logError("Could not write benchmark results", csvFile);
+
+	}
+
+	// Make sure the SIMD mixing code gives the same output as the C code
+	mismatches = ModPlug_CheckSIMD();
+
+	if (mismatches < 0) log("No SIMD mixing code to check");
+	else if (mismatches) log("SIMD mixing results differing from C", mismatches);
+	else log("SIMD mixing results match C");
+
+	printf("Audio benchmark: %d seconds at %d Hz, %d samples per callback\n",
+		seconds, audioSpec.freq, audioSpec.samples);
+	printf("%-14s %6s %14s %10s\n", "config", "voices", "samples/s", "realtime");
+
+	triggerFrames = (audioSpec.freq * AUDIO_BENCHMARK_TRIGGER) / 1000;
+
+	for (config = 0; config < AUDIO_BENCHMARK_CONFIGS; config++) {
+
+		musicFile = loadMusic(psmData, size, modes[config], flags[config]);
+
+		if (!musicFile) {
+
+			logError("Could not play music file", fileName);
+
+			break;
+
+		}
+
+		ModPlug_SetMasterVolume(musicFile, musicVolume * 2.56);
+
+		// Operations are queued as if the audio device were open
+		setSoundVoices(voiceCounts[config]);
+		resetVoices();
+		audioOpen = true;
+
+		total = seconds * audioSpec.freq;
+		trigger = 0;
+
+		start = getMicroTicks();
+
+		for (frames = 0; frames < total; frames += audioSpec.samples) {
+
+			// Start a different sound effect, at a different position, each time
+			while (trigger * triggerFrames <= frames) {
+
+				playSound((trigger % 32) + 1, MAX_VOLUME,
+					((trigger * 37) % ((MAX_PAN << 1) + 1)) - MAX_PAN, trigger & 3);
+
+				trigger++;
+
+			}
+
+			audioCallback(NULL, stream, audioSpec.size);
+
+		}
+
+		time = getMicroTicks() - start;
+		if (!time) time = 1;
+
+		audioOpen = false;
+
+		ModPlug_Unload(musicFile);
+		musicFile = NULL;
+
+		rate = (frames * 1000000.0f) / time;
+
+		printf("%-14s %6d %14.0f %9.1fx\n", names[config], voiceCounts[config],
+			rate, rate / audioSpec.freq);
+
+		if (csv) {
+
+			fprintf(csv, "%s,%d,%d,%d,%.0f\n", names[config], modes[config],
+				flags[config], voiceCounts[config], rate);
+
+		}
+
+	}
+
+	if (csv) fclose(csv);
+
+	delete[] stream;
+	delete[] mixBuffer;
+	mixBuffer = NULL;
+	delete[] psmData;
+
+	closeAudio();
+
+	return E_NONE;
+
 }
@@ -53,15 +53,50 @@
 #define MUSIC_NORMAL   0
 #define MUSIC_FAST     1
 
+#define MAX_PAN      100
+#define MAX_VOICES    32 /* Largest number of sound effects played at once */
+#define SOUND_VOICES  16 /* Default number of sound effects played at once */
+
+#define SOUND_NEAR      160 /* Distance (in pixels) within which sound effects are at full volume */
+#define SOUND_FAR       640 /* Distance (in pixels) beyond which sound effects are not heard */
+#define SOUND_PAN_RANGE 320 /* Horizontal distance (in pixels) at which sound effects are fully panned */
+#define SOUND_CULL_GAIN   2 /* Gain (out of 256) below which sound effects are not mixed */
+
+#define AUDIO_COMMANDS 256 /* Number of operations waiting for the audio callback (a power of 2) */
+
+#define MUSIC_ORDERS 256 /* Number of orders in a song */
+#define MUSIC_CACHE_KEYS 8 /* Number of values which must match for a cache file to be used */
+
+#define MIN_SOUND_RATE     8000
+#define MAX_SOUND_RATE    48000
+#define MIN_SOUND_SAMPLES   128
+#define MAX_SOUND_SAMPLES  8192
+
 
 // Datatype
 
+class File;
+struct _ModPlugFile;
+
+/// Sound effect data converted for output
+typedef struct ResampledSound {
+
+	short                 *data; ///< Signed 16-bit mono samples at the output rate
+	int                    length; ///< Number of samples
+	int                    rate; ///< Sample rate of the raw sound effect data
+	int                    outputRate; ///< Sample rate of the converted data
+	struct ResampledSound *next; ///< Conversion of the same data at another rate
+
+} ResampledSound;
+
+
 /// Raw sound effect data
 typedef struct {
 
-	unsigned char *data;
-	char          *name;
-	int            length;
+	unsigned char  *data;
+	char           *name;
+	int             length;
+	ResampledSound *resampled; ///< Cached conversions for output
 
 } RawSound;
 
@@ -69,13 +104,99 @@ typedef struct {
 /// Resampled sound effect data
 typedef struct {
 
-	unsigned char *data;
-	int            length;
-	int            position;
+	short *data; ///< Signed 16-bit mono samples at the output rate
+	int    length; ///< Number of samples
+	int    raw; ///< Index of the raw sound effect data, or -1 if none
+	int    rate; ///< Sample rate of the raw sound effect data
 
 } Sound;
 
 
+/// Sound effect being played
+typedef struct {
+
+	int          sound; ///< Index of the sound effect, or -1 if the voice is free
+	short       *data; ///< The sound effect's samples
+	int          length; ///< Number of samples
+	int          position; ///< Position in the sound effect, in samples
+	int          volume; ///< Volume (0-MAX_VOLUME)
+	int          pan; ///< Position from left (-MAX_PAN) to right (MAX_PAN)
+	int          priority; ///< Voices with lower priority are stolen first
+	unsigned int age; ///< Order in which voices were started
+
+} Voice;
+
+
+/// Audio operations passed from the game to the audio callback
+enum AudioCommandType {
+
+	AC_PLAY, ///< Start a sound effect
+	AC_STOP, ///< Stop all voices playing a sound effect
+	AC_SOUND_VOLUME, ///< Change the sound effect volume
+	AC_VOICES, ///< Change the number of voices
+	AC_PAUSE_MUSIC ///< Pause or unpause the music
+
+};
+
+
+/// Audio operation waiting for the audio callback
+typedef struct {
+
+	AudioCommandType type; ///< The operation
+	int              value; ///< Index of the sound effect, or the new setting
+	short           *data; ///< Samples of the sound effect to play
+	int              length; ///< Number of samples
+	int              volume; ///< Volume (0-MAX_VOLUME)
+	int              pan; ///< Position from left (-MAX_PAN) to right (MAX_PAN)
+	int              priority; ///< Voices with lower priority are stolen first
+
+} AudioCommand;
+
+
+/// Music rendered in advance and kept in a file
+typedef struct {
+
+	File *file; ///< The file, open for reading
+	int   length; ///< Length of the rendered music, in bytes
+	int   loop; ///< Position from which the music repeats, in bytes
+	int   position; ///< Position of the next data to be played, in bytes
+	int   orders[MUSIC_ORDERS]; ///< Position at which each order is first played, or -1
+	bool  live; ///< Whether the music is being decoded instead, at another tempo
+
+} MusicCache;
+
+
+/// Point at which rendered music reaches a row
+typedef struct {
+
+	int order; ///< The order
+	int row; ///< The row
+	int position; ///< Position in the rendered music, in bytes
+
+} MusicEntry;
+
+
+/// Music being rendered in advance, a piece at a time
+typedef struct {
+
+	_ModPlugFile  *music; ///< Copy of the music, from which to render
+	File          *file; ///< The file being written
+	char          *name; ///< Name of the file
+	int            key[MUSIC_CACHE_KEYS]; ///< Values identifying the music data and the settings used
+	MusicCache     cache; ///< Length, loop point and order positions rendered so far
+	MusicEntry    *entries; ///< Rows reached so far
+	int            nEntries; ///< Number of rows reached so far
+	int            maxEntries; ///< Size of the row array
+	unsigned char *buffer; ///< Buffer for each rendered piece
+	int            frameSize; ///< Size of a sample frame, in bytes
+	int            maxLength; ///< Length after which rendering stops, in bytes
+	int            lastOrder; ///< Order of the last row reached
+	int            lastRow; ///< Last row reached
+	int            loops; ///< Number of times the music had repeated at the last check
+
+} MusicRender;
+
+
 // Variables
 
 EXTERN RawSound *rawSounds;
@@ -90,23 +211,36 @@ EXTERN int volume_direction;
 
 // Functions
 
-EXTERN void openAudio      ();
-EXTERN void closeAudio     ();
-EXTERN void playMusic      (const char *fileName, bool restart = false);
-EXTERN void pauseMusic     (bool pause);
-EXTERN void stopMusic      ();
-EXTERN int  getMusicVolume ();
-EXTERN void setMusicVolume (int volume);
-EXTERN int  getMusicTempo  ();
-EXTERN void setMusicTempo  (int tempo);
-EXTERN int  loadSounds     (const char *fileName);
-EXTERN void resampleSound  (int index, const char* name, int rate);
-EXTERN void resampleSounds ();
-EXTERN void freeSounds     ();
-EXTERN void playSound      (char index);
-EXTERN bool isSoundPlaying (char index);
-EXTERN int  getSoundVolume ();
-EXTERN void setSoundVolume (int volume);
+EXTERN void openAudio             ();
+EXTERN void closeAudio            ();
+EXTERN int  getSoundRate          ();
+EXTERN int  getSoundSamples       ();
+EXTERN void setSoundFormat        (int rate, int samples);
+EXTERN int  getAudioCallbackTime  ();
+EXTERN int  getLateAudioCallbacks ();
+EXTERN int  getAudioUnderruns     ();
+EXTERN void playMusic             (const char *fileName, bool restart = false);
+EXTERN void pauseMusic            (bool pause);
+EXTERN void stopMusic             ();
+EXTERN int  getMusicVolume        ();
+EXTERN void setMusicVolume        (int volume);
+EXTERN int  getMusicTempo         ();
+EXTERN void setMusicTempo         (int tempo);
+EXTERN bool getMusicCache         ();
+EXTERN void setMusicCache         (bool cache);
+EXTERN int  loadSounds            (const char *fileName);
+EXTERN void resampleSound         (int index, const char* name, int rate);
+EXTERN void resampleSounds        ();
+EXTERN void freeSounds            ();
+EXTERN void playSound             (char index, int volume = MAX_VOLUME, int pan = 0, int priority = 0);
+EXTERN void playSoundAt           (char index, fixed x, fixed y, int priority = 0);
+EXTERN void setSoundListener      (fixed x, fixed y);
+EXTERN bool isSoundPlaying        (char index);
+EXTERN int  getSoundVolume        ();
+EXTERN void setSoundVolume        (int volume);
+EXTERN int  getSoundVoices        ();
+EXTERN void setSoundVoices        (int number);
+EXTERN int  benchmarkAudio        (const char *fileName, int seconds, const char *csvFile);
 
 #endif
 
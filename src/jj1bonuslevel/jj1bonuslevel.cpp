@@ -25,6 +25,7 @@
 #include "jj1bonuslevelplayer/jj1bonuslevelplayer.h"
 #include "jj1bonuslevel.h"
 
+#include "benchmark.h"
 #include "game/game.h"
 #include "game/gamemode.h"
 #include "io/controls.h"
@@ -34,6 +35,9 @@
 #include "io/gfx/sprite.h"
 #include "io/gfx/video.h"
 #include "io/sound.h"
+#include "level/replay.h"
+#include "profiler.h"
+#include "trace.h"
 #include "util.h"
 
 #include <string.h>
@@ -52,6 +56,8 @@ int JJ1BonusLevel::loadSprites () {
 	int width, height;
 	int count;
 
+	TRACE_SCOPE("JJ1BonusLevel::loadSprites");
+
 	try {
 
 		file = new File("BONUS.000", false);
@@ -134,6 +140,8 @@ int JJ1BonusLevel::loadTiles (char *fileName) {
 	unsigned char *sorted;
 	int count, x, y;
 
+	TRACE_SCOPE("JJ1BonusLevel::loadTiles");
+
 	try {
 
 		file = new File(fileName, false);
@@ -402,6 +410,30 @@ JJ1BonusLevel::~JJ1BonusLevel () {
 }
 
 
+/**
+ * Add the state of the level's grid to a checksum.
+ *
+ * @param checksum The checksum so far
+ *
+ * @return The new checksum
+ */
+unsigned int JJ1BonusLevel::getStateChecksum (unsigned int checksum) {
+
+	int gridX, gridY;
+
+	// Events are collected
+	for (gridY = 0; gridY < BLH; gridY++) {
+
+		for (gridX = 0; gridX < BLW; gridX++)
+			checksum = addChecksum(checksum, grid[gridY][gridX].event);
+
+	}
+
+	return checksum;
+
+}
+
+
 /**
  * Determine whether or not the given point is in the event area of its tile.
  *
@@ -494,13 +526,16 @@ int JJ1BonusLevel::step () {
 	int gridX, gridY;
 	int count;
 
+	TRACE_SCOPE("JJ1BonusLevel::step");
+	PROFILE_SCOPE(PP_STEP);
+
 	// Check if time has run out
 	if (ticks > endTime) return LOST;
 
 
 	// Apply controls to local player
 	for (count = 0; count < PCONTROLS; count++)
-		localPlayer->setControl(count, controls.getState(count));
+		localPlayer->setControl(count, replay.getState(count));
 
 	// Process players
 	for (count = 0; count < nPlayers; count++) {
@@ -510,7 +545,7 @@ int JJ1BonusLevel::step () {
 		playerX = bonusPlayer->getX();
 		playerY = bonusPlayer->getY();
 
-		bonusPlayer->step(ticks, 16, this);
+		bonusPlayer->step(ticks, T_STEP, this);
 
 		if ((bonusPlayer->getZ() < FH) && isEvent(playerX, playerY)) {
 
@@ -578,6 +613,12 @@ void JJ1BonusLevel::draw () {
 	int levelX, levelY;
 	int x, y;
 
+	TRACE_SCOPE("JJ1BonusLevel::draw");
+
+
+	// Follow the benchmark path, if measuring
+	if (benchmark.isRunning()) direction = benchmark.getDirection();
+
 
 	// Draw the background
 
@@ -601,6 +642,8 @@ void JJ1BonusLevel::draw () {
 
 	// Draw the ground
 
+	PROFILE_START(timer);
+
 	playerX = bonusPlayer->getX();
 	playerY = bonusPlayer->getY();
 	playerSin = fSin(direction);
@@ -635,6 +678,8 @@ void JJ1BonusLevel::draw () {
 
 	if (SDL_MUSTLOCK(canvas)) SDL_UnlockSurface(canvas);
 
+	PROFILE_MARK(timer, PP_TILES);
+
 
 	// Draw nearby events
 
@@ -715,6 +760,8 @@ void JJ1BonusLevel::draw () {
 	// Show the player
 	bonusPlayer->draw(ticks);
 
+	PROFILE_MARK(timer, PP_SPRITES);
+
 
 	// Show gem count
 	font->showString("*", 0, 0);
@@ -748,6 +795,7 @@ int JJ1BonusLevel::play () {
 	bool pmenu, pmessage;
 	int option;
 	unsigned int returnTime;
+	unsigned int startTime;
 	int ret;
 
 
@@ -755,6 +803,9 @@ int JJ1BonusLevel::play () {
 	ticks = T_STEP;
 	steps = 0;
 
+	replay.beginLevel();
+	benchmark.beginLevel();
+
 	pmessage = pmenu = false;
 	option = 0;
 
@@ -787,11 +838,15 @@ int JJ1BonusLevel::play () {
 
 		// Process frame-by-frame activity
 
-		while ((getTimeChange() >= T_STEP) && (stage == LS_NORMAL)) {
+		startTime = getMicroTicks();
+
+		while ((stage == LS_NORMAL) && stepDue()) {
 
 			ret = step();
 			steps++;
 
+			replay.endStep(replay.isCheckDue()? getChecksum(): 0);
+
 			if (ret < 0) return ret;
 			else if (ret) {
 
@@ -803,6 +858,14 @@ int JJ1BonusLevel::play () {
 
 		}
 
+		benchmark.addTime(BP_STEP, startTime);
+
+
+		// Nothing to draw when headless
+		if (headless) continue;
+
+
+		startTime = getMicroTicks();
 
 		// Draw the graphics
 
@@ -819,6 +882,8 @@ int JJ1BonusLevel::play () {
 		// Draw statistics, menu etc.
 		drawOverlay(0, pmenu, option, 0, 31, 16);
 
+		benchmark.addTime(BP_DRAW, startTime);
+
 	}
 
 	return E_NONE;
@@ -66,8 +66,9 @@ class JJ1BonusLevel : public Level {
 		int  loadSprites ();
 		int  loadTiles   (char* fileName);
 		bool isEvent     (fixed x, fixed y);
-		int  step        ();
-		void draw        ();
+		int          step             ();
+		void         draw             ();
+		unsigned int getStateChecksum (unsigned int checksum);
 
 	public:
 		JJ1BonusLevel  (Game* owner, char* fileName, bool multi);
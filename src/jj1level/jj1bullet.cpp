@@ -113,6 +113,18 @@ JJ1Bullet* JJ1Bullet::remove () {
 }
 
 
+/**
+ * Get the next bullet.
+ *
+ * @return The next bullet
+ */
+JJ1Bullet* JJ1Bullet::getNext () {
+
+	return next;
+
+}
+
+
 /**
  * Get the player responsible for this bullet.
  *
@@ -140,6 +152,8 @@ JJ1Bullet* JJ1Bullet::step (unsigned int ticks) {
 	// Process the next bullet
 	if (next) next = next->step(ticks);
 
+	savePosition();
+
 
 	if (level->getStage() != LS_END) {
 
@@ -191,7 +205,7 @@ JJ1Bullet* JJ1Bullet::step (unsigned int ticks) {
 	// If the scenery has been hit and this is not a bouncer, destroy the bullet
 	if (level->checkMaskUp(x, y) && (set[B_BEHAVIOUR] != 4)) {
 
-		playSound(set[B_FINISHSOUND]);
+		playSoundAt(set[B_FINISHSOUND], x, y);
 
 		return remove();
 
@@ -72,6 +72,7 @@ class JJ1Bullet : public Movable {
 		JJ1Bullet  (JJ1Bullet* nextBullet, JJ1LevelPlayer* sourcePlayer, fixed startX, fixed startY, signed char *bullet, int newDirection, unsigned int ticks);
 		~JJ1Bullet ();
 
+		JJ1Bullet*      getNext   ();
 		JJ1LevelPlayer* getSource ();
 		JJ1Bullet*      step      (unsigned int ticks);
 		void            draw      (int change);
@@ -124,6 +124,9 @@ int JJ1DemoLevel::play () {
 	ticks = 17;
 	steps = 0;
 
+	// Start the simulation's view in the same place every time
+	stepViewX = stepViewY = 0;
+
 	video.setPalette(palette);
 
 	playMusic(musicFile);
@@ -177,7 +180,7 @@ int JJ1DemoLevel::play () {
 		// Process frame-by-frame activity
 
 		// Process step
-		while (getTimeChange() >= T_STEP) {
+		while (stepDue()) {
 
 			ret = step();
 			steps++;
@@ -191,6 +194,10 @@ int JJ1DemoLevel::play () {
 		if (localPlayer->getJJ1LevelPlayer()->reacted(ticks) == PR_KILLED) return LOST;
 
 
+		// Nothing to draw when headless
+		if (headless) continue;
+
+
 		// Draw the graphics
 
 		draw();
@@ -132,7 +132,7 @@ void JJ1Event::destroy (unsigned int ticks) {
 
 	level->setEventTime(gridX, gridY, ticks);
 
-	playSound(set->sound);
+	playSoundAt(set->sound, x, y);
 
 	return;
 
@@ -302,15 +302,17 @@ JJ1EventType* JJ1Event::prepareStep (unsigned int ticks) {
 	// If the event has been removed from the grid, destroy it
 	if (!set) return NULL;
 
+	savePosition();
+
 	// If the event and its origin are off-screen, the event is not in the
 	// process of self-destruction, remove it
 	if (((animType & ~1) != E_LFINISHANIM) &&
-		((x < viewX - F192) || (x > viewX + ITOF(canvasW) + F192) ||
-		(y < viewY - F160) || (y > viewY + ITOF(canvasH) + F160)) &&
-		((gridX < FTOT(viewX) - 1) ||
-		(gridX > ITOT(FTOI(viewX) + canvasW) + 1) ||
-		(gridY < FTOT(viewY) - 1) ||
-		(gridY > ITOT(FTOI(viewY) + canvasH) + 1))) return NULL;
+		((x < stepViewX - F192) || (x > stepViewX + ITOF(STEP_VIEW_W) + F192) ||
+		(y < stepViewY - F160) || (y > stepViewY + ITOF(STEP_VIEW_H) + F160)) &&
+		((gridX < FTOT(stepViewX) - 1) ||
+		(gridX > ITOT(FTOI(stepViewX) + STEP_VIEW_W) + 1) ||
+		(gridY < FTOT(stepViewY) - 1) ||
+		(gridY > ITOT(FTOI(stepViewY) + STEP_VIEW_H) + 1))) return NULL;
 
 	return set;
 
@@ -839,13 +839,13 @@ JJ1Event* JJ1StandardEvent::step (unsigned int ticks) {
 					if (animType == E_LEFTANIM) {
 
 						if (level->checkMaskDown(x - F4, y - (height >> 1)) ||
-							(x - F4 < viewX))
+							(x - F4 < stepViewX))
 							setAnimType(E_RIGHTANIM);
 
 					} else if (animType == E_RIGHTANIM) {
 
 						if (level->checkMaskDown(x + width + F4, y - (height >> 1)) ||
-							(x + width + F4 > viewX + ITOF(canvasW)))
+							(x + width + F4 > stepViewX + ITOF(STEP_VIEW_W)))
 							setAnimType(E_LEFTANIM);
 
 					}
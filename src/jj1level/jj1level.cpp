@@ -38,6 +38,7 @@
 #include "jj1level.h"
 #include "jj1levelplayer/jj1levelplayer.h"
 
+#include "benchmark.h"
 #include "game/game.h"
 #include "game/gamemode.h"
 #include "io/controls.h"
@@ -47,6 +48,7 @@
 #include "io/gfx/sprite.h"
 #include "io/gfx/video.h"
 #include "io/sound.h"
+#include "level/replay.h"
 #include "util.h"
 
 #include <string.h>
@@ -309,6 +311,60 @@ JJ1Event* JJ1Level::getEvents () {
 }
 
 
+/**
+ * Add the state of the level's events, bullets and grid to a checksum.
+ *
+ * @param checksum The checksum so far
+ *
+ * @return The new checksum
+ */
+unsigned int JJ1Level::getStateChecksum (unsigned int checksum) {
+
+	JJ1Event* event;
+	JJ1Bullet* bullet;
+	int gridX, gridY;
+
+	event = events;
+
+	while (event) {
+
+		checksum = addChecksum(checksum, event->getX());
+		checksum = addChecksum(checksum, event->getY());
+
+		event = event->getNext();
+
+	}
+
+	bullet = bullets;
+
+	while (bullet) {
+
+		checksum = addChecksum(checksum, bullet->getX());
+		checksum = addChecksum(checksum, bullet->getY());
+
+		bullet = bullet->getNext();
+
+	}
+
+	// Tiles change, and events are shot and removed
+	for (gridY = 0; gridY < LH; gridY++) {
+
+		for (gridX = 0; gridX < LW; gridX++) {
+
+			checksum = addChecksum(checksum, grid[gridY][gridX].tile);
+			checksum = addChecksum(checksum, grid[gridY][gridX].event);
+			checksum = addChecksum(checksum, grid[gridY][gridX].hits);
+			checksum = addChecksum(checksum, grid[gridY][gridX].time);
+
+		}
+
+	}
+
+	return checksum;
+
+}
+
+
 /**
  * Get the event data for the event from the given tile.
  *
@@ -618,7 +674,7 @@ void JJ1Level::createBullet (JJ1LevelPlayer* sourcePlayer, unsigned char gridX,
 
 		}
 
-		playSound(set[B_STARTSOUND]);
+		playSoundAt(set[B_STARTSOUND], startX, startY);
 
 	}
 
@@ -737,6 +793,7 @@ int JJ1Level::play () {
 	unsigned int returnTime;
  	int perfect;
  	int timeBonus;
+	unsigned int startTime;
  	int count, ret;
 
 
@@ -746,6 +803,12 @@ int JJ1Level::play () {
 	ticks = T_STEP;
 	steps = 0;
 
+	// Start the simulation's view in the same place every time
+	stepViewX = stepViewY = 0;
+
+	replay.beginLevel();
+	benchmark.beginLevel();
+
 	pmessage = pmenu = false;
 	option = 0;
 
@@ -804,79 +867,97 @@ int JJ1Level::play () {
 
 		// Process frame-by-frame activity
 
-		while (getTimeChange() >= T_STEP) {
+		startTime = getMicroTicks();
+
+		while (stepDue()) {
 
 			bool playerWasAlive = (localPlayer->getJJ1LevelPlayer()->getEnergy() != 0);
 
 			// Apply controls to local player
 			for (count = 0; count < PCONTROLS; count++)
-				localPlayer->setControl(count, controls.getState(count));
+				localPlayer->setControl(count, replay.getState(count));
 
 			ret = step();
 			steps++;
 
-			if (ret) return ret;
+			if (stage == LS_END) {
 
-			if (!multiplayer && playerWasAlive && (localPlayer->getJJ1LevelPlayer()->getEnergy() == 0))
-				flash(0, 0, 0, T_END << 1);
+				// The level is over, so apply bonuses
 
-		}
+				// Apply time bonus
 
+				if (timeBonus) {
 
-		// Draw the graphics
+					// Count down one unit each step, so the tally does not
+					// depend on the frame rate
+					count = 1;
 
-		draw();
+					if (timeBonus == -1) {
 
+						if (ticks < endTime) timeBonus = ((endTime - ticks) / 60000) * 100;
+						else timeBonus = 0;
 
-		// If paused, draw "PAUSE"
-		if (pmessage && !pmenu)
-			font->showString("pause", (canvasW >> 1) - 44, 32);
+						if ((levelPlayer->getEnemies() == enemies) &&
+							(levelPlayer->getItems() == items)) perfect = 100;
 
-		// If paused, silence music
-		pauseMusic(pmessage && !pmenu);
+					} else if (timeBonus - count >= 0) {
 
-		if (stage == LS_END) {
+						localPlayer->addScore(count * 10);
+						timeBonus -= count;
 
-			// The level is over, so draw play statistics & bonuses
+					} else {
 
-			// Apply time bonus
+						localPlayer->addScore(timeBonus * 10);
+						timeBonus = 0;
 
-			if (timeBonus) {
+					}
 
-				count = (ticks - prevTicks) / 100;
-				if (!count) count = 1;
+					if (timeBonus == 0) {
 
-				if (timeBonus == -1) {
+						returnTime = ticks + T_END;
+						paletteEffects = new WhiteOutPaletteEffect(T_END, paletteEffects);
+						playSound(S_ORB);
 
-					if (ticks < endTime) timeBonus = ((endTime - ticks) / 60000) * 100;
-					else timeBonus = 0;
+					}
 
-					if ((levelPlayer->getEnemies() == enemies) &&
-						(levelPlayer->getItems() == items)) perfect = 100;
+				}
 
-				} else if (timeBonus - count >= 0) {
+			}
 
-					localPlayer->addScore(count * 10);
-					timeBonus -= count;
+			replay.endStep(replay.isCheckDue()? getChecksum(): 0);
 
-				} else {
+			if (ret) return ret;
 
-					localPlayer->addScore(timeBonus * 10);
-					timeBonus = 0;
+			if (!multiplayer && playerWasAlive && (localPlayer->getJJ1LevelPlayer()->getEnergy() == 0))
+				flash(0, 0, 0, T_END << 1);
 
-				}
+		}
 
-				if (timeBonus == 0) {
+		benchmark.addTime(BP_STEP, startTime);
 
-					returnTime = ticks + T_END;
-					paletteEffects = new WhiteOutPaletteEffect(T_END, paletteEffects);
-					playSound(S_ORB);
 
-				}
+		// If paused, silence music
+		pauseMusic(pmessage && !pmenu);
 
-			}
 
-			// Display statistics & bonuses
+		// Nothing to draw when headless
+		if (headless) continue;
+
+
+		startTime = getMicroTicks();
+
+		// Draw the graphics
+
+		draw();
+
+
+		// If paused, draw "PAUSE"
+		if (pmessage && !pmenu)
+			font->showString("pause", (canvasW >> 1) - 44, 32);
+
+		if (stage == LS_END) {
+
+			// The level is over, so display statistics & bonuses
 
 			font->showString("time", (canvasW >> 1) - 152, (canvasH >> 1) - 60);
 			font->showNumber(timeBonus, (canvasW >> 1) + 124, (canvasH >> 1) - 60);
@@ -909,6 +990,8 @@ int JJ1Level::play () {
 		// Draw statistics, menu etc.
 		drawOverlay(LEVEL_BLACK, pmenu, option, 15, 47, -16);
 
+		benchmark.addTime(BP_DRAW, startTime);
+
 	}
 
 	return E_NONE;
@@ -214,9 +214,10 @@ class JJ1Level : public Level {
 
 		JJ1Level (Game* owner);
 
-		int  load (char* fileName, bool checkpoint);
-		int  step ();
-		void draw ();
+		int          load             (char* fileName, bool checkpoint);
+		int          step             ();
+		void         draw             ();
+		unsigned int getStateChecksum (unsigned int checksum);
 
 	public:
 		JJ1EventPath path[PATHS]; ///< Pre-defined event movement paths
@@ -32,11 +32,15 @@
 #include "jj1level.h"
 #include "jj1levelplayer/jj1levelplayer.h"
 
+#include "benchmark.h"
 #include "game/game.h"
 #include "game/gamemode.h"
 #include "io/controls.h"
 #include "io/gfx/font.h"
 #include "io/gfx/video.h"
+#include "io/sound.h"
+#include "profiler.h"
+#include "trace.h"
 #include "util.h"
 
 
@@ -51,15 +55,35 @@ int JJ1Level::step () {
 	int viewH;
 	int x, y;
 
+	TRACE_SCOPE("JJ1Level::step");
+	PROFILE_SCOPE(PP_STEP);
+	PROFILE_START(timer);
 
-	// Can we see below the panel?
-	if (canvasW > SW) viewH = canvasH;
-	else viewH = canvasH - 33;
+
+	// The simulation's view is above the panel
+	viewH = STEP_VIEW_H - 33;
+
+	// Move the view used to decide which events are active. This follows the
+	// player from step to step, at a fixed size, so it also moves the same
+	// way whatever the frame rate and window size, and when nothing is being
+	// drawn.
+	if (benchmark.isRunning()) {
+
+		stepViewX = viewX;
+		stepViewY = viewY;
+
+	} else localPlayer->getJJ1LevelPlayer()->view(ticks, T_STEP, T_STEP, STEP_VIEW_W, viewH, stepViewX, stepViewY);
+
+	// Ensure the view is within the level
+	if (FTOI(stepViewX) + STEP_VIEW_W >= TTOI(LW)) stepViewX = ITOF(TTOI(LW) - STEP_VIEW_W);
+	if (stepViewX < 0) stepViewX = 0;
+	if (FTOI(stepViewY) + viewH >= TTOI(LH)) stepViewY = ITOF(TTOI(LH) - viewH);
+	if (stepViewY < 0) stepViewY = 0;
 
 	// Search for active events
-	for (y = FTOT(viewY) - 5; y < ITOT(FTOI(viewY) + viewH) + 5; y++) {
+	for (y = FTOT(stepViewY) - 5; y < ITOT(FTOI(stepViewY) + viewH) + 5; y++) {
 
-		for (x = FTOT(viewX) - 5; x < ITOT(FTOI(viewX) + canvasW) + 5; x++) {
+		for (x = FTOT(stepViewX) - 5; x < ITOT(FTOI(stepViewX) + STEP_VIEW_W) + 5; x++) {
 
 			if ((x >= 0) && (y >= 0) && (x < LW) && (y < LH) &&
 				grid[y][x].event && (grid[y][x].event < 121) &&
@@ -116,19 +140,29 @@ int JJ1Level::step () {
 	}
 
 
+	PROFILE_MARK(timer, PP_EVENTS);
+
 	// Process bullets
 	if (bullets) bullets = bullets->step(ticks);
 
+	PROFILE_MARK(timer, PP_BULLETS);
+
 	// Determine the players' trajectories
 	for (x = 0; x < nPlayers; x++) players[x].getJJ1LevelPlayer()->control(ticks);
 
+	PROFILE_MARK(timer, PP_PLAYERS);
+
 	// Process active events
 	if (events) events = events->step(ticks);
 
+	PROFILE_MARK(timer, PP_EVENTS);
+
 	// Apply as much of those trajectories as possible, without going into the
 	// scenery
 	for (x = 0; x < nPlayers; x++) players[x].getJJ1LevelPlayer()->move(ticks);
 
+	PROFILE_MARK(timer, PP_PLAYERS);
+
 
 	// Check if time has run out
 	if (ticks > endTime) {
@@ -213,25 +247,31 @@ void JJ1Level::draw () {
 	int x, y, bgScale;
 	unsigned int change;
 
+	TRACE_SCOPE("JJ1Level::draw");
+
 
 	// Calculate change since last step
 	change = getTimeChange();
 
 
-	// Calculate viewport
-	if (game && (stage == LS_END)) game->view(paused? 0: ((ticks - prevTicks) * 160));
-	else localPlayer->getJJ1LevelPlayer()->view(ticks, paused? 0: (ticks - prevTicks), change);
-
 	// Can we see below the panel?
 	if (canvasW > SW) viewH = canvasH;
 	else viewH = canvasH - 33;
 
+	// Calculate viewport
+	if (benchmark.isRunning()) benchmark.view(TTOI(LW) - canvasW, TTOI(LH) - viewH);
+	else if (game && (stage == LS_END)) game->view(paused? 0: ((ticks - prevTicks) * 160));
+	else localPlayer->getJJ1LevelPlayer()->view(ticks, paused? 0: (ticks - prevTicks), change, canvasW, canvasH - 33, viewX, viewY);
+
 	// Ensure the new viewport is within the level
 	if (FTOI(viewX) + canvasW >= TTOI(LW)) viewX = ITOF(TTOI(LW) - canvasW);
 	if (viewX < 0) viewX = 0;
 	if (FTOI(viewY) + viewH >= TTOI(LH)) viewY = ITOF(TTOI(LH) - viewH);
 	if (viewY < 0) viewY = 0;
 
+	// Hear sound effects from the centre of the viewport
+	setSoundListener(viewX + ITOF(canvasW >> 1), viewY + ITOF(viewH >> 1));
+
 	// Use the viewport
 	dst.x = 0;
 	dst.y = 0;
@@ -281,6 +321,8 @@ void JJ1Level::draw () {
 
 	// Show background tiles
 
+	PROFILE_START(timer);
+
 	for (y = 0; y <= ITOT(viewH - 1) + 1; y++) {
 
 		for (x = 0; x <= ITOT(canvasW - 1) + 1; x++) {
@@ -319,6 +361,9 @@ void JJ1Level::draw () {
 	}
 
 
+	PROFILE_MARK(timer, PP_TILES);
+
+
 	// Show active events
 	if (events) events->draw(ticks, change);
 
@@ -330,6 +375,8 @@ void JJ1Level::draw () {
 	// Show bullets
 	if (bullets) bullets->draw(change);
 
+	PROFILE_MARK(timer, PP_SPRITES);
+
 
 
 	// Show foreground tiles
@@ -371,6 +418,8 @@ void JJ1Level::draw () {
 
 	}
 
+	PROFILE_MARK(timer, PP_TILES);
+
 	// Temporary lines showing the water level
 	drawRect(0, FTOI(waterLevel - viewY), canvasW, 2, 24);
 	drawRect(0, FTOI(waterLevel - viewY) + 3, canvasW, 1, 24);
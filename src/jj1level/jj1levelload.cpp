@@ -39,6 +39,7 @@
 #include "io/gfx/video.h"
 #include "io/sound.h"
 #include "loop.h"
+#include "trace.h"
 #include "util.h"
 
 #include <string.h>
@@ -59,6 +60,8 @@ int JJ1Level::loadPanel () {
 	unsigned char* sorted;
 	int type, x, y;
 
+	TRACE_SCOPE("JJ1Level::loadPanel");
+
 
 	try {
 
@@ -181,6 +184,8 @@ int JJ1Level::loadSprites (char * fileName) {
 	int count;
 	bool loaded;
 
+	TRACE_SCOPE("JJ1Level::loadSprites");
+
 
 	// Open fileName
 	try {
@@ -311,6 +316,8 @@ int JJ1Level::loadTiles (char* fileName) {
 	int rle, pos, index, count, fileSize;
 	int tiles;
 
+	TRACE_SCOPE("JJ1Level::loadTiles");
+
 
 	try {
 
@@ -416,6 +423,8 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 	int count, x, y, type;
 	unsigned char startX, startY;
 
+	TRACE_SCOPE("JJ1Level::load");
+
 
 	// Load font
 
@@ -447,7 +456,7 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 	// Open planet.### file
 
-	if (!strcmp(fileName, LEVEL_FILE)) {
+	if (!strncmp(fileName, LEVEL_FILE, strlen(LEVEL_FILE))) {
 
 		// Using the downloaded level file
 
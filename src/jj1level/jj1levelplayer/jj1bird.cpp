@@ -167,6 +167,8 @@ JJ1Bird* JJ1Bird::step (unsigned int ticks) {
 	// Process the next bird
 	if (next) next = next->step(ticks);
 
+	savePosition();
+
 	if (next) leader = next;
 	else leader = player;
 
@@ -177,7 +179,7 @@ JJ1Bird* JJ1Bird::step (unsigned int ticks) {
 		dy = -F80;
 
 		// If the bird has flown off-screen, remove it
-		if (y < viewY - F160) return remove();
+		if (y < stepViewY - F160) return remove();
 
 	} else {
 
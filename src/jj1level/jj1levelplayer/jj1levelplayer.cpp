@@ -334,7 +334,7 @@ bool JJ1LevelPlayer::hit (Player *source, unsigned int ticks) {
 
 	}
 
-	playSound(S_UPLOOP);
+	playSoundAt(S_UPLOOP, x, y);
 
 	if (energy) {
 
@@ -787,7 +787,7 @@ bool JJ1LevelPlayer::touchEvent (JJ1EventType* event, unsigned char gridX, unsig
 			eventY = gridY;
 			targetY = TTOF(gridY) + (event->magnitude * ITOF(21));
 
-			playSound(event->sound);
+			playSoundAt(event->sound, x, y);
 
 			break;
 
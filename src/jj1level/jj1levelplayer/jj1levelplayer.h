@@ -191,7 +191,7 @@ class JJ1LevelPlayer : public LevelPlayer {
 		void           changeAmmo  (int type, bool fallback = false);
 		void           control     (unsigned int ticks);
 		void           move        (unsigned int ticks);
-		void           view        (unsigned int ticks, int mspf, int change);
+		void           view        (unsigned int ticks, int mspf, int change, int width, int height, fixed& vX, fixed& vY);
 		void           draw        (unsigned int ticks, int change);
 
 };
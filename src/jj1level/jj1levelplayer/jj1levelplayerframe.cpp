@@ -39,6 +39,7 @@
 #include "io/gfx/font.h"
 #include "io/gfx/video.h"
 #include "io/sound.h"
+#include "level/replay.h"
 #include "util.h"
 
 
@@ -129,6 +130,8 @@ void JJ1LevelPlayer::control (unsigned int ticks) {
 	int count;
 
 
+	savePosition();
+
 	// If the player has been killed, drop but otherwise do not move
 	if (!energy) {
 
@@ -340,7 +343,7 @@ void JJ1LevelPlayer::control (unsigned int ticks) {
 
 			eventType = JJ1PE_NONE;
 
-			playSound(S_PHOTON);
+			playSoundAt(S_PHOTON, x, y);
 
 		} else if (((eventType == JJ1PE_NONE) || (eventType == JJ1PE_PLATFORM)) &&
 			!player->pcontrols[C_JUMP]) {
@@ -501,7 +504,7 @@ void JJ1LevelPlayer::control (unsigned int ticks) {
 	}
 	for (count = 0; count < 5; count++) {
 
-		if (controls.getState(count + C_BLASTER)) {
+		if (replay.getState(count + C_BLASTER)) {
 
 			if (player == localPlayer) controls.release(count + C_BLASTER);
 
@@ -836,31 +839,35 @@ void JJ1LevelPlayer::move (unsigned int ticks) {
  * @param ticks Time
  * @param mspf Ticks per frame
  * @param change Time since last step
+ * @param width Width of the viewport
+ * @param height Height of the viewport, excluding the panel
+ * @param vX Viewport x-coordinate, which is updated
+ * @param vY Viewport y-coordinate, which is updated
  */
-void JJ1LevelPlayer::view (unsigned int ticks, int mspf, int change) {
+void JJ1LevelPlayer::view (unsigned int ticks, int mspf, int change, int width, int height, fixed& vX, fixed& vY) {
 
 	int oldViewX, oldViewY, speed;
 
 	// Record old viewport position for applying lag
-	oldViewX = viewX;
-	oldViewY = viewY;
+	oldViewX = vX;
+	oldViewY = vY;
 
 	// Find new position
 
-	viewX = x + ((dx * change) >> 10) + F8 - (canvasW << 9);
-	viewY = y + ((dy * change) >> 10) - F24 - ((canvasH - 33) << 9);
+	vX = getStepX(change) + F8 - (width << 9);
+	vY = getStepY(change) - F24 - (height << 9);
 
 	if ((lookTime > 0) && ((int)ticks > 1000 + lookTime)) {
 
 		// Look down
-		if ((int)ticks < 2000 + lookTime) viewY += 64 * (ticks - (1000 + lookTime));
-		else viewY += F64;
+		if ((int)ticks < 2000 + lookTime) vY += 64 * (ticks - (1000 + lookTime));
+		else vY += F64;
 
 	} else if ((lookTime < 0) && ((int)ticks > 1000 - lookTime)) {
 
 		// Look up
-		if ((int)ticks < 2000 - lookTime) viewY -= 64 * (ticks - (1000 - lookTime));
-		else viewY -= F64;
+		if ((int)ticks < 2000 - lookTime) vY -= 64 * (ticks - (1000 - lookTime));
+		else vY -= F64;
 
 	}
 
@@ -870,8 +877,8 @@ void JJ1LevelPlayer::view (unsigned int ticks, int mspf, int change) {
 
 	if (speed && (mspf < speed)) {
 
-		viewX = ((oldViewX * (speed - mspf)) + (viewX * mspf)) / speed;
-		viewY = ((oldViewY * (speed - mspf)) + (viewY * mspf)) / speed;
+		vX = ((oldViewX * (speed - mspf)) + (vX * mspf)) / speed;
+		vY = ((oldViewY * (speed - mspf)) + (vY * mspf)) / speed;
 
 	}
 
@@ -252,6 +252,18 @@ void JJ2Event::destroy (unsigned int ticks) {
 }
 
 
+/**
+ * Get the next event
+ *
+ * @return The next event
+ */
+JJ2Event* JJ2Event::getNext () {
+
+	return next;
+
+}
+
+
 /**
  * Get the event's type
  *
@@ -53,6 +53,7 @@ class JJ2Event : public Movable {
 	public:
 		virtual ~JJ2Event ();
 
+		JJ2Event*         getNext ();
 		unsigned char     getType ();
 
 		virtual JJ2Event* step    (unsigned int ticks, int msps) = 0;
@@ -290,6 +290,8 @@ bool JJ2Event::prepareStep (unsigned int ticks, int msps) {
 	// Process next event(s)
 	if (next) next = next->step(ticks, msps);
 
+	savePosition();
+
 
 	// If the reaction time has expired
 	if (endTime && (ticks > endTime)) {
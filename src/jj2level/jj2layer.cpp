@@ -27,6 +27,7 @@
 #include "jj2level.h"
 
 #include "io/gfx/video.h"
+#include "profiler.h"
 
 
 /**
@@ -218,6 +219,8 @@ void JJ2Layer::draw (SDL_Surface* tileSet, SDL_Surface* flippedTileSet) {
 	int vX, vY;
 	int x, y;
 
+	PROFILE_SCOPE(PP_TILES);
+
 	// Set tile drawing dimensions
 	src.w = TTOI(1);
 	src.h = TTOI(1);
@@ -30,6 +30,7 @@
 #include "jj2level.h"
 #include "jj2levelplayer/jj2levelplayer.h"
 
+#include "benchmark.h"
 #include "game/game.h"
 #include "game/gamemode.h"
 #include "io/controls.h"
@@ -38,6 +39,7 @@
 #include "io/gfx/sprite.h"
 #include "io/gfx/video.h"
 #include "io/sound.h"
+#include "level/replay.h"
 #include "util.h"
 
 #include <string.h>
@@ -233,6 +235,36 @@ void JJ2Level::setFrame (int gridX, int gridY, unsigned char frame) {
 }
 
 
+/**
+ * Add the state of the level's events to a checksum.
+ *
+ * @param checksum The checksum so far
+ *
+ * @return The new checksum
+ */
+unsigned int JJ2Level::getStateChecksum (unsigned int checksum) {
+
+	JJ2Event* event;
+
+	checksum = addChecksum(checksum, waterLevel);
+
+	event = events;
+
+	while (event) {
+
+		checksum = addChecksum(checksum, event->getType());
+		checksum = addChecksum(checksum, event->getX());
+		checksum = addChecksum(checksum, event->getY());
+
+		event = event->getNext();
+
+	}
+
+	return checksum;
+
+}
+
+
 /**
  * Get the modifier event for the given tile.
  *
@@ -435,6 +467,7 @@ int JJ2Level::play () {
 	bool pmessage, pmenu;
 	int option;
 	unsigned int returnTime;
+	unsigned int startTime;
 	int count, ret;
 
 
@@ -444,6 +477,9 @@ int JJ2Level::play () {
 	ticks = T_STEP;
 	steps = 0;
 
+	replay.beginLevel();
+	benchmark.beginLevel();
+
 	pmessage = pmenu = false;
 	option = 0;
 
@@ -474,19 +510,42 @@ int JJ2Level::play () {
 
 		// Process frame-by-frame activity
 
-		while (getTimeChange() >= T_STEP) {
+		startTime = getMicroTicks();
+
+		while (stepDue()) {
 
 			// Apply controls to local player
 			for (count = 0; count < PCONTROLS; count++)
-				localPlayer->setControl(count, controls.getState(count));
+				localPlayer->setControl(count, replay.getState(count));
 
 			ret = step();
 			steps++;
 
+			replay.endStep(replay.isCheckDue()? getChecksum(): 0);
+
 			if (ret) return ret;
 
 		}
 
+		benchmark.addTime(BP_STEP, startTime);
+
+
+		// If paused, silence music
+		pauseMusic(pmessage && !pmenu);
+
+		if ((stage == LS_END) && !returnTime) {
+
+			returnTime = ticks + 3000;
+			playSound(S_UPLOOP);
+
+		}
+
+
+		// Nothing to draw when headless
+		if (headless) continue;
+
+
+		startTime = getMicroTicks();
 
 		// Draw the graphics
 
@@ -497,20 +556,10 @@ int JJ2Level::play () {
 		if (pmessage && !pmenu)
 			font->showString("pause", (canvasW >> 1) - 44, 32);
 
-		// If paused, silence music
-		pauseMusic(pmessage && !pmenu);
-
 		if (stage == LS_END) {
 
 			// The level is over, so draw gem counts
 
-			if (!returnTime) {
-
-				returnTime = ticks + 3000;
-				playSound(S_UPLOOP);
-
-			}
-
 			// Display statistics
 
 			font->showString("red gems", (canvasW >> 1) - 152, (canvasH >> 1) - 60);
@@ -528,6 +577,8 @@ int JJ2Level::play () {
 		// Draw statistics, menu etc.
 		drawOverlay(JJ2_BLACK, pmenu, option, 71, 31, -8);
 
+		benchmark.addTime(BP_DRAW, startTime);
+
 	}
 
 	return E_NONE;
@@ -214,8 +214,9 @@ class JJ2Level : public Level {
 		int  loadSprites ();
 		int  loadTiles   (char* fileName);
 
-		int  step        ();
-		void draw        ();
+		int          step             ();
+		void         draw             ();
+		unsigned int getStateChecksum (unsigned int checksum);
 
 	public:
 		JJ2Level  (Game* owner, char* fileName, bool checkpoint, bool multi);
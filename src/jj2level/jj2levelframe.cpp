@@ -28,11 +28,15 @@
 #include "jj2level.h"
 #include "jj2levelplayer/jj2levelplayer.h"
 
+#include "benchmark.h"
 #include "game/game.h"
 #include "game/gamemode.h"
 #include "io/controls.h"
 #include "io/gfx/font.h"
 #include "io/gfx/video.h"
+#include "io/sound.h"
+#include "profiler.h"
+#include "trace.h"
 #include "util.h"
 
 
@@ -46,6 +50,10 @@ int JJ2Level::step () {
 	int x;
 	int msps;
 
+	TRACE_SCOPE("JJ2Level::step");
+	PROFILE_SCOPE(PP_STEP);
+	PROFILE_START(timer);
+
 
 	// Milliseconds per step
 	msps = T_STEP;
@@ -54,15 +62,21 @@ int JJ2Level::step () {
 	// Determine the players' trajectories
 	for (x = 0; x < nPlayers; x++) players[x].getJJ2LevelPlayer()->control(ticks, msps);
 
+	PROFILE_MARK(timer, PP_PLAYERS);
+
 
 	// Process events
 	if (events) events = events->step(ticks, msps);
 
+	PROFILE_MARK(timer, PP_EVENTS);
+
 
 	// Apply as much of those trajectories as possible, without going into the
 	// scenery
 	for (x = 0; x < nPlayers; x++) players[x].getJJ2LevelPlayer()->move(ticks, msps);
 
+	PROFILE_MARK(timer, PP_PLAYERS);
+
 
 
 	// Handle change in water level
@@ -102,6 +116,8 @@ void JJ2Level::draw () {
 	int x, y;
 	unsigned int change;
 
+	TRACE_SCOPE("JJ2Level::draw");
+
 
 	width = layer->getWidth();
 	height = layer->getHeight();
@@ -112,7 +128,8 @@ void JJ2Level::draw () {
 
 
 	// Calculate viewport
-	if (game && (stage == LS_END)) game->view(paused? 0: ((ticks - prevTicks) * 160));
+	if (benchmark.isRunning()) benchmark.view(TTOI(width) - canvasW, TTOI(height) - canvasH);
+	else if (game && (stage == LS_END)) game->view(paused? 0: ((ticks - prevTicks) * 160));
 	else localPlayer->getJJ2LevelPlayer()->view(ticks, paused? 0: (ticks - prevTicks), change);
 
 	// Ensure the new viewport is within the level
@@ -121,18 +138,25 @@ void JJ2Level::draw () {
 	if (FTOI(viewY) + canvasH >= TTOI(height)) viewY = ITOF(TTOI(height) - canvasH);
 	if (viewY < 0) viewY = 0;
 
+	// Hear sound effects from the centre of the viewport
+	setSoundListener(viewX + ITOF(canvasW >> 1), viewY + ITOF(canvasH >> 1));
+
 
 	// Show background layers
 	for (x = 7; x >= 3; x--) layers[x]->draw(tileSet, flippedTileSet);
 
 
 	// Show the events
+	PROFILE_START(timer);
+
 	if (events) events->draw(ticks, change);
 
 
 	// Show the players
 	for (x = 0; x < nPlayers; x++) players[x].getJJ2LevelPlayer()->draw(ticks, change);
 
+	PROFILE_MARK(timer, PP_SPRITES);
+
 
 	// Show foreground layers
 	for (x = 2; x >= 0; x--) layers[x]->draw(tileSet, flippedTileSet);
@@ -35,6 +35,7 @@
 #include "io/gfx/video.h"
 #include "io/sound.h"
 #include "loop.h"
+#include "trace.h"
 #include "util.h"
 
 #include <string.h>
@@ -156,6 +157,8 @@ int JJ2Level::loadSprites () {
 	int setAnims, nSprites, animSprites;
 	int set, anim, sprite, setSprite;
 
+	TRACE_SCOPE("JJ2Level::loadSprites");
+
 	// Thanks to Neobeo for working out the .j2a format
 
 
@@ -298,6 +301,8 @@ int JJ2Level::loadTiles (char* fileName) {
 	int maxTiles;
 	int tiles;
 
+	TRACE_SCOPE("JJ2Level::loadTiles");
+
 	// Thanks to Neobeo for working out the most of the .j2t format
 
 
@@ -555,6 +560,8 @@ int JJ2Level::load (char *fileName, bool checkpoint) {
 	fixed xSpeed, ySpeed;
 	unsigned char startX, startY;
 
+	TRACE_SCOPE("JJ2Level::load");
+
 	// Thanks to Neobeo for working out the most of the .j2l format
 
 
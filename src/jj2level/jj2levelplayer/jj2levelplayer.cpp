@@ -290,7 +290,7 @@ bool JJ2LevelPlayer::hit (Player *source, unsigned int ticks) {
 
 		//if (bird) bird->hit();
 
-		playSound(S_OW);
+		playSoundAt(S_OW, x, y);
 
 	}
 
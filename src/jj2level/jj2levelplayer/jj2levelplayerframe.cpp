@@ -248,6 +248,8 @@ void JJ2LevelPlayer::control (unsigned int ticks, int msps) {
 	bool drop, platform;
 
 
+	savePosition();
+
 	// If the player has been killed, do not move
 	if (!energy) {
 
@@ -421,7 +423,7 @@ void JJ2LevelPlayer::control (unsigned int ticks, int msps) {
 
 			event = JJ2PE_NONE;
 
-			playSound(S_JUMPA);
+			playSoundAt(S_JUMPA, x, y);
 
 		}
 
@@ -830,8 +832,8 @@ void JJ2LevelPlayer::view (unsigned int ticks, int mspf, int change) {
 
 	// Find new position
 
-	viewX = x + ((dx * change) >> 10) + F8 - (canvasW << 9);
-	viewY = y + ((dy * change) >> 10) - F24 - (canvasH << 9);
+	viewX = getStepX(change) + F8 - (canvasW << 9);
+	viewY = getStepY(change) - F24 - (canvasH << 9);
 
 	if ((lookTime > 0) && ((int)ticks > 1000 + lookTime)) {
 
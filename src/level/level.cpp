@@ -27,7 +27,9 @@
 
 
 #include "level.h"
+#include "replay.h"
 
+#include "benchmark.h"
 #include "game/game.h"
 #include "io/controls.h"
 #include "io/gfx/font.h"
@@ -37,7 +39,11 @@
 #include "player/player.h"
 #include "jj1scene/jj1scene.h"
 #include "loop.h"
+#include "profiler.h"
 #include "setup.h"
+#include "trace.h"
+
+#include <string.h>
 
 
 /**
@@ -56,6 +62,9 @@ Level::Level (Game* owner) {
 	// Arbitrary initial value
 	smoothfps = 50.0f;
 
+	frameSteps = lastFrameSteps = 0;
+	droppedTicks = 0;
+
 	paletteEffects = NULL;
 
 	paused = false;
@@ -128,6 +137,9 @@ int Level::playScene (const char* file) {
 	delete paletteEffects;
 	paletteEffects = NULL;
 
+	// Cutscenes have no effect on the simulation
+	if (headless) return E_NONE;
+
 	try {
 
 		scene = new JJ1Scene(file);
@@ -170,16 +182,24 @@ void Level::timeCalcs () {
 	if (smoothfps < 1.0f) smoothfps = 1.0f;
 
 
+	// Start counting the new frame's steps
+	lastFrameSteps = frameSteps;
+	frameSteps = 0;
+
+
 	// Track number of ticks of gameplay since the level started
 
 	if (paused) {
 
 		tickOffset = globalTicks - ticks;
 
-	} else if (globalTicks - tickOffset > ticks + 100) {
+	} else if (globalTicks - tickOffset > ticks + T_FRAME_MAX) {
+
+		// Drop the excess, rather than trying to catch up with it
+		droppedTicks += globalTicks - tickOffset - (ticks + T_FRAME_MAX);
 
 		prevTicks = ticks;
-		ticks += 100;
+		ticks += T_FRAME_MAX;
 
 		tickOffset = globalTicks - ticks;
 
@@ -190,19 +210,154 @@ void Level::timeCalcs () {
 
 	}
 
+	frameTicks = ticks;
+
 	return;
 
 }
 
 
 /**
- * Calculate the amount of time since the last completed step.
+ * Calculate the time at which the given step ended.
+ *
+ * @param step The number of the step
+ *
+ * @return The level time
+ */
+unsigned int Level::getStepTicks (unsigned int step) {
+
+	return (step * 1000) / (setup.slowMotion? STEP_RATE >> 1: STEP_RATE);
+
+}
+
+
+/**
+ * Calculate how far the current time is through the step after the last
+ * completed step, for drawing between the positions at the ends of the last
+ * two steps.
  *
- * @return Time since last step
+ * @return Time since last step, out of T_STEP
  */
 int Level::getTimeChange () {
 
-	return paused? 0: ticks - ((steps * (setup.slowMotion? 100: 50)) / 3);
+	unsigned int start;
+	int change;
+
+	// While paused, show the latest positions
+	if (paused) return T_STEP;
+
+	start = getStepTicks(steps);
+
+	if ((int)(ticks - start) <= 0) return 0;
+
+	change = ((ticks - start) * T_STEP) / (getStepTicks(steps + 1) - start);
+
+	return (change > T_STEP)? T_STEP: change;
+
+}
+
+
+/**
+ * Add a value to a checksum.
+ *
+ * @param checksum The checksum so far
+ * @param value The value
+ *
+ * @return The new checksum
+ */
+unsigned int Level::addChecksum (unsigned int checksum, int value) {
+
+	// FNV-1a, one byte at a time
+	checksum = (checksum ^ (value & 255)) * 16777619u;
+	checksum = (checksum ^ ((value >> 8) & 255)) * 16777619u;
+	checksum = (checksum ^ ((value >> 16) & 255)) * 16777619u;
+	checksum = (checksum ^ ((value >> 24) & 255)) * 16777619u;
+
+	return checksum;
+
+}
+
+
+/**
+ * Calculate a checksum of the state of the players and the level, for checking
+ * that a replay matches its recording.
+ *
+ * The ending sequence is paced by frames rather than by steps, so the state is
+ * not checked during it.
+ *
+ * @return The checksum
+ */
+unsigned int Level::getChecksum () {
+
+	unsigned char buffer[MTL_P_TEMP];
+	unsigned int checksum;
+	int count, byte;
+
+	if (stage == LS_END) return 0;
+
+	// FNV-1a hash of the data which would be sent to other players
+	checksum = 2166136261u;
+
+	for (count = 0; count < nPlayers; count++) {
+
+		memset(buffer, 0, MTL_P_TEMP);
+		players[count].send(buffer);
+
+		for (byte = 3; byte < MTL_P_TEMP; byte++)
+			checksum = (checksum ^ buffer[byte]) * 16777619u;
+
+	}
+
+	return getStateChecksum(checksum);
+
+}
+
+
+/**
+ * Determine whether or not another step should be taken in the current frame.
+ *
+ * While a step is due, the level time is set to the time of that step, so that
+ * the outcome of each step does not depend on the frame rate. Once all due
+ * steps have been taken, the frame's own time is restored.
+ *
+ * If more steps are due than the frame is allowed to take, the remaining
+ * simulation time is dropped. Gameplay then slows down, instead of every
+ * following frame also having to catch up.
+ *
+ * @return Whether or not to take a step
+ */
+bool Level::stepDue () {
+
+	unsigned int next;
+	int change;
+
+	ticks = frameTicks;
+
+	if (paused) return false;
+
+	// Time at which the next step ends
+	next = getStepTicks(steps + 1);
+
+	if ((int)(ticks - next) < 0) return false;
+
+	if (frameSteps >= setup.maxFrameSteps) {
+
+		// Drop all but the last (incomplete) step's worth of time
+		change = ticks - next + 1;
+
+		droppedTicks += change;
+		tickOffset += change;
+		ticks = frameTicks = frameTicks - change;
+
+		return false;
+
+	}
+
+	frameSteps++;
+
+	ticks = next;
+
+	return true;
 
 }
 
@@ -222,18 +377,22 @@ void Level::drawOverlay (unsigned char bg, bool menu, int option,
 	int textPalSpan) {
 
 	const char* difficultyOptions[4] = {"easy", "medium", "hard", "turbo"};
-	int count, width;
+	const NetStats* netStats;
+	int count, width, height, bandwidth;
 
 	// Draw graphics statistics
 
 	if (stats & S_SCREEN) {
 
+		height = 85;
+
 #ifdef SCALE
-		if (video.getScaleFactor() > 1)
-			drawRect(canvasW - 84, 11, 80, 37, bg);
-		else
+		if (video.getScaleFactor() > 1) height += 12;
 #endif
-			drawRect(canvasW - 84, 11, 80, 25, bg);
+
+		if (multiplayer) height += 48;
+
+		drawRect(canvasW - 84, 11, 80, height, bg);
 
 		panelBigFont->showNumber(video.getWidth(), canvasW - 52, 14);
 		panelBigFont->showString("x", canvasW - 48, 14);
@@ -241,16 +400,51 @@ void Level::drawOverlay (unsigned char bg, bool menu, int option,
 		panelBigFont->showString("fps", canvasW - 76, 26);
 		panelBigFont->showNumber((int)smoothfps, canvasW - 12, 26);
 
+		// Simulation scheduling
+		panelBigFont->showString("steps", canvasW - 76, 38);
+		panelBigFont->showNumber(lastFrameSteps, canvasW - 12, 38);
+		panelBigFont->showString("drop", canvasW - 76, 50);
+		panelBigFont->showNumber(droppedTicks, canvasW - 12, 50);
+
+		// Audio output
+		panelBigFont->showString("audio", canvasW - 76, 62);
+		panelBigFont->showNumber(getAudioCallbackTime(), canvasW - 12, 62);
+		panelBigFont->showString("late", canvasW - 76, 74);
+		panelBigFont->showNumber(getLateAudioCallbacks(), canvasW - 12, 74);
+		panelBigFont->showString("under", canvasW - 76, 86);
+		panelBigFont->showNumber(getAudioUnderruns(), canvasW - 12, 86);
+
 #ifdef SCALE
 		if (video.getScaleFactor() > 1) {
 
-			panelBigFont->showNumber(canvasW, canvasW - 52, 38);
-			panelBigFont->showString("x", canvasW - 48, 39);
-			panelBigFont->showNumber(canvasH, canvasW - 12, 38);
+			panelBigFont->showNumber(canvasW, canvasW - 52, 98);
+			panelBigFont->showString("x", canvasW - 48, 99);
+			panelBigFont->showNumber(canvasH, canvasW - 12, 98);
 
 		}
 #endif
 
+		// Data passed during the last network step
+		if (multiplayer) {
+
+			netStats = game->getNetStats();
+
+			panelBigFont->showString("net in", canvasW - 76, height - 35);
+			panelBigFont->showNumber(netStats->bytes, canvasW - 12, height - 35);
+			panelBigFont->showString("msgs", canvasW - 76, height - 23);
+			panelBigFont->showNumber(netStats->messages, canvasW - 12, height - 23);
+			panelBigFont->showString("backlog", canvasW - 76, height - 11);
+			panelBigFont->showNumber(netStats->backlog, canvasW - 12, height - 11);
+			panelBigFont->showString("net out", canvasW - 76, height + 1);
+			panelBigFont->showNumber(netStats->sent, canvasW - 12, height + 1);
+
+		}
+
+#ifdef PROFILE
+		// Time taken by each phase of the frame
+		profiler.draw(4, 11, bg, textPalIndex);
+#endif
+
 	}
 
 	// Draw player list
@@ -258,12 +452,19 @@ void Level::drawOverlay (unsigned char bg, bool menu, int option,
 	if (stats & S_PLAYERS) {
 
 		width = 39;
+		bandwidth = 0;
+
+		for (count = 0; count < nPlayers; count++) {
 
-		for (count = 0; count < nPlayers; count++)
 			if (panelBigFont->getStringWidth(players[count].getName()) > width)
 				width = panelBigFont->getStringWidth(players[count].getName());
 
-		drawRect((canvasW >> 1) - 48, 11, width + 57, (nPlayers * 12) + 1, bg);
+			// Make room for bandwidth figures, when hosting
+			if (game->getBandwidth(count) >= 0) bandwidth = 48;
+
+		}
+
+		drawRect((canvasW >> 1) - 48, 11, width + 57 + bandwidth, (nPlayers * 12) + 1, bg);
 
 		for (count = 0; count < nPlayers; count++) {
 
@@ -274,6 +475,11 @@ void Level::drawOverlay (unsigned char bg, bool menu, int option,
 			panelBigFont->showNumber(players[count].teamScore,
 				(canvasW >> 1) + width + 1, 14 + (count * 12));
 
+			// Bytes per second sent to the player's client
+			if (game->getBandwidth(count) >= 0)
+				panelBigFont->showNumber(game->getBandwidth(count),
+					(canvasW >> 1) + width + 1 + bandwidth, 14 + (count * 12));
+
 		}
 
 	}
@@ -390,6 +596,8 @@ int Level::loop (bool& menu, int& option, bool& message) {
 
 	int ret, x, y;
 
+	TRACE_SCOPE("Level::loop");
+
 	// Networking
 	if (multiplayer) {
 
@@ -403,6 +611,12 @@ int Level::loop (bool& menu, int& option, bool& message) {
 	// Main loop
 	if (::loop(NORMAL_LOOP, paletteEffects, paused) == E_QUIT) return E_QUIT;
 
+	// End when a replay has been played through
+	if (replay.isFinished()) return E_QUIT;
+
+	// End when the benchmark has measured enough frames
+	if (benchmark.endFrame()) return E_QUIT;
+
 
 	if (controls.release(C_ESCAPE)) {
 
@@ -42,8 +42,18 @@
 #define WON  1
 #define LOST 2
 
-// Time interval
-#define T_STEP 16
+// Time intervals
+#define T_STEP      16 /* Time by which each step moves things along */
+#define T_FRAME_MAX 100 /* Most level time a single frame may represent */
+
+// Simulation scheduling
+#define STEP_RATE       60 /* Steps per second (of level time) */
+#define MAX_FRAME_STEPS 4 /* Default for the most steps which may be taken in a single frame */
+
+// Size of the view used by the simulation, which is that of the original game
+// whatever the size of the window
+#define STEP_VIEW_W 320
+#define STEP_VIEW_H 200
 
 
 // Enums
@@ -101,7 +111,11 @@ class Level {
 		unsigned int   steps; ///< Number of steps taken
 		unsigned int   prevTicks; ///< Time the last visual update started
 		unsigned int   ticks; ///< Current time
+		unsigned int   frameTicks; ///< Time at which the current frame started
 		unsigned int   endTime; ///< Tick at which the level will end
+		unsigned int   droppedTicks; ///< Amount of simulation time dropped to keep up
+		int            frameSteps; ///< Number of steps taken during the current frame
+		int            lastFrameSteps; ///< Number of steps taken during the previous frame
 		float          smoothfps; ///< Smoothed FPS counter
 		int            items; ///< Number of items to be collected
 		bool           multiplayer; ///< Whether or not this is a multiplayer game
@@ -111,13 +125,19 @@ class Level {
 
 		void createLevelPlayers (LevelType levelType, Anim** anims, Anim** flippedAnims, bool checkpoint, unsigned char x, unsigned char y);
 
-		int  playScene     (const char* file);
-		void timeCalcs     ();
-		int  getTimeChange ();
-		void drawOverlay   (unsigned char bg, bool menu, int option,
+		int          playScene     (const char* file);
+		void         timeCalcs     ();
+		unsigned int getStepTicks  (unsigned int step);
+		int          getTimeChange ();
+		bool         stepDue       ();
+		unsigned int addChecksum   (unsigned int checksum, int value);
+		unsigned int getChecksum   ();
+		void         drawOverlay   (unsigned char bg, bool menu, int option,
 			unsigned char textPalIndex, unsigned char selectedTextPalIndex,
 			int textPalSpan);
-		int  loop          (bool& menu, int& option, bool& message);
+		int          loop          (bool& menu, int& option, bool& message);
+
+		virtual unsigned int getStateChecksum (unsigned int checksum) = 0;
 
 	public:
 		Level          (Game* owner);
@@ -134,6 +154,7 @@ class Level {
 // Variables
 
 EXTERN fixed      viewX, viewY; ///< Level viewing co-ordinates
+EXTERN fixed      stepViewX, stepViewY; ///< Viewing co-ordinates used by the level simulation
 
 #endif
 
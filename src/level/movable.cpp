@@ -17,6 +17,10 @@
  * @par Description:
  * Contains the base class for all movable objects.
  *
+ * Movables are drawn between their positions at the ends of the last two
+ * steps, so that they move smoothly whatever the frame rate, and are never
+ * drawn somewhere the simulation would not have let them go.
+ *
  */
 
 
@@ -24,17 +28,79 @@
 #include "movable.h"
 
 
+/**
+ * Create a Movable with no previous position.
+ */
+Movable::Movable () {
+
+	stepped = false;
+
+	return;
+
+}
+
+
+/**
+ * Remember the current position, at the start of a step which may change it.
+ */
+void Movable::savePosition () {
+
+	prevX = x;
+	prevY = y;
+	stepped = true;
+
+	return;
+
+}
+
+
+/**
+ * Derive the x-coordinate of the Movable part of the way from its position at
+ * the end of the previous step to its current position. Jumps of more than a
+ * tile are not smoothed.
+ *
+ * @param change Time since last step, out of T_STEP
+ *
+ * @return The x-coordinate
+ */
+fixed Movable::getStepX (int change) {
+
+	if (!stepped || (x - prevX > F32) || (prevX - x > F32)) return x;
+
+	return prevX + (((x - prevX) * change) / T_STEP);
+
+}
+
+
+/**
+ * Derive the y-coordinate of the Movable part of the way from its position at
+ * the end of the previous step to its current position. Jumps of more than a
+ * tile are not smoothed.
+ *
+ * @param change Time since last step, out of T_STEP
+ *
+ * @return The y-coordinate
+ */
+fixed Movable::getStepY (int change) {
+
+	if (!stepped || (y - prevY > F32) || (prevY - y > F32)) return y;
+
+	return prevY + (((y - prevY) * change) / T_STEP);
+
+}
+
+
 /**
  * Derive the x-coordinate of the Movable relative to the view coordinates for
  * the current time.
  *
- * @param change Time since last step
+ * @param change Time since last step, out of T_STEP
  *
  * @return The x-coordinate
  */
 fixed Movable::getDrawX (int change) {
 
-	return x + ((dx * change) >> 10) - viewX;
+	return getStepX(change) - viewX;
 
 }
 
@@ -43,13 +109,13 @@ fixed Movable::getDrawX (int change) {
  * Derive the y-coordinate of the Movable relative to the view coordinates for
  * the current time.
  *
- * @param change Time since last step
+ * @param change Time since last step, out of T_STEP
  *
  * @return The y-coordinate
  */
 fixed Movable::getDrawY (int change) {
 
-	return y + ((dy * change) >> 10) - viewY;
+	return getStepY(change) - viewY;
 
 }
 
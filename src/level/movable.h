@@ -31,11 +31,19 @@ class Movable {
 
 	protected:
 		fixed x, y, dx, dy;
+		fixed prevX; ///< X-coordinate at the end of the previous step
+		fixed prevY; ///< Y-coordinate at the end of the previous step
+		bool  stepped; ///< Whether or not the previous position is known
 
-		fixed getDrawX (int change);
-		fixed getDrawY (int change);
+		void  savePosition ();
+		fixed getStepX     (int change);
+		fixed getStepY     (int change);
+		fixed getDrawX     (int change);
+		fixed getDrawY     (int change);
 
 	public:
+		Movable ();
+
 		fixed getX ();
 		fixed getY ();
 
@@ -0,0 +1,597 @@
+
+/**
+ *
+ * @file replay.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 18th October 2026: Created replay.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2026 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Deals with the recording and playback of control input.
+ *
+ * A replay holds every change in the state of the controls used by the level
+ * simulation, along with the step at which it happened. Steps are counted from
+ * the start of each level, so a replay stays in step with the game even though
+ * the end of a level is paced by frames. A checksum of the level state is
+ * recorded every REPLAY_CHECK_STEPS steps, and compared during playback.
+ *
+ */
+
+
+#include "replay.h"
+
+#include "io/file.h"
+#include "setup.h"
+#include "util.h"
+
+#include <string.h>
+
+
+/**
+ * Write a number using as few bytes as possible.
+ *
+ * @param file File to write to
+ * @param val The number
+ */
+static void storeVarInt (File* file, unsigned int val) {
+
+	while (val >= 128) {
+
+		file->storeChar((val & 127) | 128);
+		val >>= 7;
+
+	}
+
+	file->storeChar(val);
+
+	return;
+
+}
+
+
+/**
+ * Read a number written by storeVarInt().
+ *
+ * @param file File to read from
+ *
+ * @return The number
+ */
+static unsigned int loadVarInt (File* file) {
+
+	unsigned int val;
+	int shift, byte;
+
+	val = 0;
+	shift = 0;
+
+	do {
+
+		byte = file->loadChar();
+		val |= (byte & 127) << shift;
+		shift += 7;
+
+	} while ((byte & 128) && (shift < 32));
+
+	return val;
+
+}
+
+
+/**
+ * Create an inactive replay.
+ */
+Replay::Replay () {
+
+	mode = RM_NONE;
+	active = false;
+	fileName = NULL;
+	levelFile = NULL;
+	events = NULL;
+	nEvents = maxEvents = 0;
+
+	return;
+
+}
+
+
+/**
+ * Delete the replay.
+ */
+Replay::~Replay () {
+
+	if (fileName) delete[] fileName;
+	if (levelFile) delete[] levelFile;
+	if (events) delete[] events;
+
+	return;
+
+}
+
+
+/**
+ * Add an event at the current step.
+ *
+ * @param type Control number, or RE_CHECKSUM, RE_LEVEL or RE_END
+ * @param value State of the control, or the level state checksum
+ */
+void Replay::addEvent (unsigned char type, unsigned int value) {
+
+	ReplayEvent* newEvents;
+
+	if (nEvents == maxEvents) {
+
+		// Expand the event array
+		maxEvents = maxEvents? maxEvents << 1: 256;
+		newEvents = new ReplayEvent[maxEvents];
+
+		if (events) {
+
+			memcpy(newEvents, events, nEvents * sizeof(ReplayEvent));
+			delete[] events;
+
+		}
+
+		events = newEvents;
+
+	}
+
+	events[nEvents].step = step;
+	events[nEvents].type = type;
+	events[nEvents].value = value;
+	nEvents++;
+
+	return;
+
+}
+
+
+/**
+ * Write the recorded game to the replay file.
+ *
+ * @return Error code
+ */
+int Replay::save () {
+
+	File* file;
+	unsigned int prevStep;
+	int count;
+
+	try {
+
+		file = new File(fileName, true);
+
+	} catch (int e) {
+
+		logError("Could not write replay", fileName);
+
+		return e;
+
+	}
+
+	// Header
+	file->storeChar('O');
+	file->storeChar('J');
+	file->storeChar('R');
+	file->storeChar(REPLAY_VERSION);
+
+	file->storeChar(strlen(levelFile));
+
+	for (count = 0; levelFile[count]; count++)
+		file->storeChar(levelFile[count]);
+
+	file->storeChar(difficulty);
+	file->storeChar(slowMotion);
+
+	// Events, with control changes packed into a single byte
+	file->storeInt(nEvents);
+
+	prevStep = 0;
+
+	for (count = 0; count < nEvents; count++) {
+
+		if (events[count].type == RE_LEVEL) prevStep = 0;
+
+		storeVarInt(file, events[count].step - prevStep);
+		prevStep = events[count].step;
+
+		if (events[count].type < CONTROLS) {
+
+			file->storeChar((events[count].type << 1) | events[count].value);
+
+		} else {
+
+			file->storeChar(events[count].type);
+
+			if (events[count].type == RE_CHECKSUM)
+				file->storeInt(events[count].value);
+
+		}
+
+	}
+
+	delete file;
+
+	log("Saved replay", fileName);
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Record the next single-player game.
+ *
+ * @param newFileName File to which the replay will be written
+ *
+ * @return Error code
+ */
+int Replay::record (const char* newFileName) {
+
+	if (active) return E_DATA;
+
+	if (fileName) delete[] fileName;
+	fileName = createString(newFileName);
+
+	mode = RM_RECORD;
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Load a replay, to be played back by the next single-player game.
+ *
+ * @param newFileName Replay file name
+ *
+ * @return Error code
+ */
+int Replay::load (const char* newFileName) {
+
+	File* file;
+	unsigned int prevStep;
+	int count, length, type;
+
+	if (active) return E_DATA;
+
+	try {
+
+		file = new File(newFileName, false);
+
+	} catch (int e) {
+
+		return e;
+
+	}
+
+	// Check the header
+	if ((file->loadChar() != 'O') || (file->loadChar() != 'J') ||
+		(file->loadChar() != 'R')) {
+
+		delete file;
+
+		return E_DATA;
+
+	}
+
+	if (file->loadChar() != REPLAY_VERSION) {
+
+		delete file;
+
+		return E_VERSION;
+
+	}
+
+	if (fileName) delete[] fileName;
+	fileName = createString(newFileName);
+
+	if (levelFile) delete[] levelFile;
+	length = file->loadChar();
+	levelFile = new char[length + 1];
+
+	for (count = 0; count < length; count++) levelFile[count] = file->loadChar();
+	levelFile[length] = 0;
+
+	difficulty = file->loadChar();
+	slowMotion = file->loadChar();
+
+	// Load events
+	length = file->loadInt();
+
+	nEvents = 0;
+	step = 0;
+	prevStep = 0;
+
+	for (count = 0; count < length; count++) {
+
+		step = prevStep + loadVarInt(file);
+		type = file->loadChar();
+
+		if (type == RE_LEVEL) step = 0;
+		prevStep = step;
+
+		if (type == RE_CHECKSUM) addEvent(type, file->loadInt());
+		else if (type >= RE_LEVEL) addEvent(type, 0);
+		else if ((type >> 1) < CONTROLS) addEvent(type >> 1, type & 1);
+
+	}
+
+	delete file;
+
+	mode = RM_PLAY;
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Get the replay mode.
+ *
+ * @return Recording, playing or neither
+ */
+ReplayMode Replay::getMode () {
+
+	return mode;
+
+}
+
+
+/**
+ * Get the file name of the first level of the recorded game.
+ *
+ * @return The level's file name
+ */
+const char* Replay::getLevelFile () {
+
+	return levelFile;
+
+}
+
+
+/**
+ * Get the difficulty setting of the recorded game.
+ *
+ * @return The difficulty setting
+ */
+int Replay::getDifficulty () {
+
+	return difficulty;
+
+}
+
+
+/**
+ * Determine whether or not playback has reached the end of the recording.
+ *
+ * @return True if the recording has ended
+ */
+bool Replay::isFinished () {
+
+	return active && (mode == RM_PLAY) && (position >= nEvents);
+
+}
+
+
+/**
+ * Determine whether or not the step being taken ends with a check of the level
+ * state, so the checksum is only calculated when it is needed.
+ *
+ * @return True if endStep() will use the checksum
+ */
+bool Replay::isCheckDue () {
+
+	return active && !((step + 1) % REPLAY_CHECK_STEPS);
+
+}
+
+
+/**
+ * Start recording or playing back a game.
+ *
+ * @param firstLevel File name of the first level of the game
+ * @param gameDifficulty Difficulty setting of the game
+ */
+void Replay::start (const char* firstLevel, int gameDifficulty) {
+
+	int count;
+
+	if ((mode == RM_NONE) || active) return;
+
+	savedSlowMotion = setup.slowMotion;
+
+	if (mode == RM_RECORD) {
+
+		if (levelFile) delete[] levelFile;
+		levelFile = createString(firstLevel);
+
+		difficulty = gameDifficulty;
+		slowMotion = setup.slowMotion;
+
+		nEvents = 0;
+
+	} else {
+
+		// Simulate at the recorded speed
+		setup.slowMotion = slowMotion;
+
+	}
+
+	for (count = 0; count < CONTROLS; count++) states[count] = false;
+
+	position = 0;
+	step = 0;
+	checks = mismatches = 0;
+	active = true;
+
+	return;
+
+}
+
+
+/**
+ * Start recording or playing back the next level.
+ */
+void Replay::beginLevel () {
+
+	int count;
+
+	if (!active) return;
+
+	step = 0;
+
+	for (count = 0; count < CONTROLS; count++) states[count] = false;
+
+	if (mode == RM_RECORD) {
+
+		addEvent(RE_LEVEL, 0);
+
+	} else {
+
+		// Skip anything left over from the previous level
+		while ((position < nEvents) && (events[position].type != RE_LEVEL))
+			position++;
+
+		if (position < nEvents) position++;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Get the state of a control for the current step.
+ *
+ * When recording, changes in the state of the control are recorded. When
+ * playing, the recorded state is used instead.
+ *
+ * @param control The control
+ *
+ * @return The state of the control
+ */
+bool Replay::getState (int control) {
+
+	bool state;
+
+	if (!active) return controls.getState(control);
+
+	if (mode == RM_RECORD) {
+
+		state = controls.getState(control);
+
+		if (state != states[control]) {
+
+			addEvent(control, state);
+			states[control] = state;
+
+		}
+
+		return state;
+
+	}
+
+	// Apply recorded changes up to the current step
+	while ((position < nEvents) && (events[position].type < CONTROLS) &&
+		(events[position].step <= step)) {
+
+		states[events[position].type] = events[position].value;
+		position++;
+
+	}
+
+	return states[control];
+
+}
+
+
+/**
+ * Finish the current step.
+ *
+ * @param checksum Checksum of the level state after the step
+ */
+void Replay::endStep (unsigned int checksum) {
+
+	if (!active) return;
+
+	// Apply any changes to controls which were not checked during the step
+	if (mode == RM_PLAY) getState(0);
+
+	step++;
+
+	if (mode == RM_RECORD) {
+
+		if (!(step % REPLAY_CHECK_STEPS)) addEvent(RE_CHECKSUM, checksum);
+
+		return;
+
+	}
+
+	// Skip checksums which have been missed
+	while ((position < nEvents) && (events[position].type == RE_CHECKSUM) &&
+		(events[position].step < step))
+		position++;
+
+	if ((position < nEvents) && (events[position].type == RE_CHECKSUM) &&
+		(events[position].step == step)) {
+
+		if (events[position].value != checksum) {
+
+			if (!mismatches) log("Replay diverged at level step", step);
+
+			mismatches++;
+
+		}
+
+		checks++;
+		position++;
+
+	}
+
+	// Check for the end of the recording
+	if ((position < nEvents) && (events[position].type == RE_END) &&
+		(events[position].step <= step))
+		position = nEvents;
+
+	return;
+
+}
+
+
+/**
+ * Finish recording or playing back the game.
+ */
+void Replay::finish () {
+
+	if (!active) return;
+
+	if (mode == RM_RECORD) {
+
+		addEvent(RE_END, 0);
+		save();
+
+	} else {
+
+		log("Replay checksums compared", checks);
+		log("Replay checksums mismatched", mismatches);
+
+		setup.slowMotion = savedSlowMotion;
+
+	}
+
+	active = false;
+	mode = RM_NONE;
+
+	return;
+
+}
+
@@ -0,0 +1,115 @@
+
+/**
+ *
+ * @file replay.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 18th October 2026: Created replay.h
+ *
+ * @par Licence:
+ * Copyright (c) 2026 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _REPLAY_H
+#define _REPLAY_H
+
+
+#include "OpenJazz.h"
+
+#include "io/controls.h"
+
+
+// Constants
+
+#define REPLAY_VERSION     4
+#define REPLAY_CHECK_STEPS 60 /* Steps between level state checksums */
+
+// Replay event types (control changes use the control number)
+#define RE_CHECKSUM 0xFD
+#define RE_LEVEL    0xFE
+#define RE_END      0xFF
+
+
+// Enum
+
+/// What is being done with the replay
+enum ReplayMode {
+
+	RM_NONE, ///< Neither recording nor playing
+	RM_RECORD, ///< Recording the next game
+	RM_PLAY ///< Playing back a recorded game
+
+};
+
+
+// Datatype
+
+/// Recorded event
+typedef struct {
+
+	unsigned int  step; ///< Step (within the level) at which the event occurs
+	unsigned char type; ///< Control number, or RE_CHECKSUM, RE_LEVEL or RE_END
+	unsigned int  value; ///< State of the control, or the level state checksum
+
+} ReplayEvent;
+
+
+// Class
+
+/// Records and plays back the control input of a single-player game
+class Replay {
+
+	private:
+		ReplayMode   mode; ///< Recording, playing or neither
+		bool         active; ///< Whether or not a game is being recorded or played
+		char*        fileName; ///< Replay file name
+		char*        levelFile; ///< File name of the first level of the game
+		int          difficulty; ///< Difficulty setting of the game
+		bool         slowMotion; ///< Slow motion setting of the game
+		bool         savedSlowMotion; ///< Slow motion setting to restore when finished
+		ReplayEvent* events; ///< Recorded events
+		int          nEvents; ///< Number of recorded events
+		int          maxEvents; ///< Capacity of the event array
+		int          position; ///< Index of the next event to be played
+		unsigned int step; ///< Steps taken in the current level
+		bool         states[CONTROLS]; ///< Current states of the controls
+		int          checks; ///< Number of checksums compared
+		int          mismatches; ///< Number of checksums which did not match
+
+		void addEvent (unsigned char type, unsigned int value);
+		int  save     ();
+
+	public:
+		Replay  ();
+		~Replay ();
+
+		int         record        (const char* newFileName);
+		int         load          (const char* newFileName);
+		ReplayMode  getMode       ();
+		const char* getLevelFile  ();
+		int         getDifficulty ();
+		bool        isFinished    ();
+		bool        isCheckDue    ();
+
+		void        start         (const char* firstLevel, int gameDifficulty);
+		void        beginLevel    ();
+		bool        getState      (int control);
+		void        endStep       (unsigned int checksum);
+		void        finish        ();
+
+};
+
+
+// Variable
+
+EXTERN Replay replay; ///< Control input recording and playback
+
+#endif
+
@@ -0,0 +1,713 @@
+
+/**
+ *
+ * @file loadtest.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 18th October 2026: Created loadtest.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2026 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Bot clients for load testing a dedicated server. Each bot connects over
+ * TCP, joins the game the way a real client does, downloads every level, and
+ * then sends player updates at the client rate. The controls follow a fixed
+ * pattern, offset for each bot, and the position wanders around the first
+ * other player seen. Animations received from other players are sent back as
+ * the bot's own, so that the indices are valid for the level.
+ *
+ * Each bot measures its latency by sending MT_G_PING messages, which the
+ * server returns. The traffic and latency of the bots are summarised
+ * periodically, and for each bot when they stop.
+ *
+ */
+
+
+#include "loadtest.h"
+
+#include "io/gfx/video.h"
+#include "util.h"
+
+#include <SDL.h>
+#include <stdio.h>
+#include <string.h>
+
+
+// Control pattern
+
+#define BOT_PATTERN 8 /* Number of entries in the control pattern */
+#define BOT_SPEED   F2 /* Distance moved per update while walking */
+
+/// Controls held by a bot in turn: up, down, left, right, jump, fire
+static const unsigned char pattern[BOT_PATTERN][6] = {
+	{0, 0, 0, 1, 0, 0},
+	{0, 0, 0, 1, 1, 0},
+	{0, 0, 0, 1, 0, 1},
+	{0, 0, 0, 0, 0, 0},
+	{0, 0, 1, 0, 0, 0},
+	{0, 0, 1, 0, 1, 0},
+	{0, 0, 1, 0, 0, 1},
+	{0, 1, 0, 0, 0, 0}
+};
+
+
+/**
+ * Create an unconnected bot.
+ */
+BotClient::BotClient () {
+
+	memset(&current, 0, sizeof(BotStats));
+	memset(&total, 0, sizeof(BotStats));
+
+	connectTime = endTime = 0;
+	index = 0;
+	connected = false;
+
+	return;
+
+}
+
+
+/**
+ * Connect to a server.
+ *
+ * @param newIndex Number of the bot
+ * @param address Address of the server
+ *
+ * @return Whether or not the bot connected
+ */
+bool BotClient::start (int newIndex, const char *address) {
+
+	int sock;
+	int count;
+
+	index = newIndex;
+
+	sock = net->connect(address);
+
+	if (sock < 0) {
+
+		log("Bot could not connect", index);
+
+		return false;
+
+	}
+
+	connection.open(sock);
+
+	snapshot.reset();
+
+	for (count = 0; count < MAX_PLAYERS; count++)
+		snapshots[count].reset();
+
+	memset(&current, 0, sizeof(BotStats));
+	memset(&total, 0, sizeof(BotStats));
+
+	connectTime = endTime = SDL_GetTicks();
+	sendTime = pingTime = animsTime = 0;
+	seed = index + 1;
+	clientID = player = -1;
+	x = y = 0;
+	connected = true;
+	downloading = joinSent = positioned = hasAnims = false;
+
+	return true;
+
+}
+
+
+/**
+ * Disconnect from the server.
+ */
+void BotClient::stop () {
+
+	if (!connected) return;
+
+	net->close(connection.getSocket());
+
+	endTime = SDL_GetTicks();
+	connected = false;
+
+	return;
+
+}
+
+
+/**
+ * Get the next number from the bot's random number generator.
+ *
+ * @return A number from 0 to 32767
+ */
+int BotClient::random () {
+
+	seed = (seed * 1103515245) + 12345;
+
+	return (seed >> 16) & 32767;
+
+}
+
+
+/**
+ * Process a message from the server.
+ *
+ * @param buffer The message. First byte indicates length.
+ */
+void BotClient::receive (unsigned char *buffer) {
+
+	unsigned char reply[BUFFER_LENGTH];
+	unsigned char temp[MTL_P_TEMP];
+	unsigned int latency;
+	int count;
+
+	switch (buffer[1]) {
+
+		case MT_G_PROPS:
+
+			if (buffer[0] < MTL_G_PROPS) break;
+
+			if (buffer[2] != NET_VERSION) {
+
+				log("Bot found a different server version", buffer[2]);
+
+				stop();
+
+				return;
+
+			}
+
+			clientID = buffer[7];
+
+			break;
+
+		case MT_G_LTYPE:
+
+			if (buffer[0] < MTL_G_LTYPE) break;
+
+			// An empty level means the run of levels has ended
+			if (!(buffer[7] | buffer[8] | buffer[9] | buffer[10])) break;
+
+			// Always download the level, so that the server has to send it
+			reply[0] = MTL_G_LREQ;
+			reply[1] = MT_G_LREQ;
+			reply[2] = 1;
+			connection.queue(reply);
+
+			downloading = true;
+
+			break;
+
+		case MT_G_LEVEL:
+
+			// Only the zero-length block, which is the last, matters
+			if (!downloading || (buffer[0] > MTL_G_LEVEL)) break;
+
+			downloading = false;
+			current.levels++;
+
+			if (joinSent) break;
+
+			// Add the bot's player to the game
+			reply[0] = MTL_G_PJOIN + strlen(BOT_NAME);
+			reply[1] = MT_G_PJOIN;
+			reply[2] = clientID;
+			reply[3] = 0; // Player's number, assigned by the server
+			reply[4] = 0; // Player's team, assigned by the server
+			memset(reply + 5, index & 127, 4);
+			memcpy(reply + 9, BOT_NAME, strlen(BOT_NAME) + 1);
+			connection.queue(reply);
+
+			// Report the original view size
+			reply[0] = MTL_G_VIEW;
+			reply[1] = MT_G_VIEW;
+			reply[2] = SW >> 8;
+			reply[3] = SW & 255;
+			reply[4] = SH >> 8;
+			reply[5] = SH & 255;
+			connection.queue(reply);
+
+			joinSent = true;
+
+			break;
+
+		case MT_G_PJOIN:
+
+			if ((buffer[0] >= MTL_G_PJOIN) && joinSent && (player == -1) &&
+				(buffer[2] == clientID)) player = buffer[3];
+
+			break;
+
+		case MT_G_PQUIT:
+
+			if (buffer[0] < MTL_G_PQUIT) break;
+
+			// Later players move down to fill the gap
+			if ((player != -1) && (buffer[2] < player)) player--;
+
+			for (count = 0; count < MAX_PLAYERS; count++)
+				snapshots[count].reset();
+
+			break;
+
+		case MT_G_PING:
+
+			if (buffer[0] < MTL_G_PING) break;
+
+			latency = getMicroTicks() -
+				((buffer[2] << 24) + (buffer[3] << 16) + (buffer[4] << 8) + buffer[5]);
+
+			current.pings++;
+			current.latency += latency;
+			if (latency > current.maxLatency) current.maxLatency = latency;
+
+			break;
+
+		case MT_P_ANIMS:
+
+			// Keep another player's animations to send as the bot's own
+			if ((buffer[0] > MTL_P_ANIMS) && (buffer[2] != player)) {
+
+				memcpy(anims, buffer, buffer[0]);
+				hasAnims = true;
+
+			}
+
+			break;
+
+		case MT_P_DELTA:
+
+			if (buffer[2] >= MAX_PLAYERS) break;
+
+			if (!snapshots[buffer[2]].decode(buffer, temp)) break;
+
+			// Start from the first other player's position, which is in the level
+			if (!positioned && (buffer[2] != player)) {
+
+				x = (temp[37] << 24) + (temp[38] << 16) + (temp[39] << 8) + temp[40];
+				y = (temp[41] << 24) + (temp[42] << 16) + (temp[43] << 8) + temp[44];
+				positioned = true;
+
+			}
+
+			break;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Send the bot's player properties.
+ *
+ * @param ticks Current time
+ */
+void BotClient::sendPlayer (unsigned int ticks) {
+
+	unsigned char temp[MTL_P_TEMP];
+	unsigned char buffer[BUFFER_LENGTH];
+	const unsigned char *controls;
+
+	controls = pattern[((ticks / T_BOT_PATTERN) + index) % BOT_PATTERN];
+
+	// Walk as the controls say, and wander a little
+	if (controls[2]) x -= BOT_SPEED;
+	if (controls[3]) x += BOT_SPEED;
+	x += (random() & 1023) - 512;
+	y += (random() & 1023) - 512;
+
+	if (x < 0) x = 0;
+	if (y < 0) y = 0;
+
+	memset(temp, 0, MTL_P_TEMP);
+	temp[0] = MTL_P_TEMP;
+	temp[1] = MT_P_TEMP;
+	temp[2] = player;
+	memcpy(temp + 3, controls, 6);
+	temp[23] = 4; // Energy
+	temp[24] = 3; // Lives
+	temp[27] = !controls[2]; // Facing
+	temp[37] = x >> 24;
+	temp[38] = (x >> 16) & 255;
+	temp[39] = (x >> 8) & 255;
+	temp[40] = x & 255;
+	temp[41] = y >> 24;
+	temp[42] = (y >> 16) & 255;
+	temp[43] = (y >> 8) & 255;
+	temp[44] = y & 255;
+
+	snapshot.encode(temp, buffer);
+	connection.queue(buffer);
+
+	return;
+
+}
+
+
+/**
+ * Receive and respond to messages from the server, and send whatever is due.
+ *
+ * @param ticks Current time
+ */
+void BotClient::step (unsigned int ticks) {
+
+	unsigned char buffer[MTL_G_PING];
+	unsigned char *message;
+	unsigned int now;
+
+	if (!connected) return;
+
+	connection.receive();
+
+	while (connected && (message = connection.getMessage())) receive(message);
+
+	if (!connected) return;
+
+	current.bytesIn += connection.getStats()->bytes;
+
+	if (player != -1) {
+
+		if (ticks >= sendTime) {
+
+			sendPlayer(ticks);
+			sendTime = ticks + T_CSEND;
+
+		}
+
+		if (hasAnims && (ticks >= animsTime)) {
+
+			anims[2] = player;
+			connection.queue(anims);
+			animsTime = ticks + T_BOT_ANIMS;
+
+		}
+
+	}
+
+	if ((clientID != -1) && (ticks >= pingTime)) {
+
+		// Notice the server going away
+		if (!net->isConnected(connection.getSocket())) {
+
+			log("Bot disconnected", index);
+
+			stop();
+
+			return;
+
+		}
+
+		now = getMicroTicks();
+
+		buffer[0] = MTL_G_PING;
+		buffer[1] = MT_G_PING;
+		buffer[2] = now >> 24;
+		buffer[3] = (now >> 16) & 255;
+		buffer[4] = (now >> 8) & 255;
+		buffer[5] = now & 255;
+		connection.queue(buffer);
+
+		pingTime = ticks + T_BOT_PING;
+
+	}
+
+	connection.flush();
+
+	current.bytesOut += connection.getStats()->sent;
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not the bot is connected.
+ *
+ * @return True if connected
+ */
+bool BotClient::isConnected () {
+
+	return connected;
+
+}
+
+
+/**
+ * Determine whether or not the bot's player is in the game.
+ *
+ * @return True if joined
+ */
+bool BotClient::isJoined () {
+
+	return connected && (player != -1);
+
+}
+
+
+/**
+ * Take the traffic since the last call, and add it to the bot's total.
+ *
+ * @param stats Structure to receive the traffic
+ */
+void BotClient::takeStats (BotStats *stats) {
+
+	*stats = current;
+
+	total.bytesIn += current.bytesIn;
+	total.bytesOut += current.bytesOut;
+	total.pings += current.pings;
+	total.latency += current.latency;
+	if (current.maxLatency > total.maxLatency) total.maxLatency = current.maxLatency;
+	total.levels += current.levels;
+
+	memset(&current, 0, sizeof(BotStats));
+
+	return;
+
+}
+
+
+/**
+ * Get the traffic taken so far by takeStats().
+ *
+ * @return Traffic statistics
+ */
+const BotStats* BotClient::getStats () {
+
+	return &total;
+
+}
+
+
+/**
+ * Get the length of time for which the bot has been connected.
+ *
+ * @param ticks Current time
+ *
+ * @return Time in milliseconds
+ */
+unsigned int BotClient::getConnectedTime (unsigned int ticks) {
+
+	return (connected? ticks: endTime) - connectTime;
+
+}
+
+
+
+
+/**
+ * Create an inactive load test.
+ */
+LoadTest::LoadTest () {
+
+	bots = NULL;
+	nBots = nStarted = 0;
+	startTime = reportTime = 0;
+	running = false;
+	thread = NULL;
+
+	return;
+
+}
+
+
+/**
+ * Stop the bots, if they are still running.
+ */
+LoadTest::~LoadTest () {
+
+	stop();
+
+	return;
+
+}
+
+
+/**
+ * Start connecting bots to the local server, one at a time.
+ *
+ * @param newBots Number of bots
+ *
+ * @return Whether or not the bot thread started
+ */
+bool LoadTest::start (int newBots) {
+
+	if (thread || (newBots <= 0)) return false;
+
+	bots = new BotClient[newBots];
+	nBots = newBots;
+	nStarted = 0;
+	startTime = reportTime = SDL_GetTicks();
+
+	running = true;
+	thread = SDL_CreateThread(loop, this);
+
+	if (!thread) {
+
+		log("Could not start bot thread");
+
+		running = false;
+
+		delete[] bots;
+		bots = NULL;
+
+		return false;
+
+	}
+
+	log("Starting bots", nBots);
+
+	return true;
+
+}
+
+
+/**
+ * Disconnect the bots, and report the traffic and latency of each.
+ */
+void LoadTest::stop () {
+
+	const BotStats* stats;
+	unsigned int ticks, time;
+	int count;
+
+	if (!thread) return;
+
+	running = false;
+	SDL_WaitThread(thread, NULL);
+	thread = NULL;
+
+	ticks = SDL_GetTicks();
+
+	report(ticks);
+
+	for (count = 0; count < nStarted; count++) {
+
+		stats = bots[count].getStats();
+		time = bots[count].getConnectedTime(ticks);
+
+		if (!time) time = 1;
+
+		printf("Bot %d: received %u B/s, sent %u B/s, latency mean: %u us, max: %u us, levels: %d\n",
+			count, (unsigned int)((stats->bytesIn * 1000.0) / time),
+			(unsigned int)((stats->bytesOut * 1000.0) / time),
+			stats->pings? stats->latency / stats->pings: 0, stats->maxLatency,
+			stats->levels);
+
+		bots[count].stop();
+
+	}
+
+	delete[] bots;
+	bots = NULL;
+	nBots = nStarted = 0;
+
+	return;
+
+}
+
+
+/**
+ * Bot thread entry point.
+ *
+ * @param data The load test
+ *
+ * @return Always 0
+ */
+int LoadTest::loop (void *data) {
+
+	((LoadTest *)data)->run();
+
+	return 0;
+
+}
+
+
+/**
+ * Run the bots until stopped.
+ */
+void LoadTest::run () {
+
+	unsigned int ticks;
+	int count;
+
+	while (running) {
+
+		ticks = SDL_GetTicks();
+
+		// Connect the bots gradually, so that the load builds up
+		if ((nStarted < nBots) && (ticks >= startTime + (nStarted * T_BOT_RAMP))) {
+
+			bots[nStarted].start(nStarted, BOT_ADDRESS);
+			nStarted++;
+
+		}
+
+		for (count = 0; count < nStarted; count++)
+			bots[count].step(ticks);
+
+		if (ticks >= reportTime + T_BOT_REPORT) report(ticks);
+
+		SDL_Delay(T_BOT_FRAME);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Summarise the traffic and latency of the bots since the last summary.
+ *
+ * @param ticks Current time
+ */
+void LoadTest::report (unsigned int ticks) {
+
+	BotStats stats;
+	unsigned int time, bytesIn, bytesOut, maxIn, pings, latency, maxLatency;
+	int count, connected, joined, levels;
+
+	bytesIn = bytesOut = maxIn = pings = latency = maxLatency = 0;
+	connected = joined = levels = 0;
+
+	for (count = 0; count < nStarted; count++) {
+
+		if (bots[count].isConnected()) connected++;
+		if (bots[count].isJoined()) joined++;
+
+		bots[count].takeStats(&stats);
+
+		bytesIn += stats.bytesIn;
+		bytesOut += stats.bytesOut;
+		if (stats.bytesIn > maxIn) maxIn = stats.bytesIn;
+		pings += stats.pings;
+		latency += stats.latency;
+		if (stats.maxLatency > maxLatency) maxLatency = stats.maxLatency;
+		levels += stats.levels;
+
+	}
+
+	time = ticks - reportTime;
+	reportTime = ticks;
+
+	if (!time) time = 1;
+	if (!connected) connected = 1;
+
+	printf("Bots: %d of %d joined, levels received: %d, latency mean: %u us, max: %u us\n",
+		joined, nBots, levels, pings? latency / pings: 0, maxLatency);
+	printf("Bot traffic: received %u B/s (max %u B/s), sent %u B/s per bot\n",
+		(unsigned int)((bytesIn * 1000.0) / time / connected),
+		(unsigned int)((maxIn * 1000.0) / time),
+		(unsigned int)((bytesOut * 1000.0) / time / connected));
+
+	return;
+
+}
+
@@ -0,0 +1,139 @@
+
+/**
+ *
+ * @file loadtest.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 18th October 2026: Created loadtest.h
+ *
+ * @par Licence:
+ * Copyright (c) 2026 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _LOADTEST_H
+#define _LOADTEST_H
+
+
+#include "game/game.h"
+#include "io/network.h"
+
+#include <SDL_thread.h>
+
+
+// Constants
+
+#define BOT_ADDRESS "127.0.0.1" /* Address of the server the bots join */
+#define BOT_NAME    "bot" /* Name of each bot's player */
+
+// Time intervals
+#define T_BOT_FRAME   10 /* Time between bot steps */
+#define T_BOT_RAMP    100 /* Time between bots connecting */
+#define T_BOT_PING    1000 /* Time between latency measurements */
+#define T_BOT_ANIMS   5000 /* Time between sending player animations */
+#define T_BOT_PATTERN 500 /* Time each entry of the control pattern lasts */
+#define T_BOT_REPORT  10000 /* Time between traffic summaries */
+
+
+// Datatype
+
+/// Traffic passed by a bot, and the latency it saw
+typedef struct {
+
+	unsigned int bytesIn; ///< Number of bytes received
+	unsigned int bytesOut; ///< Number of bytes sent
+	unsigned int pings; ///< Number of latency measurements
+	unsigned int latency; ///< Total round trip time, in microseconds
+	unsigned int maxLatency; ///< Longest round trip time, in microseconds
+	int          levels; ///< Number of levels downloaded
+
+} BotStats;
+
+
+// Classes
+
+/// Simulated client, which joins the game over a real connection and sends
+/// made-up player updates
+class BotClient {
+
+	private:
+		Connection    connection; ///< Connection to the server
+		Snapshot      snapshot; ///< Baseline for the properties sent
+		Snapshot      snapshots[MAX_PLAYERS]; ///< Baselines for each player's received properties
+		unsigned char anims[BUFFER_LENGTH]; ///< The last MT_P_ANIMS message received, to send back as the bot's own
+		BotStats      current; ///< Traffic since the last summary
+		BotStats      total; ///< Traffic since connecting
+		unsigned int  connectTime; ///< Time at which the bot connected
+		unsigned int  endTime; ///< Time at which the bot disconnected
+		unsigned int  sendTime; ///< Time at which the next player update is due
+		unsigned int  pingTime; ///< Time at which the next latency measurement is due
+		unsigned int  animsTime; ///< Time at which the player animations are next sent
+		unsigned int  seed; ///< State of the bot's random number generator
+		int           index; ///< Number of the bot, which offsets its control pattern
+		int           clientID; ///< ID assigned by the server, or -1 before the game properties arrive
+		int           player; ///< Number of the bot's player, or -1 before joining
+		int           x; ///< X-coordinate of the bot's player
+		int           y; ///< Y-coordinate of the bot's player
+		bool          connected; ///< Whether or not the bot is connected
+		bool          downloading; ///< Whether or not level data is being received
+		bool          joinSent; ///< Whether or not the bot has asked to join
+		bool          positioned; ///< Whether or not the position has been taken from another player
+		bool          hasAnims; ///< Whether or not animations have been received to send back
+
+		int  random     ();
+		void receive    (unsigned char *buffer);
+		void sendPlayer (unsigned int ticks);
+
+	public:
+		BotClient ();
+
+		bool            start            (int newIndex, const char *address);
+		void            stop             ();
+		void            step             (unsigned int ticks);
+		bool            isConnected      ();
+		bool            isJoined         ();
+		void            takeStats        (BotStats *stats);
+		const BotStats* getStats         ();
+		unsigned int    getConnectedTime (unsigned int ticks);
+
+};
+
+/// Runs bot clients against a server on a thread of their own, and reports
+/// the traffic they pass and the latency they see
+class LoadTest {
+
+	private:
+		BotClient*    bots; ///< The bot clients
+		int           nBots; ///< Number of bot clients
+		int           nStarted; ///< Number of bot clients which have tried to connect
+		unsigned int  startTime; ///< Time at which the bots started
+		unsigned int  reportTime; ///< Time of the last traffic summary
+		volatile bool running; ///< Whether or not the bot thread should keep running
+		SDL_Thread*   thread; ///< The bot thread
+
+		static int loop   (void *data);
+		void       run    ();
+		void       report (unsigned int ticks);
+
+	public:
+		LoadTest  ();
+		~LoadTest ();
+
+		bool start (int newBots);
+		void stop  ();
+
+};
+
+
+// Variable
+
+EXTERN LoadTest loadTest; ///< Bot clients for load testing a dedicated server
+
+#endif
+
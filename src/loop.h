@@ -36,10 +36,15 @@
 #define JOYSTICKHRHT 0x600
 #define JOYSTICKHDWN 0x700
 
+// Time interval
+#define T_VIRTUAL_FRAME 20 ///< Simulated frame length in headless mode
 
-// Variable
+
+// Variables
 
 EXTERN unsigned int globalTicks;
+EXTERN bool         headless; ///< Whether or not the game is running without video or audio output
+EXTERN unsigned int headlessEnd; ///< Time at which a headless run ends (0 if unlimited)
 
 
 // Enum
@@ -36,11 +36,17 @@
 #include "io/sound.h"
 #include "jj2level/jj2level.h"
 #include "jj1level/jj1level.h"
+#include "level/replay.h"
 #include "menu/menu.h"
 #include "player/player.h"
 #include "jj1scene/jj1scene.h"
+#include "benchmark.h"
+#include "loadtest.h"
 #include "loop.h"
+#include "profiler.h"
+#include "scheduler.h"
 #include "setup.h"
+#include "trace.h"
 #include "util.h"
 
 #ifdef PSP
@@ -65,6 +71,7 @@
 	#include <fs_info.h>
 #endif
 
+#include <stdlib.h>
 #include <string.h>
 
 #if defined(WIZ) || defined(GP2X)
@@ -81,6 +88,29 @@ extern float sinf (float);
 #define PI 3.141592f
 
 
+/**
+ * Determines whether or not a command-line option is followed by an argument.
+ *
+ * @param option The option
+ *
+ * @return True if the next argument belongs to the option
+ */
+bool hasArgument (const char *option) {
+
+	return !strcmp(option, "--headless") || !strcmp(option, "--script") ||
+		!strcmp(option, "--duration") || !strcmp(option, "--record") ||
+		!strcmp(option, "--replay") || !strcmp(option, "--benchmark") ||
+		!strcmp(option, "--frames") || !strcmp(option, "--csv") ||
+		!strcmp(option, "--audio-benchmark") || !strcmp(option, "--trace") ||
+		!strcmp(option, "--level") || !strcmp(option, "--mode") ||
+		!strcmp(option, "--difficulty") || !strcmp(option, "--tick-rate") ||
+		!strcmp(option, "--tick-log") || !strcmp(option, "--bots") ||
+		!strcmp(option, "--net-loss") || !strcmp(option, "--net-latency") ||
+		!strcmp(option, "--net-jitter");
+
+}
+
+
 /**
  * Initialises OpenJazz.
  *
@@ -98,6 +128,11 @@ void startUp (int argc, char *argv[]) {
 	int screenW = DEFAULT_SCREEN_WIDTH;
 	int screenH = DEFAULT_SCREEN_HEIGHT;
 	int scaleFactor = 1;
+	int benchmarkFrames = 0;
+	const char* benchmarkCSV = NULL;
+	int netLoss = 0;
+	int netLatency = 0;
+	int netJitter = 0;
 #ifdef FULLSCREEN_ONLY
 	bool fullscreen = true;
 #else
@@ -145,8 +180,11 @@ void startUp (int argc, char *argv[]) {
 
 	for (count = 1; count < argc; count++) {
 
+		// Skip the arguments of options
+		if (hasArgument(argv[count])) count++;
+
 		// If it isn't an option, it should be a path
-		if (argv[count][0] != '-') {
+		else if (argv[count][0] != '-') {
 
 #ifdef _WIN32
 			if (argv[count][strlen(argv[count]) - 1] != '\\') {
@@ -218,6 +256,7 @@ void startUp (int argc, char *argv[]) {
 
 	// Create the network address
 	netAddress = createString(NET_ADDRESS);
+	netDatagrams = false;
 
 
 	// Load settings from config file
@@ -238,33 +277,93 @@ void startUp (int argc, char *argv[]) {
 				setSoundVolume(0);
 			}
 
+			if ((count + 1 < argc) && !strcmp(argv[count], "--duration"))
+				headlessEnd = atoi(argv[count + 1]) * 1000;
+
+			if ((count + 1 < argc) && !strcmp(argv[count], "--script") &&
+				(controls.loadScript(argv[count + 1]) != E_NONE))
+				logError("Could not load input script", argv[count + 1]);
+
+			if ((count + 1 < argc) && !strcmp(argv[count], "--frames"))
+				benchmarkFrames = atoi(argv[count + 1]);
+
+			if ((count + 1 < argc) && !strcmp(argv[count], "--csv"))
+				benchmarkCSV = argv[count + 1];
+
+			if ((count + 1 < argc) && !strcmp(argv[count], "--record"))
+				replay.record(argv[count + 1]);
+
+			if ((count + 1 < argc) && !strcmp(argv[count], "--replay") &&
+				(replay.load(argv[count + 1]) != E_NONE))
+				logError("Could not load replay", argv[count + 1]);
+
+			if ((count + 1 < argc) && !strcmp(argv[count], "--trace"))
+				trace.activate(argv[count + 1]);
+
+			if (!strcmp(argv[count], "--udp")) netDatagrams = true;
+
+			if ((count + 1 < argc) && !strcmp(argv[count], "--net-loss"))
+				netLoss = atoi(argv[count + 1]);
+
+			if ((count + 1 < argc) && !strcmp(argv[count], "--net-latency"))
+				netLatency = atoi(argv[count + 1]);
+
+			if ((count + 1 < argc) && !strcmp(argv[count], "--net-jitter"))
+				netJitter = atoi(argv[count + 1]);
+
+			if (hasArgument(argv[count])) count++;
+
 		}
 
 	}
 
 
-	// Create the game's window
+	for (count = 1; count < argc - 1; count++) {
+
+		if (!strcmp(argv[count], "--benchmark"))
+			benchmark.activate(benchmarkFrames, benchmarkCSV);
+
+	}
+
+	// Test datagrams against a poor network
+	if (netLoss || netLatency || netJitter)
+		netSimulator.activate(netLoss, netLatency, netJitter);
+
 
 	canvas = NULL;
 
-	if (!video.init(screenW, screenH, fullscreen)) {
+	if (headless) {
 
-		delete firstPath;
+		// Draw to an off-screen canvas, without any video or audio output
 
-		throw E_VIDEO;
+		canvasW = SW;
+		canvasH = SH;
+		canvas = createSurface(NULL, canvasW, canvasH);
 
-	}
+	} else {
+
+		// Create the game's window
+
+		if (!video.init(screenW, screenH, fullscreen)) {
+
+			delete firstPath;
+
+			throw E_VIDEO;
+
+		}
 
 #ifdef SCALE
-	video.setScaleFactor(scaleFactor);
+		video.setScaleFactor(scaleFactor);
 #endif
 
 
-	if (SDL_NumJoysticks() > 0) SDL_JoystickOpen(0);
+		if (SDL_NumJoysticks() > 0) SDL_JoystickOpen(0);
+
 
+		// Set up audio
+		openAudio();
 
-	// Set up audio
-	openAudio();
+	}
 
 
 
@@ -343,8 +442,9 @@ void startUp (int argc, char *argv[]) {
 	delete[] pixels;
 
 
-	// Establish arbitrary timing
-	globalTicks = SDL_GetTicks() - 20;
+	// Establish arbitrary timing, or virtual timing when headless
+	if (headless) globalTicks = 0;
+	else globalTicks = SDL_GetTicks() - 20;
 
 
 	// Fill trigonometric function look-up tables
@@ -379,15 +479,24 @@ void shutDown () {
 	delete fontmn1;
 	delete fontmn2;
 
+	if (headless) {
+
+		// Nothing was output, so there are no settings to save
+		SDL_FreeSurface(canvas);
+
+	} else {
+
 #ifdef SCALE
-	if (video.getScaleFactor() > 1) SDL_FreeSurface(canvas);
+		if (video.getScaleFactor() > 1) SDL_FreeSurface(canvas);
 #endif
 
-	closeAudio();
+		closeAudio();
 
 
-	// Save settings to config file
-	setup.save();
+		// Save settings to config file
+		setup.save();
+
+	}
 
 
 	delete firstPath;
@@ -477,6 +586,117 @@ int play () {
 }
 
 
+/**
+ * Play a game starting from the given level, without any menus. When headless,
+ * report how long the game took to simulate.
+ *
+ * @param levelFile The first level's file name
+ * @param difficulty Difficulty setting
+ *
+ * @return Error code
+ */
+int playGame (const char *levelFile, int difficulty) {
+
+	Game* game;
+	unsigned int startTime;
+	int ret;
+
+	try {
+
+		game = new LocalGame(levelFile, difficulty);
+
+	} catch (int e) {
+
+		logError("Could not load level", levelFile);
+
+		return e;
+
+	}
+
+	startTime = SDL_GetTicks();
+
+	ret = game->play();
+
+	delete game;
+
+	if (headless) {
+
+		log("Simulated time (ms)", globalTicks);
+		log("Elapsed time (ms)", SDL_GetTicks() - startTime);
+
+	}
+
+	if (ret == E_QUIT) return E_NONE;
+
+	return ret;
+
+}
+
+
+#ifdef DEDICATED_SERVER
+/**
+ * Host a multiplayer game, starting from the given level, without video, audio
+ * or menus. Ticks are run at a fixed rate until the game ends or the server is
+ * stopped.
+ *
+ * @param levelFile The first level's file name
+ * @param modeType Game mode
+ * @param difficulty Difficulty setting
+ * @param tickRate Number of ticks per second
+ * @param tickLog File to which the timing of each tick is written (NULL for none)
+ * @param bots Number of bot clients to load the server with
+ *
+ * @return Error code
+ */
+int serveGame (const char *levelFile, GameModeType modeType, int difficulty, int tickRate, const char *tickLog, int bots) {
+
+	Game* game;
+	char* firstLevel;
+	int ret;
+
+	firstLevel = createString(levelFile);
+
+	try {
+
+		game = new ServerGame(modeType, firstLevel, difficulty);
+
+	} catch (int e) {
+
+		delete[] firstLevel;
+
+		logError("Could not create server", levelFile);
+
+		return e;
+
+	}
+
+	delete[] firstLevel;
+
+	log("Serving", levelFile);
+
+	tickScheduler.activate(tickRate, tickLog);
+
+	if (bots) loadTest.start(bots);
+
+	ret = game->play();
+
+	// Disconnect the bots before the server closes its connections
+	loadTest.stop();
+
+	delete game;
+
+	tickScheduler.deactivate();
+
+	log("Server stopped after (ms)", globalTicks);
+
+	if (ret == E_QUIT) return E_NONE;
+
+	return ret;
+
+}
+#endif
+
+
 /**
  * Process iteration.
  *
@@ -493,24 +713,64 @@ int loop (LoopType type, PaletteEffect* paletteEffects, bool effectsStopped) {
 	SDL_Event event;
 	int prevTicks, ret;
 
+	TRACE_SCOPE("loop");
+
+
+	if (headless) {
+
+		// Advance virtual time by a fixed amount, without output or events
+		// A dedicated server instead waits for its next tick
+		if (tickScheduler.isActive()) {
+
+			globalTicks = tickScheduler.wait();
+
+			if (tickScheduler.isStopped()) return E_QUIT;
+
+		} else globalTicks += T_VIRTUAL_FRAME;
+
+		if (headlessEnd && (globalTicks >= headlessEnd)) return E_QUIT;
+
+		controls.loop();
+
+		return E_NONE;
+
+	}
+
 
 	// Update tick count
 	prevTicks = globalTicks;
-	globalTicks = SDL_GetTicks();
 
-	if (globalTicks - prevTicks < 4) {
+	if (benchmark.isActive()) {
+
+		// Advance by a fixed amount, without limiting the frame rate
+		globalTicks += T_VIRTUAL_FRAME;
+
+	} else {
 
-		// Limit framerate
-		SDL_Delay(4 + prevTicks - globalTicks);
 		globalTicks = SDL_GetTicks();
 
+		if (globalTicks - prevTicks < 4) {
+
+			// Limit framerate
+			SDL_Delay(4 + prevTicks - globalTicks);
+			globalTicks = SDL_GetTicks();
+
+		}
+
 	}
 
 	// Show what has been drawn
 	video.flip(globalTicks - prevTicks, paletteEffects, effectsStopped);
 
+#ifdef PROFILE
+	// The frame ends once it has been shown, so the flip counts towards it
+	profiler.endFrame();
+#endif
+
 
 	// Process system events
+	PROFILE_START(timer);
+
 	while (SDL_PollEvent(&event)) {
 
 		if (event.type == SDL_QUIT) return E_QUIT;
@@ -545,6 +805,8 @@ int loop (LoopType type, PaletteEffect* paletteEffects, bool effectsStopped) {
 
 	controls.loop();
 
+	PROFILE_MARK(timer, PP_INPUT);
+
 
 #if defined(WIZ) || defined(GP2X)
 	WIZ_AdjustVolume( volume_direction );
@@ -567,7 +829,20 @@ int loop (LoopType type, PaletteEffect* paletteEffects, bool effectsStopped) {
  */
 int main(int argc, char *argv[]) {
 
-	int ret;
+	const char* headlessLevel = NULL;
+	const char* benchmarkLevel = NULL;
+	const char* audioBenchmarkMusic = NULL;
+	const char* audioBenchmarkCSV = NULL;
+	int audioBenchmarkSeconds = 0;
+#ifdef DEDICATED_SERVER
+	const char* serverLevel = "LEVEL0.000";
+	const char* tickLog = NULL;
+	GameModeType serverMode = M_COOP;
+	int serverDifficulty = 1;
+	int tickRate = TICK_RATE;
+	int bots = 0;
+#endif
+	int count, ret;
 
 	// Early platform init
 
@@ -583,9 +858,78 @@ int main(int argc, char *argv[]) {
 	sceTouchSetSamplingState(SCE_TOUCH_PORT_FRONT, SCE_TOUCH_SAMPLING_STATE_START);
 #endif
 
+	// Check for headless mode, which needs neither video nor audio
+
+	headless = false;
+	headlessEnd = 0;
+
+	for (count = 1; count < argc - 1; count++) {
+
+		if (!strcmp(argv[count], "--headless")) {
+
+			headless = true;
+			headlessLevel = argv[count + 1];
+
+		}
+
+		if (!strcmp(argv[count], "--benchmark"))
+			benchmarkLevel = argv[count + 1];
+
+		// The audio benchmark does not use the audio device either
+		if (!strcmp(argv[count], "--audio-benchmark")) {
+
+			headless = true;
+			audioBenchmarkMusic = argv[count + 1];
+
+		}
+
+		if (!strcmp(argv[count], "--duration"))
+			audioBenchmarkSeconds = atoi(argv[count + 1]);
+
+		if (!strcmp(argv[count], "--csv"))
+			audioBenchmarkCSV = argv[count + 1];
+
+#ifdef DEDICATED_SERVER
+		if (!strcmp(argv[count], "--level")) serverLevel = argv[count + 1];
+
+		if (!strcmp(argv[count], "--mode")) {
+
+			if (!strcmp(argv[count + 1], "coop")) serverMode = M_COOP;
+			else if (!strcmp(argv[count + 1], "battle")) serverMode = M_BATTLE;
+			else if (!strcmp(argv[count + 1], "teambattle")) serverMode = M_TEAMBATTLE;
+			else if (!strcmp(argv[count + 1], "race")) serverMode = M_RACE;
+			else {
+
+				logError("Unknown game mode", argv[count + 1]);
+
+				return -1;
+
+			}
+
+		}
+
+		if (!strcmp(argv[count], "--difficulty"))
+			serverDifficulty = atoi(argv[count + 1]) & 3;
+
+		if (!strcmp(argv[count], "--tick-rate"))
+			tickRate = atoi(argv[count + 1]);
+
+		if (!strcmp(argv[count], "--tick-log")) tickLog = argv[count + 1];
+
+		if (!strcmp(argv[count], "--bots")) bots = atoi(argv[count + 1]);
+#endif
+
+	}
+
+#ifdef DEDICATED_SERVER
+	// A dedicated server has neither video nor audio
+	headless = true;
+#endif
+
+
 	// Initialise SDL
 
-	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER | SDL_INIT_JOYSTICK) < 0) {
+	if (SDL_Init(headless? SDL_INIT_TIMER: SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER | SDL_INIT_JOYSTICK) < 0) {
 
 		logError("Could not start SDL", SDL_GetError());
 
@@ -611,13 +955,26 @@ int main(int argc, char *argv[]) {
 
 	// Play the opening cutscene, run the main menu, etc.
 
-	ret = play();
+	if (audioBenchmarkMusic)
+		ret = benchmarkAudio(audioBenchmarkMusic, audioBenchmarkSeconds, audioBenchmarkCSV);
+	else if (replay.getMode() == RM_PLAY)
+		ret = playGame(replay.getLevelFile(), replay.getDifficulty());
+	else if (benchmarkLevel) ret = playGame(benchmarkLevel, 1);
+	else if (headlessLevel) ret = playGame(headlessLevel, 1);
+#ifdef DEDICATED_SERVER
+	else ret = serveGame(serverLevel, serverMode, serverDifficulty, tickRate, tickLog, bots);
+#else
+	else ret = play();
+#endif
 
 
 	// Save configuration and shut down
 
 	shutDown();
 
+	// The audio has stopped, so the trace can be written
+	trace.save();
+
 	SDL_Quit();
 
 	return ret;
@@ -534,10 +534,12 @@ int SetupMenu::setupScaling () {
  */
 int SetupMenu::setupSound () {
 
-	int x, y;
-	bool soundActive;
+	const char* soundOptions[5] = {"music volume", "effect volume", "sample rate", "buffer size", "music cache"};
+	const int rates[4] = {11025, 22050, 44100, 48000};
+	const int bufferSizes[6] = {256, 512, 1024, 2048, 4096, 8192};
+	int x, y, option, count, rate, bufferSize, direction;
 
-	soundActive = false;
+	option = 0;
 
 	while (true) {
 
@@ -547,6 +549,8 @@ int SetupMenu::setupSound () {
 
 		if (controls.release(C_ENTER)) return E_NONE;
 
+		direction = 0;
+
 		if (controls.getCursor(x, y)) {
 
 			if ((x < 100) && (y >= canvasH - 12) && controls.wasCursorReleased()) return E_NONE;
@@ -557,7 +561,12 @@ int SetupMenu::setupSound () {
 			if ((x >= 0) && (x < (MAX_VOLUME >> 1)) && (y >= 0) && (y < 11)) setMusicVolume(x << 1);
 			if ((x >= 0) && (x < (MAX_VOLUME >> 1)) && (y >= 16) && (y < 27)) setSoundVolume(x << 1);
 
-			if (controls.wasCursorReleased()) playSound(S_ORB);
+			if ((x >= 0) && (y >= 32) && (y < 75) && controls.wasCursorReleased()) {
+
+				option = 2 + ((y - 32) >> 4);
+				direction = 1;
+
+			} else if (controls.wasCursorReleased()) playSound(S_ORB);
 
 		}
 
@@ -565,37 +574,72 @@ int SetupMenu::setupSound () {
 
 		video.clearScreen(0);
 
-		// Music Volume
-		if (!soundActive) fontmn2->mapPalette(240, 8, 114, 16);
-		fontmn2->showString("music volume", canvasW >> 2, canvasH >> 1);
-		fontmn2->restorePalette();
+		for (count = 0; count < 5; count++) {
 
+			if (count == option) fontmn2->mapPalette(240, 8, 114, 16);
+			fontmn2->showString(soundOptions[count], canvasW >> 2, (canvasH >> 1) + (count * 16));
+			fontmn2->restorePalette();
+
+		}
+
+		// Music Volume
 		drawRect((canvasW >> 2) + 128, canvasH >> 1, getMusicVolume() >> 1, 11, 175);
 
 		// Sound Volume
-		if (soundActive) fontmn2->mapPalette(240, 8, 114, 16);
-		fontmn2->showString("effect volume", canvasW >> 2, (canvasH >> 1) + 16);
-		fontmn2->restorePalette();
-
 		drawRect((canvasW >> 2) + 128, (canvasH >> 1) + 16, getSoundVolume() >> 1, 11, 175);
 
-		if (controls.release(C_UP)) soundActive = !soundActive;
+		// Sample rate and buffer size
+		fontmn2->showNumber(getSoundRate(), (canvasW >> 2) + 176, (canvasH >> 1) + 32);
+		fontmn2->showNumber(getSoundSamples(), (canvasW >> 2) + 176, (canvasH >> 1) + 48);
 
-		if (controls.release(C_DOWN)) soundActive = !soundActive;
+		// Music cache
+		fontmn2->showString(getMusicCache()? "on": "off", (canvasW >> 2) + 160, (canvasH >> 1) + 64);
 
-		if (controls.release(C_LEFT)) {
+		if (controls.release(C_UP)) option = (option + 4) % 5;
 
-			if (soundActive) setSoundVolume(getSoundVolume() - 4);
-			else setMusicVolume(getMusicVolume() - 4);
+		if (controls.release(C_DOWN)) option = (option + 1) % 5;
 
-			playSound(S_ORB);
+		if (controls.release(C_LEFT)) direction = -1;
 
-		}
+		if (controls.release(C_RIGHT)) direction = 1;
+
+		if (direction) {
 
-		if (controls.release(C_RIGHT)) {
+			if (option == 0) {
 
-			if (soundActive) setSoundVolume(getSoundVolume() + 4);
-			else setMusicVolume(getMusicVolume() + 4);
+				setMusicVolume(getMusicVolume() + (direction * 4));
+
+			} else if (option == 1) {
+
+				setSoundVolume(getSoundVolume() + (direction * 4));
+
+			} else if (option == 4) {
+
+				setMusicCache(!getMusicCache());
+
+			} else {
+
+				// Find the next setting, and reopen audio with it
+				rate = getSoundRate();
+				bufferSize = getSoundSamples();
+
+				if (option == 2) {
+
+					for (count = 0; (count < 3) && (rates[count] < rate); count++);
+					count = (count + 4 + direction) % 4;
+					rate = rates[count];
+
+				} else {
+
+					for (count = 0; (count < 5) && (bufferSizes[count] < bufferSize); count++);
+					count = (count + 6 + direction) % 6;
+					bufferSize = bufferSizes[count];
+
+				}
+
+				setSoundFormat(rate, bufferSize);
+
+			}
 
 			playSound(S_ORB);
 
@@ -0,0 +1,167 @@
+
+/**
+ *
+ * @file profiler.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 18th October 2026: Created profiler.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2026 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Measures the time taken by each phase of recent frames, for display in the
+ * statistics overlay. Only built when PROFILE is defined.
+ *
+ */
+
+
+#include "profiler.h"
+
+#ifdef PROFILE
+
+#include "io/gfx/font.h"
+#include "io/gfx/video.h"
+
+#include <string.h>
+
+
+/**
+ * Create the profiler.
+ */
+Profiler::Profiler () {
+
+	memset(times, 0, sizeof(times));
+	memset(frameTimes, 0, sizeof(frameTimes));
+
+	frameStart = 0;
+	frame = 0;
+
+	return;
+
+}
+
+
+/**
+ * Add time taken by a phase of the current frame.
+ *
+ * @param phase The phase
+ * @param startTime Time at which the phase started, from getMicroTicks()
+ *
+ * @return The current time, for timing the next phase
+ */
+unsigned int Profiler::addTime (ProfilePhase phase, unsigned int startTime) {
+
+	unsigned int time;
+
+	time = getMicroTicks();
+	times[frame][phase] += time - startTime;
+
+	return time;
+
+}
+
+
+/**
+ * Move on to the next frame, overwriting the oldest.
+ */
+void Profiler::endFrame () {
+
+	unsigned int time;
+
+	time = getMicroTicks();
+	frameTimes[frame] = time - frameStart;
+	frameStart = time;
+
+	frame = (frame + 1) % PROFILE_FRAMES;
+
+	memset(times[frame], 0, sizeof(times[frame]));
+
+	return;
+
+}
+
+
+/**
+ * Draw the average time taken by each phase, and a graph of recent frame times.
+ *
+ * @param x X-coordinate of the top-left corner
+ * @param y Y-coordinate of the top-left corner
+ * @param bg Background colour
+ * @param fg Graph colour
+ */
+void Profiler::draw (int x, int y, unsigned char bg, unsigned char fg) {
+
+	const char* phaseNames[PP_PHASES] = {"input", "step", " event", " bullet",
+		" player", "tiles", "sprite", "effect", "scale", "flip"};
+	unsigned int total;
+	int phase, count, height;
+
+	drawRect(x, y, 100, (PP_PHASES * 12) + 31, bg);
+
+	// Average time taken by each phase, in microseconds
+	for (phase = 0; phase < PP_PHASES; phase++) {
+
+		total = 0;
+
+		for (count = 0; count < PROFILE_FRAMES; count++)
+			total += times[count][phase];
+
+		panelBigFont->showString(phaseNames[phase], x + 4, y + 3 + (phase * 12));
+		panelBigFont->showNumber(total / PROFILE_FRAMES, x + 92, y + 3 + (phase * 12));
+
+	}
+
+	// Frame times, oldest first, at 1 pixel per millisecond
+	y += (PP_PHASES * 12) + 29;
+
+	for (count = 0; count < PROFILE_FRAMES - 1; count++) {
+
+		height = frameTimes[(frame + 1 + count) % PROFILE_FRAMES] / 1000;
+		if (height > 24) height = 24;
+
+		drawRect(x + 4 + count, y - height, 1, height, fg);
+
+	}
+
+	// Mark 16ms (about 60 frames per second)
+	drawRect(x + 2, y - 16, 2, 1, fg);
+
+	return;
+
+}
+
+
+/**
+ * Start timing a phase.
+ *
+ * @param newPhase The phase
+ */
+ProfileTimer::ProfileTimer (ProfilePhase newPhase) {
+
+	phase = newPhase;
+	startTime = getMicroTicks();
+
+	return;
+
+}
+
+
+/**
+ * Add the time since the timer was created to its phase.
+ */
+ProfileTimer::~ProfileTimer () {
+
+	profiler.addTime(phase, startTime);
+
+	return;
+
+}
+
+#endif
+
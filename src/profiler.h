@@ -0,0 +1,110 @@
+
+/**
+ *
+ * @file profiler.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 18th October 2026: Created profiler.h
+ *
+ * @par Licence:
+ * Copyright (c) 2026 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+
+#include "OpenJazz.h"
+
+#include "util.h"
+
+
+// Macros
+
+#ifdef PROFILE
+	#define PROFILE_SCOPE(phase) ProfileTimer profileTimer(phase)
+	#define PROFILE_START(timer) unsigned int timer = getMicroTicks()
+	#define PROFILE_MARK(timer, phase) timer = profiler.addTime(phase, timer)
+#else
+	#define PROFILE_SCOPE(phase)
+	#define PROFILE_START(timer)
+	#define PROFILE_MARK(timer, phase)
+#endif
+
+
+// Constants
+
+#define PROFILE_FRAMES 64 /* Number of frames kept for averaging and graphing */
+
+
+// Enum
+
+/// Profiled parts of a frame
+enum ProfilePhase {
+
+	PP_INPUT, ///< Polling for input
+	PP_STEP, ///< Level simulation steps
+	PP_EVENTS, ///< Events, during steps
+	PP_BULLETS, ///< Bullets, during steps
+	PP_PLAYERS, ///< Players, during steps
+	PP_TILES, ///< Drawing tiles
+	PP_SPRITES, ///< Drawing events, players and bullets
+	PP_EFFECTS, ///< Applying palette effects
+	PP_SCALE, ///< Scaling the canvas to the screen
+	PP_FLIP, ///< Showing the frame
+	PP_PHASES ///< Number of phases
+
+};
+
+
+#ifdef PROFILE
+
+// Classes
+
+/// Keeps the time taken by each phase of recent frames
+class Profiler {
+
+	private:
+		unsigned int times[PROFILE_FRAMES][PP_PHASES]; ///< Time taken by each phase, in microseconds
+		unsigned int frameTimes[PROFILE_FRAMES]; ///< Time taken by each frame, in microseconds
+		unsigned int frameStart; ///< Time at which the current frame started
+		int          frame; ///< Position of the current frame in the ring buffer
+
+	public:
+		Profiler ();
+
+		unsigned int addTime  (ProfilePhase phase, unsigned int startTime);
+		void         endFrame ();
+		void         draw     (int x, int y, unsigned char bg, unsigned char fg);
+
+};
+
+/// Adds the time spent in the scope in which it is created to a phase
+class ProfileTimer {
+
+	private:
+		ProfilePhase phase; ///< The phase being timed
+		unsigned int startTime; ///< Time at which the timer was created
+
+	public:
+		ProfileTimer  (ProfilePhase newPhase);
+		~ProfileTimer ();
+
+};
+
+
+// Variable
+
+EXTERN Profiler profiler; ///< Frame phase profiler
+
+#endif
+
+#endif
+
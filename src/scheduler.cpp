@@ -0,0 +1,262 @@
+
+/**
+ *
+ * @file scheduler.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 18th October 2026: Created scheduler.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2026 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Paces the dedicated server. Each tick is due a fixed time after the previous
+ * one was due, rather than after it finished, so slow ticks do not make the
+ * server drift. Between ticks, the server sleeps.
+ *
+ * The time spent working in each tick can be written to a CSV file, and a
+ * summary is logged every T_TICK_REPORT milliseconds.
+ *
+ */
+
+
+#include "scheduler.h"
+
+#include "util.h"
+
+#include <SDL.h>
+#include <signal.h>
+
+
+/// Set when the server has been asked to stop
+static volatile sig_atomic_t stopRequested = 0;
+
+
+/**
+ * Ask the server to stop at the end of the current tick.
+ *
+ * @param signalNumber The signal received
+ */
+static void requestStop (int signalNumber) {
+
+	(void)signalNumber;
+
+	stopRequested = 1;
+
+	return;
+
+}
+
+
+/**
+ * Create an inactive scheduler.
+ */
+TickScheduler::TickScheduler () {
+
+	logFile = NULL;
+	tickLength = 1000000 / TICK_RATE;
+	nextTick = tickStart = 0;
+	time = fraction = tick = 0;
+	reportTime = T_TICK_REPORT;
+	totalWork = maxWork = 0;
+	nTicks = late = skipped = 0;
+	active = false;
+
+	return;
+
+}
+
+
+/**
+ * Delete the scheduler.
+ */
+TickScheduler::~TickScheduler () {
+
+	if (logFile) fclose(logFile);
+
+	return;
+
+}
+
+
+/**
+ * Start scheduling ticks. Interrupting or terminating the process will stop
+ * the server cleanly.
+ *
+ * @param rate Number of ticks per second
+ * @param logFileName File to which the timing of each tick is written (NULL for none)
+ */
+void TickScheduler::activate (int rate, const char* logFileName) {
+
+	if (rate < 1) rate = 1;
+	else if (rate > 1000) rate = 1000;
+
+	tickLength = 1000000 / rate;
+
+	if (logFileName) {
+
+		logFile = fopen(logFileName, "w");
+
+		if (logFile) fprintf(logFile, "tick,time,work,sleep\n");
+		else logError("Could not write tick log", logFileName);
+
+	}
+
+	signal(SIGINT, requestStop);
+	signal(SIGTERM, requestStop);
+
+	nextTick = tickStart = getMicroTicks();
+	time = fraction = tick = 0;
+	reportTime = T_TICK_REPORT;
+	totalWork = maxWork = 0;
+	nTicks = late = skipped = 0;
+	active = true;
+
+	return;
+
+}
+
+
+/**
+ * Stop scheduling ticks, summarising any not yet reported.
+ */
+void TickScheduler::deactivate () {
+
+	if (!active) return;
+
+	report();
+
+	if (logFile) {
+
+		fclose(logFile);
+		logFile = NULL;
+
+	}
+
+	active = false;
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not ticks are being scheduled.
+ *
+ * @return True if ticks are being scheduled
+ */
+bool TickScheduler::isActive () {
+
+	return active;
+
+}
+
+
+/**
+ * Determine whether or not the server has been asked to stop.
+ *
+ * @return True if the server should stop
+ */
+bool TickScheduler::isStopped () {
+
+	return stopRequested != 0;
+
+}
+
+
+/**
+ * Move the time on.
+ *
+ * @param length Amount of time, in microseconds
+ */
+void TickScheduler::advance (unsigned int length) {
+
+	nextTick += length;
+
+	fraction += length;
+	time += fraction / 1000;
+	fraction %= 1000;
+
+	return;
+
+}
+
+
+/**
+ * End the current tick, and wait until the next one is due.
+ *
+ * @return Time of the next tick, in milliseconds since activation
+ */
+unsigned int TickScheduler::wait () {
+
+	unsigned int now, work, behind;
+	int delay;
+
+	now = getMicroTicks();
+	work = now - tickStart;
+
+	// Record how long the tick took
+
+	totalWork += work;
+	if (work > maxWork) maxWork = work;
+	if (work > tickLength) late++;
+
+	nTicks++;
+	tick++;
+
+	// Sleep until the next tick is due
+
+	advance(tickLength);
+
+	delay = nextTick - now;
+
+	if (delay >= 1000) {
+
+		SDL_Delay(delay / 1000);
+
+	} else if (delay < -(int)(tickLength * TICK_BACKLOG)) {
+
+		// Too far behind to catch up, so give up on the missed ticks
+		behind = (unsigned int)(-delay) / tickLength;
+		advance(behind * tickLength);
+		skipped += behind;
+
+	}
+
+	tickStart = getMicroTicks();
+
+	if (logFile)
+		fprintf(logFile, "%u,%u,%u,%u\n", tick, time, work, tickStart - now);
+
+	if (time >= reportTime) report();
+
+	return time;
+
+}
+
+
+/**
+ * Log a summary of the ticks since the last summary.
+ */
+void TickScheduler::report () {
+
+	if (nTicks) {
+
+		printf("Ticks: %d, mean work: %u us, max work: %u us, late: %d, skipped: %d\n",
+			nTicks, totalWork / nTicks, maxWork, late, skipped);
+
+	}
+
+	totalWork = maxWork = 0;
+	nTicks = late = skipped = 0;
+	reportTime = time + T_TICK_REPORT;
+
+	return;
+
+}
+
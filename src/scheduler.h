@@ -0,0 +1,81 @@
+
+/**
+ *
+ * @file scheduler.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 18th October 2026: Created scheduler.h
+ *
+ * @par Licence:
+ * Copyright (c) 2026 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+
+#include "OpenJazz.h"
+
+#include <stdio.h>
+
+
+// Constants
+
+#define TICK_RATE    50 /* Default number of ticks per second */
+#define TICK_BACKLOG 5 /* Number of ticks the server can fall behind before it stops trying to catch up */
+
+// Time interval
+#define T_TICK_REPORT 10000 /* Time between timing summaries */
+
+
+// Class
+
+/// Runs a dedicated server at a fixed number of ticks per second, sleeping
+/// until each tick is due, and records how long each tick takes
+class TickScheduler {
+
+	private:
+		FILE*        logFile; ///< File to which the timing of each tick is written, if any
+		unsigned int tickLength; ///< Length of a tick, in microseconds
+		unsigned int nextTick; ///< Time at which the next tick is due, from getMicroTicks()
+		unsigned int tickStart; ///< Time at which the current tick started, from getMicroTicks()
+		unsigned int time; ///< Time of the current tick, in milliseconds since activation
+		unsigned int fraction; ///< Microseconds of tick time not yet added to the time
+		unsigned int tick; ///< Number of ticks so far
+		unsigned int reportTime; ///< Time of the next timing summary
+		unsigned int totalWork; ///< Time spent working since the last summary, in microseconds
+		unsigned int maxWork; ///< Longest tick since the last summary, in microseconds
+		int          nTicks; ///< Number of ticks since the last summary
+		int          late; ///< Number of ticks since the last summary which took longer than a tick
+		int          skipped; ///< Number of ticks since the last summary which were given up on
+		bool         active; ///< Whether or not ticks are being scheduled
+
+		void advance (unsigned int length);
+		void report  ();
+
+	public:
+		TickScheduler  ();
+		~TickScheduler ();
+
+		void         activate   (int rate, const char* logFileName);
+		void         deactivate ();
+		bool         isActive   ();
+		bool         isStopped  ();
+		unsigned int wait       ();
+
+};
+
+
+// Variable
+
+EXTERN TickScheduler tickScheduler; ///< Dedicated server tick scheduler
+
+#endif
+
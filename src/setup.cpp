@@ -47,6 +47,8 @@
     #define CONFIG_FILE "openjazz.cfg"
 #endif
 
+#define CONFIG_VERSION 10
+
 
 /**
  * Create default setup
@@ -62,6 +64,9 @@ Setup::Setup () {
 	characterCols[2] = CHAR_GUN;
 	characterCols[3] = CHAR_WBAND;
 
+	// Simulation scheduling
+	maxFrameSteps = MAX_FRAME_STEPS;
+
 	return;
 
 }
@@ -83,7 +88,7 @@ Setup::~Setup () {
 void Setup::load (int* videoW, int* videoH, bool* fullscreen, int* videoScale) {
 
 	File* file;
-	int count;
+	int version, count;
 
 	// Open config file
 
@@ -99,8 +104,10 @@ void Setup::load (int* videoW, int* videoH, bool* fullscreen, int* videoScale) {
 
 	}
 
-	// Check that the config file has the correct version
-	if (file->loadChar() != 5) {
+	// Check that the config file has a known version
+	version = file->loadChar();
+
+	if ((version < 5) || (version > CONFIG_VERSION)) {
 
 		log("Valid configuration file not found.");
 		delete file;
@@ -173,6 +180,40 @@ void Setup::load (int* videoW, int* videoH, bool* fullscreen, int* videoScale) {
 	setup.leaveUnneeded = ((count & 2) != 0);
 
 
+	if (version >= 6) {
+
+		// Earlier versions also stored a step rate, which is now fixed
+		if (version < 10) file->loadChar();
+
+		// Read the most steps which may be taken in a single frame
+		count = file->loadChar();
+		if (count > 0) setup.maxFrameSteps = count;
+
+	}
+
+	if (version >= 7) {
+
+		// Read the number of sound effect voices
+		setSoundVoices(file->loadChar());
+
+	}
+
+	if (version >= 8) {
+
+		// Read the audio output sample rate and buffer size
+		count = file->loadShort(MAX_SOUND_RATE);
+		setSoundFormat(count, file->loadShort(MAX_SOUND_SAMPLES));
+
+	}
+
+	if (version >= 9) {
+
+		// Read whether music is rendered in advance
+		setMusicCache(file->loadChar() != 0);
+
+	}
+
+
 	delete file;
 
 
@@ -213,7 +254,7 @@ void Setup::save () {
 
 
 	// Write the version number
-	file->storeChar(5);
+	file->storeChar(CONFIG_VERSION);
 
 	// Write video settings
 	file->storeShort(video.getWidth());
@@ -275,6 +316,19 @@ void Setup::save () {
 
 	file->storeChar(count);
 
+	// Write the most steps which may be taken in a single frame
+	file->storeChar(setup.maxFrameSteps);
+
+	// Write the number of sound effect voices
+	file->storeChar(getSoundVoices());
+
+	// Write the audio output sample rate and buffer size
+	file->storeShort(getSoundRate());
+	file->storeShort(getSoundSamples());
+
+	// Write whether music is rendered in advance
+	file->storeChar(getMusicCache()? 1: 0);
+
 
 	delete file;
 
@@ -39,6 +39,7 @@ class Setup {
 		bool          slowMotion;
 		bool          leaveUnneeded;
 		bool          manyBirds;
+		int           maxFrameSteps;
 
 		Setup  ();
 		~Setup ();
@@ -0,0 +1,245 @@
+
+/**
+ *
+ * @file trace.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 18th October 2026: Created trace.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2026 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Records when the main parts of each frame, level loading, and audio output
+ * start and finish, and writes them in the Chrome trace event format for
+ * viewing in a trace viewer.
+ *
+ * Each thread records into its own buffer, so no locking is needed. The
+ * buffers are only read once the other threads have stopped.
+ *
+ */
+
+
+#include "trace.h"
+
+#include "util.h"
+
+#include <stdio.h>
+
+
+/**
+ * Create an inactive trace.
+ */
+Trace::Trace () {
+
+	int count;
+
+	for (count = 0; count < TT_THREADS; count++) {
+
+		events[count] = NULL;
+		nEvents[count] = 0;
+		dropped[count] = 0;
+
+	}
+
+	fileName = NULL;
+	startTime = 0;
+	active = false;
+
+	return;
+
+}
+
+
+/**
+ * Delete the trace.
+ */
+Trace::~Trace () {
+
+	int count;
+
+	for (count = 0; count < TT_THREADS; count++) {
+
+		if (events[count]) delete[] events[count];
+
+	}
+
+	if (fileName) delete[] fileName;
+
+	return;
+
+}
+
+
+/**
+ * Start recording.
+ *
+ * @param newFileName File to which the events are written by save()
+ */
+void Trace::activate (const char* newFileName) {
+
+	int count;
+
+	if (active) return;
+
+	for (count = 0; count < TT_THREADS; count++) {
+
+		events[count] = new TraceEvent[TRACE_EVENTS];
+		nEvents[count] = 0;
+		dropped[count] = 0;
+
+	}
+
+	fileName = createString(newFileName);
+	startTime = getMicroTicks();
+	active = true;
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not events are being recorded.
+ *
+ * @return True if recording
+ */
+bool Trace::isActive () {
+
+	return active;
+
+}
+
+
+/**
+ * Record the time spent in a function. Only the given thread may record into
+ * its buffer.
+ *
+ * @param thread The thread in which the function ran
+ * @param name Name of the function (must remain valid until saved)
+ * @param start Time at which the function was entered, from getMicroTicks()
+ */
+void Trace::add (TraceThread thread, const char* name, unsigned int start) {
+
+	TraceEvent* event;
+
+	if (!active) return;
+
+	if (nEvents[thread] >= TRACE_EVENTS) {
+
+		dropped[thread]++;
+
+		return;
+
+	}
+
+	event = events[thread] + nEvents[thread];
+	event->name = name;
+	event->start = start - startTime;
+	event->duration = getMicroTicks() - start;
+
+	nEvents[thread]++;
+
+	return;
+
+}
+
+
+/**
+ * Stop recording, and write the events to the trace file. The other threads
+ * must already have stopped.
+ *
+ * @return Error code
+ */
+int Trace::save () {
+
+	const char* threadNames[TT_THREADS] = {"game", "audio callback", "music"};
+	FILE* file;
+	TraceEvent* event;
+	int thread, count;
+	bool first;
+
+	if (!active) return E_NONE;
+
+	active = false;
+
+	file = fopen(fileName, "w");
+
+	if (!file) {
+
+		logError("Could not write trace", fileName);
+
+		return E_FILE;
+
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	first = true;
+
+	for (thread = 0; thread < TT_THREADS; thread++) {
+
+		if (!nEvents[thread]) continue;
+
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			first? "": ",\n", thread + 1, threadNames[thread]);
+
+		first = false;
+
+		for (count = 0; count < nEvents[thread]; count++) {
+
+			event = events[thread] + count;
+
+			fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%u,\"dur\":%u}",
+				event->name, thread + 1, event->start, event->duration);
+
+		}
+
+		if (dropped[thread]) log("Trace events dropped", dropped[thread]);
+
+	}
+
+	fprintf(file, "\n]}\n");
+
+	fclose(file);
+
+	log("Saved trace", fileName);
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Start timing a scope.
+ *
+ * @param newThread The thread in which the scope runs
+ * @param newName Name of the scope (must remain valid until saved)
+ */
+TraceScope::TraceScope (TraceThread newThread, const char* newName) {
+
+	thread = newThread;
+	name = newName;
+	startTime = trace.isActive()? getMicroTicks(): 0;
+
+	return;
+
+}
+
+
+/**
+ * Record the time since the scope was entered.
+ */
+TraceScope::~TraceScope () {
+
+	if (startTime) trace.add(thread, name, startTime);
+
+	return;
+
+}
+
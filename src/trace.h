@@ -0,0 +1,107 @@
+
+/**
+ *
+ * @file trace.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 18th October 2026: Created trace.h
+ *
+ * @par Licence:
+ * Copyright (c) 2026 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+
+#include "OpenJazz.h"
+
+
+// Macros
+
+#define TRACE_SCOPE(name) TraceScope traceScope(TT_GAME, name)
+#define TRACE_THREAD_SCOPE(thread, name) TraceScope traceScope(thread, name)
+
+
+// Constants
+
+#define TRACE_EVENTS 262144 /* Largest number of events recorded by each thread */
+
+
+// Enum
+
+/// Threads from which events are recorded
+enum TraceThread {
+
+	TT_GAME, ///< The main thread
+	TT_AUDIO, ///< The audio callback
+	TT_MUSIC, ///< The music decoding thread
+	TT_THREADS ///< Number of threads
+
+};
+
+
+// Datatype
+
+/// Span of time spent in a function
+typedef struct {
+
+	const char*  name; ///< Name of the function
+	unsigned int start; ///< Time at which the function was entered, in microseconds
+	unsigned int duration; ///< Time spent in the function, in microseconds
+
+} TraceEvent;
+
+
+// Classes
+
+/// Records when each traced function was entered and left
+class Trace {
+
+	private:
+		TraceEvent*  events[TT_THREADS]; ///< Events recorded by each thread
+		int          nEvents[TT_THREADS]; ///< Number of events recorded by each thread
+		int          dropped[TT_THREADS]; ///< Number of events which did not fit
+		char*        fileName; ///< File to which the events are written
+		unsigned int startTime; ///< Time at which recording started
+		bool         active; ///< Whether or not events are being recorded
+
+	public:
+		Trace  ();
+		~Trace ();
+
+		void activate (const char* newFileName);
+		bool isActive ();
+		void add      (TraceThread thread, const char* name, unsigned int start);
+		int  save     ();
+
+};
+
+/// Records the time spent in the scope in which it is created
+class TraceScope {
+
+	private:
+		TraceThread  thread; ///< The thread in which the scope runs
+		const char*  name; ///< Name of the scope
+		unsigned int startTime; ///< Time at which the scope was entered
+
+	public:
+		TraceScope  (TraceThread newThread, const char* newName);
+		~TraceScope ();
+
+};
+
+
+// Variable
+
+EXTERN Trace trace; ///< Function timing trace
+
+#endif
+
@@ -31,6 +31,13 @@
 
 #include <string.h>
 
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/time.h>
+	#include <time.h>
+#endif
+
 #ifdef __vita__
 #include <psp2/kernel/clib.h>
 #define printf sceClibPrintf
@@ -106,6 +113,29 @@ int createInt (unsigned char* data) {
 }
 
 
+/**
+ * Create an FNV-1a hash of the contents of the given memory location.
+ *
+ * @param data Pointer to the memory location
+ * @param length Number of bytes to hash
+ *
+ * @return The generated hash
+ */
+unsigned int createHash (unsigned char* data, int length) {
+
+	unsigned int hash;
+	int count;
+
+	hash = 2166136261u;
+
+	for (count = 0; count < length; count++)
+		hash = (hash ^ data[count]) * 16777619u;
+
+	return hash;
+
+}
+
+
 /**
  * Create a new string from the contents of an existing string.
  *
@@ -246,6 +276,40 @@ char * createEditableString (const char *string) {
 }
 
 
+/**
+ * Get a high-resolution time, for measuring short intervals.
+ *
+ * @return Time in microseconds (wraps around about every 71 minutes)
+ */
+unsigned int getMicroTicks () {
+
+#ifdef _WIN32
+	LARGE_INTEGER counter, frequency;
+
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+
+	return (unsigned int)(((counter.QuadPart / frequency.QuadPart) * 1000000) +
+		(((counter.QuadPart % frequency.QuadPart) * 1000000) / frequency.QuadPart));
+#else
+	struct timeval time;
+
+	#ifdef CLOCK_MONOTONIC
+	struct timespec monotonic;
+
+	// Unlike the time of day, this is not affected by changes to the clock
+	if (!clock_gettime(CLOCK_MONOTONIC, &monotonic))
+		return (monotonic.tv_sec * 1000000) + (monotonic.tv_nsec / 1000);
+	#endif
+
+	gettimeofday(&time, NULL);
+
+	return (time.tv_sec * 1000000) + time.tv_usec;
+#endif
+
+}
+
+
 /**
  * Add a message to the log.
  *
@@ -35,6 +35,16 @@
 	#define LOGRESULT(message, expression) expression
 #endif
 
+// Orders memory accesses around data shared between threads without a lock
+#if defined(__GNUC__)
+	#define MEMORY_BARRIER() __sync_synchronize()
+#elif defined(_MSC_VER)
+	#include <intrin.h>
+	#define MEMORY_BARRIER() _ReadWriteBarrier()
+#else
+	#define MEMORY_BARRIER()
+#endif
+
 
 // Variable
 
@@ -47,12 +57,14 @@ EXTERN fixed sinLut[1024];
 EXTERN bool               fileExists           (const char *fileName);
 EXTERN unsigned short int createShort          (unsigned char* data);
 EXTERN int                createInt            (unsigned char* data);
+EXTERN unsigned int       createHash           (unsigned char* data, int length);
 EXTERN char*              createString         (const char *string);
 EXTERN char*              createString         (const char *first, const char *second);
 EXTERN char*              createFileName       (const char *type, int extension);
 EXTERN char*              createFileName       (const char *type, const char *extension);
 EXTERN char*              createFileName       (const char *type, int level, int extension);
 EXTERN char*              createEditableString (const char *string);
+EXTERN unsigned int       getMicroTicks        ();
 EXTERN void               log                  (const char *message);
 EXTERN void               log                  (const char *message, const char *detail);
 EXTERN void               log                  (const char *message, int number);